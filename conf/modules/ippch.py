@@ -10,6 +10,6 @@ module= Extension(
         ['src/lib/ipps/_ippch.c'],
         include_dirs= [IPPINCLUDE, 'src/include'],
         library_dirs= [IPPLIBDIR],
-        libraries= ['ipps', 'ippch'],
+        libraries= ['ipps', 'ippch', 'pthread'],
         )
 
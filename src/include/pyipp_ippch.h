@@ -0,0 +1,115 @@
+/**
+ * \file	pyipp_ippch.h
+ * \brief	C API of the _ippch extension module
+ * \author	Christian Staffa
+ *
+ * Other extension modules can use the compiled regexp states of an
+ * IppRegExpStateObject without going through Python for every scan:
+ *
+ *     PyIppch_CAPI *api= PyIppch_IMPORT;
+ *     PyIppch_StateView v;
+ *
+ *     if (api == NULL || api->Borrow(stateobj, &v) < 0)
+ *         return NULL;
+ *     Py_BEGIN_ALLOW_THREADS
+ *     istatus= api->Find(&v, buf, len, find, &numfind);
+ *     Py_END_ALLOW_THREADS
+ *     api->Release(&v);
+ *
+ * Borrow and Release need the GIL, the scan functions do not touch any
+ * Python object and may be called with or without holding it.
+ *
+ * Multi objects compiled with dedup hold one state per distinct pattern.
+ * The regexpID of a MultiFind result is the state number k + 1, the
+ * pattern ids owning it are ownerids[ownerstart[k] .. ownerstart[k+1]).
+ *
+ * Copyright (c) 2012-2013, Christian Staffa <www.haai.de>
+ * See LICENSE file
+ */
+#ifndef PYIPP_IPPCH_H
+#define PYIPP_IPPCH_H
+
+#include <Python.h>
+#include <ipp.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PYIPP_IPPCH_CAPI_VERSION    2   /**< \def version of PyIppch_CAPI */
+#define PYIPP_IPPCH_CAPSULE_NAME    "pyipp.ipps._ippch._C_API"
+
+/**
+ * \brief	borrowed view on the states of an IppRegExpStateObject
+ */
+typedef struct {
+    PyObject *owner;                /**< strong reference to the object */
+    IppRegExpState *ires;           /**< single state or NULL */
+    const IppRegExpMultiState *irems; /**< multi state or NULL */
+    int numgroups;                  /**< capture groups of ires */
+    int numpatterns;                /**< number of patterns in irems */
+    const int *capacity;            /**< find entries needed per pattern */
+    void *lock;                     /**< serializes scans on the states */
+    int numentries;                 /**< pattern entries of a multi object */
+    const int *ownerstart;          /**< [numpatterns + 1] or NULL */
+    const Ipp32s *ownerids;         /**< pattern ids grouped by state */
+} PyIppch_StateView;
+
+/**
+ * \brief	function table exported through the capsule
+ */
+typedef struct {
+    int version;                    /**< PYIPP_IPPCH_CAPI_VERSION */
+    size_t size;                    /**< sizeof(PyIppch_CAPI) */
+    /** fill view from an IppRegExpStateObject, 0 or -1 with exception */
+    int (*Borrow)(PyObject *obj, PyIppch_StateView *view);
+    /** drop the reference taken by Borrow */
+    void (*Release)(PyIppch_StateView *view);
+    /** ippsRegExpFind_8u on view->ires, *numfind is in/out */
+    IppStatus (*Find)(PyIppch_StateView *view, const Ipp8u *src, int len,
+            IppRegExpFind *find, int *numfind);
+    /** ippsRegExpMultiFind_8u on view->irems */
+    IppStatus (*MultiFind)(PyIppch_StateView *view, const Ipp8u *src,
+            int len, IppRegExpMultiFind *multifind);
+    /** allocate multi find entries sized for view, NULL on no memory */
+    IppRegExpMultiFind *(*MultiFindAlloc)(PyIppch_StateView *view);
+    /** free entries returned by MultiFindAlloc */
+    void (*MultiFindFree)(IppRegExpMultiFind *multifind);
+} PyIppch_CAPI;
+
+/**
+ * \brief	import the C API and check it matches this header
+ * \return	function table, NULL with exception on error
+ *
+ * A table of another version or smaller than PyIppch_CAPI raises
+ * ImportError instead of calling through a mismatched layout.
+ */
+Py_LOCAL_INLINE(PyIppch_CAPI *)
+PyIppch_Import(void)
+{
+    PyIppch_CAPI *api;
+
+    api= (PyIppch_CAPI *)PyCapsule_Import(PYIPP_IPPCH_CAPSULE_NAME, 0);
+    if (api == NULL)
+        return NULL;
+    if (api->version != PYIPP_IPPCH_CAPI_VERSION \
+            || api->size < sizeof(PyIppch_CAPI)) {
+        PyErr_Format(PyExc_ImportError, "_ippch C API version %d size %zu, "
+                "expected version %d size %zu", api->version, api->size, \
+                PYIPP_IPPCH_CAPI_VERSION, sizeof(PyIppch_CAPI));
+        return NULL;
+    }
+    return api;
+}
+
+/**
+ * \def	PyIppch_IMPORT
+ * \brief	import the C API, evaluates to NULL with exception on error
+ */
+#define PyIppch_IMPORT PyIppch_Import()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* PYIPP_IPPCH_H */
@@ -12,7 +12,13 @@
 #include <Python.h>
 #include <structmember.h>
 #include <ippcore.h>
+#include <ippversion.h>
 #include <string.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <cpuid.h>
+#endif
 
 static PyObject *IppError;
 
@@ -118,88 +124,79 @@ error:
 }
 
 /**
- * \brief	convenient function for getting string representation
+ * \brief	names of the cpu feature flags
  */
-void
-_getCpuFeatureFlagString(Ipp64u CpuFeatureFlags, char *buf, int len)
-{
-	int before= 0;
+static const struct {
+	Ipp64u mask;
+	const char *name;
+} CpuFeatureNames[]= {
+	{ippCPUID_MMX, "MMX"},
+	{ippCPUID_SSE, "SSE"},
+	{ippCPUID_SSE2, "SSE2"},
+	{ippCPUID_SSE3, "SSE3"},
+	{ippCPUID_SSSE3, "SSSE3"},
+	{ippCPUID_MOVBE, "MOVBE"},
+	{ippCPUID_SSE41, "SSE41"},
+	{ippCPUID_SSE42, "SSE42"},
+	{ippCPUID_AVX, "AVX"},
+	{ippAVX_ENABLEDBYOS, "AVXOS"},
+	{ippCPUID_AES, "AES"},
+	{ippCPUID_CLMUL, "CLMUL"},
+	{ippCPUID_RDRRAND, "RDRAND"},
+	{ippCPUID_F16C, "F16C"},
+#ifdef ippCPUID_AVX2
+	{ippCPUID_AVX2, "AVX2"},
+#endif
+	{0, NULL}
+};
 
-	memset(buf, '\0', len);
-	if (CpuFeatureFlags & ippCPUID_MMX) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "MMX", sizeof("MMX")); len+= sizeof("MMX"); before= 1;
-	}
-	if (CpuFeatureFlags & ippCPUID_SSE) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "SSE", sizeof("SSE")); len+= sizeof("SSE"); before= 1;
-	}
-	if (CpuFeatureFlags & ippCPUID_SSE2) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "SSE2", sizeof("SSE2")); len+= sizeof("SSE2"); before=1;
-	}
-	if (CpuFeatureFlags & ippCPUID_SSE3) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "SSE3", sizeof("SSE3")); len+= sizeof("SSE3"); before= 1;
-	}
-	if (CpuFeatureFlags & ippCPUID_SSSE3) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "SSSE3", sizeof("SSSE3")); len+= sizeof("SSSE3"); before= 1;
-	}
-	if (CpuFeatureFlags & ippCPUID_MOVBE) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "MOVBE", sizeof("MOVBE")); len+= sizeof("MOVBE"); before= 1;
-	}
-	if (CpuFeatureFlags & ippCPUID_SSE41) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "SSE41", sizeof("SSE41")); len+= sizeof("SSE41"); before= 1;
-	}
-	if (CpuFeatureFlags & ippCPUID_SSE42) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "SSE42", sizeof("SSE42")); len+= sizeof("SSE42"); before= 1;
-	}
-	if (CpuFeatureFlags & ippCPUID_AVX) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "AVX", sizeof("AVX")); len+= sizeof("AVX"); before= 1;
-	}
-	if (CpuFeatureFlags & ippAVX_ENABLEDBYOS) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "AVXOS", sizeof("AVXOS")); len+= sizeof("AVXOS"); before= 1;
-	}
-	if (CpuFeatureFlags & ippCPUID_AES) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
+/**
+ * \brief	list of the names of the flags set in CpuFeatureFlags
+ */
+static PyObject *
+_getCpuFeatureFlagList(Ipp64u CpuFeatureFlags)
+{
+	int i;
+	PyObject *l, *n;
+
+	l= PyList_New(0);
+	if (l == NULL)
+		return NULL;
+	for (i= 0; CpuFeatureNames[i].name; ++i) {
+		if (!(CpuFeatureFlags & CpuFeatureNames[i].mask))
+			continue;
+		n= PyString_FromString(CpuFeatureNames[i].name);
+		if (n == NULL || PyList_Append(l, n) < 0) {
+			Py_XDECREF(n);
+			Py_DECREF(l);
+			return NULL;
 		}
-		strncat(buf, "AES", sizeof("AES")); len+= sizeof("AES"); before= 1;
+		Py_DECREF(n);
 	}
-	if (CpuFeatureFlags & ippCPUID_CLMUL) {
-		if (before == 1) {
-			strncat(buf, " ", 1); len+= 1;
-		}
-		strncat(buf, "CLMUL", sizeof("CLMUL")); len+= sizeof("CLMUL"); before= 1;
+	return l;
+}
+
+/**
+ * \brief	convenient function for getting string representation
+ * \return	space separated names of the flags set in CpuFeatureFlags
+ */
+static PyObject *
+_getCpuFeatureFlagString(Ipp64u CpuFeatureFlags)
+{
+	PyObject *l, *sep, *s;
+
+	l= _getCpuFeatureFlagList(CpuFeatureFlags);
+	if (l == NULL)
+		return NULL;
+	sep= PyString_FromString(" ");
+	if (sep == NULL) {
+		Py_DECREF(l);
+		return NULL;
 	}
-	buf[len]= '\0';
-	return ;
+	s= _PyString_Join(sep, l);
+	Py_DECREF(sep);
+	Py_DECREF(l);
+	return s;
 }
 
 /**
@@ -209,18 +206,65 @@ static PyObject *
 _getCpuFeatures(PyObject *self, PyObject *args)
 {
 	Ipp64u fm;
-	char CpuFlagString[100];
 	IppStatus istatus;
 
 	istatus= ippGetCpuFeatures(&fm, NULL);
 	if (istatus != ippStsNoErr)
 		goto error;
-	_getCpuFeatureFlagString(fm, CpuFlagString, sizeof(CpuFlagString));
-	return Py_BuildValue("Ks", fm, CpuFlagString);
+	return Py_BuildValue("KN", fm, _getCpuFeatureFlagString(fm));
 error:
 	return NULL;
 }
 
+/**
+ * \brief	check that the os saves the YMM registers on a context switch
+ *
+ * The AVX and AVX2 cpuid bits only say the processor has the
+ * instructions. They can only be used when the os has set OSXSAVE
+ * (cpuid 1, ecx bit 27) and enabled the SSE and AVX state in XCR0.
+ * \return	1 if the YMM state is enabled, 0 otherwise
+ */
+static int
+_osYmmEnabled(void)
+{
+#if defined(_MSC_VER) || \
+		(defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+	unsigned int ecx, xcr0;
+#if defined(_MSC_VER)
+	int r[4];
+
+	__cpuid(r, 1);
+	ecx= (unsigned int)r[2];
+#else
+	unsigned int eax, ebx, edx;
+
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return 0;
+#endif
+	if ((ecx & (1u << 27)) == 0 || (ecx & (1u << 28)) == 0)
+		return 0;
+#if defined(_MSC_VER)
+	xcr0= (unsigned int)_xgetbv(0);
+#else
+	/* xgetbv as bytes, older assemblers do not know the mnemonic */
+	__asm__ __volatile__(".byte 0x0f, 0x01, 0xd0"
+			: "=a" (xcr0), "=d" (edx) : "c" (0));
+#endif
+	return (xcr0 & 0x6) == 0x6;
+#else
+	return 0;
+#endif
+}
+
+/**
+ * \brief	returns True if the os has enabled the YMM (AVX) state
+ */
+static PyObject *
+_getOsAvxEnabled(PyObject *self, PyObject *args)
+{
+	return PyBool_FromLong(_osYmmEnabled());
+}
+
 /**
  * \brief	returns a features mask for enabled processor features
  * url		
@@ -229,11 +273,9 @@ static PyObject *
 _getEnabledCpuFeatures(PyObject *self, PyObject *args)
 {
 	Ipp64u fm;
-	char CpuFlagString[100];
 
 	fm= ippGetEnabledCpuFeatures();
-	_getCpuFeatureFlagString(fm, CpuFlagString, sizeof(CpuFlagString));
-	return Py_BuildValue("Ks", fm, CpuFlagString);
+	return Py_BuildValue("KN", fm, _getCpuFeatureFlagString(fm));
 }
 
 /**
@@ -254,12 +296,18 @@ _getNumCoresOnDie(PyObject *self, PyObject *args)
 static PyObject *
 _getMaxCacheSize(PyObject *self, PyObject *args)
 {
+    PyObject *value;
     int isb;
     IppStatus istatus;
 
     istatus= ippGetMaxCacheSizeB(&isb);
-    if (istatus != ippStsNoErr)
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("si", \
+                "ippGetMaxCacheSizeB: Error Ipp Status", istatus);
+        PyErr_SetObject(IppError, value);
+        Py_XDECREF(value);
         goto ret;
+    }
     return Py_BuildValue("i", isb);
 ret:
     return NULL;
@@ -367,6 +415,132 @@ error:
 	return NULL;
 }
 
+/**
+ * \brief	queries everything known about the machine in one call
+ * \return	dict with cpu type, feature masks and names, caches, cores, MHz
+ *
+ * The frequency is measured, so this takes a while; callers are
+ * expected to cache the result (see pyipp.ipp.machine).
+ */
+static PyObject *
+_getMachineProfile(PyObject *self, PyObject *args)
+{
+	PyObject *value;
+	Ipp64u fm, em;
+	int cache= 0, mhz= 0;
+	IppStatus istatus;
+
+	istatus= ippGetCpuFeatures(&fm, NULL);
+	if (istatus != ippStsNoErr) {
+		value= Py_BuildValue("si", \
+				"ippGetCpuFeatures: Error Ipp Status", istatus);
+		PyErr_SetObject(IppError, value);
+		Py_XDECREF(value);
+		return NULL;
+	}
+	em= ippGetEnabledCpuFeatures();
+	if (ippGetMaxCacheSizeB(&cache) != ippStsNoErr)
+		cache= 0;
+	if (ippGetCpuFreqMhz(&mhz) != ippStsNoErr)
+		mhz= 0;
+	return Py_BuildValue("{sisKsNsKsNsisisi}",
+			"cputype", (int)ippGetCpuType(),
+			"features", (unsigned PY_LONG_LONG)fm,
+			"flags", _getCpuFeatureFlagList(fm),
+			"enabled", (unsigned PY_LONG_LONG)em,
+			"enabledflags", _getCpuFeatureFlagList(em),
+			"cachesize", cache,
+			"cores", ippGetNumCoresOnDie(),
+			"mhz", mhz);
+}
+
+/**
+ * \brief	automatically dispatch the code paths for the best cpu
+ */
+static PyObject *
+_init(PyObject *self, PyObject *args)
+{
+	IppStatus istatus;
+
+	istatus= ippInit();
+	return Py_BuildValue("i", istatus);
+}
+
+/**
+ * \brief	dispatch the code paths optimized for the given cpu type
+ */
+static PyObject *
+_initCpu(PyObject *self, PyObject *args)
+{
+	PyObject *value;
+	IppStatus istatus;
+	int ct;
+
+	if (!PyArg_ParseTuple(args, "i", &ct))
+		goto error;
+	if (ct == ippCpuAVX
+#if IPP_VERSION_MAJOR >= 8
+			|| ct == ippCpuAVX2
+#endif
+			) {
+		if (!_osYmmEnabled()) {
+			PyErr_SetString(PyExc_ValueError,
+					"ippInitCpu: os has not enabled the AVX (YMM) state");
+			goto error;
+		}
+	}
+	istatus= ippInitCpu((IppCpuType)ct);
+	if (istatus < ippStsNoErr) {
+		value= Py_BuildValue("si", "ippInitCpu: Error Ipp Status", istatus);
+		PyErr_SetObject(IppError, value);
+		Py_XDECREF(value);
+		goto error;
+	}
+	return Py_BuildValue("i", istatus);
+error:
+	return NULL;
+}
+
+/**
+ * \brief	dispatch the code paths for the given cpu features mask
+ */
+static PyObject *
+_setCpuFeatures(PyObject *self, PyObject *args)
+{
+#if IPP_VERSION_MAJOR >= 8
+	PyObject *value;
+	IppStatus istatus;
+	unsigned PY_LONG_LONG fm;
+
+	if (!PyArg_ParseTuple(args, "K", &fm))
+		goto error;
+	if ((fm & (ippCPUID_AVX
+#ifdef ippCPUID_AVX2
+			| ippCPUID_AVX2
+#endif
+			)) && !_osYmmEnabled()) {
+		PyErr_SetString(PyExc_ValueError,
+				"ippSetCpuFeatures: os has not enabled the AVX (YMM) state");
+		goto error;
+	}
+	istatus= ippSetCpuFeatures((Ipp64u)fm);
+	if (istatus < ippStsNoErr) {
+		value= Py_BuildValue("si", \
+				"ippSetCpuFeatures: Error Ipp Status", istatus);
+		PyErr_SetObject(IppError, value);
+		Py_XDECREF(value);
+		goto error;
+	}
+	return Py_BuildValue("i", istatus);
+error:
+	return NULL;
+#else
+	PyErr_SetString(PyExc_NotImplementedError,
+			"ippSetCpuFeatures needs IPP 8.0 or later, use _initCpu");
+	return NULL;
+#endif
+}
+
 /**
  * \brief	holds the methods for the module
  */
@@ -377,6 +551,8 @@ static PyMethodDef Module_Methods[]= {
 		"Get the CPU Features Flag Field"},
 	{"_getEnabledCpuFeatures", _getEnabledCpuFeatures, METH_VARARGS,
 		"Get the ENABLED CPU Features Flag Field"},
+	{"_getOsAvxEnabled", _getOsAvxEnabled, METH_NOARGS,
+		"Returns True if the os has enabled the AVX (YMM) register state"},
     {"_getStatusString", _getStatusString, METH_VARARGS,
         "Translates a status code into a Ipp Status message"},
     {"_getCpuClocks", _getCpuClocks, METH_VARARGS,
@@ -397,6 +573,14 @@ static PyMethodDef Module_Methods[]= {
         "Enables or disables flush-to-zero (FTZ) mode"},
     {"_setDenormAreZeros", _setDenormAreZeros, METH_VARARGS,
         "Enables or disables denormals-are-zero (DAZ) mode"},
+    {"_getMachineProfile", _getMachineProfile, METH_NOARGS,
+        "Returns cpu type, features, cache size, cores and MHz at once"},
+    {"_init", _init, METH_NOARGS,
+        "Dispatches the code paths for the best supported processor"},
+    {"_initCpu", _initCpu, METH_VARARGS,
+        "Dispatches the code paths optimized for the given processor type"},
+    {"_setCpuFeatures", _setCpuFeatures, METH_VARARGS,
+        "Dispatches the code paths for the given cpu features mask"},
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
@@ -445,6 +629,9 @@ init_ipp(void)
 	PyDict_SetItemString(d, "ippCpuAES", PyInt_FromLong(ippCpuAES));
 	PyDict_SetItemString(d, "ippCpuF16RND", PyInt_FromLong(ippCpuF16RND));
 	PyDict_SetItemString(d, "ippCpuX8664", PyInt_FromLong(ippCpuX8664));
+#if IPP_VERSION_MAJOR >= 8
+	PyDict_SetItemString(d, "ippCpuAVX2", PyInt_FromLong(ippCpuAVX2));
+#endif
 	/* add cpuid enums*/
 	PyDict_SetItemString(d, "ippCPUID_MMX", PyInt_FromLong(ippCPUID_MMX));
 	PyDict_SetItemString(d, "ippCPUID_SSE", PyInt_FromLong(ippCPUID_SSE));
@@ -461,6 +648,9 @@ init_ipp(void)
 	PyDict_SetItemString(d, "ippCPUID_ABB", PyInt_FromLong(ippCPUID_ABR));
 	PyDict_SetItemString(d, "ippCPUID_RDRRAND", PyInt_FromLong(ippCPUID_RDRRAND));
 	PyDict_SetItemString(d, "ippCPUID_F16C", PyInt_FromLong(ippCPUID_F16C));
+#ifdef ippCPUID_AVX2
+	PyDict_SetItemString(d, "ippCPUID_AVX2", PyLong_FromLongLong(ippCPUID_AVX2));
+#endif
 	PyDict_SetItemString(d, "ippCPUID_GETINFO_A", PyLong_FromLongLong(ippCPUID_GETINFO_A));
     /* add affinity enums */
     PyDict_SetItemString(d, "ippAffinityCompactFineCore", PyLong_FromLong(ippAffinityCompactFineCore));
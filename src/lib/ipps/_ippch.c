@@ -9,8 +9,21 @@
  */
 #include <Python.h>
 #include <structmember.h>
+#include <pythread.h>
 #include <ipp.h>
 #include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
+#include <stdio.h>
+#include <ctype.h>
+#include "pyipp_ippch.h"
 #ifdef DEBUG_IPP
 #include <stdio.h>
 #include <assert.h>
@@ -22,9 +35,41 @@
 #define X_MASK  (1<<3)  /**< \def VERBOSE flag mask */
 #define G_MASK  (1<<4)  /**< \def GLOBAL flag mask */
 
+#define STACKFIND       32      /**< \def find entries kept on the stack */
+#define NOGIL_THRESHOLD 16384   /**< \def source size scanned without GIL */
+#define POOL_MAXQUEUE   1024    /**< \def default worker pool queue bound */
+#define WARMUP_JOBS     64      /**< \def jobs a warmup is split into */
+#define ARENA_ALIGN     64      /**< \def alignment of states in an arena */
+#define MAXDEPTH        64      /**< \def group nesting _maxLength follows */
+#define PROF_BUCKETS    512     /**< \def buckets of a profiler histogram */
+#define MANIFEST_MAGIC  "PYIPPMF1" /**< \def rule set manifest file magic */
+#define MANIFEST_VERSION 2      /**< \def rule set manifest layout version */
+
 static PyObject *IppchError;
+static PyObject *IppchQueueFull;
 static PyTypeObject IppRegExpStateObject_Type;
 
+/* interned result keys, created once in init_ippch */
+static PyObject *s_numfind;
+static PyObject *s_ippstatus;
+static PyObject *s_ipperror;
+static PyObject *s_patternid;
+static PyObject *s_done;
+static PyObject *s_result;
+static PyObject *s_numpatterns;
+static PyObject *s_statesize;
+static PyObject *s_shared;
+
+/**
+ * \brief	anchored variants of a single pattern, compiled on first use
+ */
+enum {
+    ANCHOR_MATCH= 0,                /**< \A(?:pattern) */
+    ANCHOR_FULL,                    /**< \A(?:pattern)\z */
+    ANCHOR_CONTEXT,                 /**< [\s\S](?:pattern), one byte before */
+    ANCHOR_NUM
+};
+
 /**
  * \brief	IppRegExpStateObject
  */
@@ -33,8 +78,51 @@ typedef struct {
     IppRegExpState *ires;           /**< Ipp Regexp State */
 	IppRegExpMultiState *irems;		/**< Ipp Regexp Multi State */
     PyObject *attr_dict;            /**< attribute dictionary */
+    int numgroups;                  /**< capture groups of ires */
+    int numpatterns;                /**< number of states in irems */
+    int *capacity;                  /**< find entries per pattern of irems */
+    IppRegExpState **states;        /**< pattern states owned by irems */
+    IppRegExpMultiFind *multifind;  /**< preallocated multi find entries */
+    PyThread_type_lock lock;        /**< serializes scans on the states */
+    char *arena;                    /**< mapping holding shared states */
+    size_t arenasize;               /**< size of the arena mapping */
+    size_t arenaused;               /**< bytes handed out of the arena */
+    IppRegExpState *anchored[ANCHOR_NUM]; /**< variants of ires */
+    Py_ssize_t maxlength;           /**< bound of a match, -1 if unbounded */
+    int numentries;                 /**< entries given to compileMulti */
+    int *entrystate;                /**< state of every entry */
+    Ipp32s *entryids;               /**< id of every entry */
+    int *ownerstart;                /**< owners of state k start here */
+    Ipp32s *ownerids;               /**< entry ids grouped by state */
+    char opts[6];                   /**< ipp options of the pattern */
+    int lazy;                       /**< LAZY_NONE, LAZY_PENDING or LAZY_FAILED */
+    IppStatus lazystatus;           /**< status of a failed lazy compile */
+    int lazyeoffset;                /**< error offset of a failed lazy compile */
+    int lazyindex;                  /**< state of a failed lazy compile */
+    const char **statepat;          /**< state patterns, owned by attr_dict */
+    char *stateopts;                /**< ipp options of every multi state */
+    char *manifest;                 /**< mapped manifest the arrays live in */
+    size_t manifestsize;            /**< size of the manifest mapping */
 } IppRegExpStateObject;
 
+/**
+ * \brief	compile state of lazy objects
+ */
+enum {
+    LAZY_NONE= 0,                   /**< compiled (or not lazy) */
+    LAZY_PENDING,                   /**< validated, compiled on first use */
+    LAZY_FAILED                     /**< compiling on first use failed */
+};
+
+/**
+ * \brief	results of _contextKind
+ */
+enum {
+    CONTEXT_NONE= 0,
+    CONTEXT_BYTE,
+    CONTEXT_LOOKBEHIND
+};
+
 /**
  * \brief	IppRegExpMultiStateObject
  */
@@ -50,11 +138,39 @@ typedef struct {
 static void
 _dealloc_IppRegExpStateObject(PyObject *self)
 {
+    int i;
     IppRegExpStateObject *o= (IppRegExpStateObject*)self;
-    if (o->ires != (void*)0xcbcbcbcb && o->ires != NULL)
-        ippsRegExpFree(o->ires);
-	if (o->irems != (void*)0xcbcbcbcb && o->irems != NULL)
-		ippsRegExpMultiFree(o->irems);
+    if (o->arena) {
+        /* states were initialized in place, nothing to free but the map */
+        munmap(o->arena, o->arenasize);
+    }
+    else {
+        if (o->ires != (void*)0xcbcbcbcb && o->ires != NULL)
+            ippsRegExpFree(o->ires);
+        if (o->irems != (void*)0xcbcbcbcb && o->irems != NULL)
+            ippsRegExpMultiFree(o->irems);
+        if (o->states)
+            for (i= 0; i < o->numpatterns; ++i)
+                if (o->states[i]) ippsRegExpFree(o->states[i]);
+    }
+    for (i= 0; i < ANCHOR_NUM; ++i)
+        if (o->anchored[i])
+            ippsRegExpFree(o->anchored[i]);
+    PyMem_Free(o->states);
+    free(o->multifind);
+    PyMem_Free(o->capacity);
+    if (o->manifest)
+        munmap(o->manifest, o->manifestsize);
+    else {
+        PyMem_Free(o->entrystate);
+        PyMem_Free(o->entryids);
+        PyMem_Free(o->ownerstart);
+        PyMem_Free(o->ownerids);
+        PyMem_Free(o->stateopts);
+    }
+    PyMem_Free(o->statepat);
+    if (o->lock)
+        PyThread_free_lock(o->lock);
     Py_XDECREF(o->attr_dict);
 
     o->ob_type->tp_free((PyObject*)o);
@@ -136,37 +252,685 @@ int
 init_IppRegExpStateObject(PyObject *self, PyObject *args, PyObject *kwds)
 {
     IppRegExpStateObject *o= (IppRegExpStateObject *)self;
+    int i;
 
     if (o) {
         o->ires= NULL;
 		o->irems= NULL;
         o->attr_dict= NULL;
+        o->numgroups= 0;
+        o->numpatterns= 0;
+        o->capacity= NULL;
+        o->states= NULL;
+        o->multifind= NULL;
+        o->lock= NULL;
+        o->arena= NULL;
+        o->arenasize= 0;
+        o->arenaused= 0;
+        for (i= 0; i < ANCHOR_NUM; ++i)
+            o->anchored[i]= NULL;
+        o->maxlength= -1;
+        o->numentries= 0;
+        o->entrystate= NULL;
+        o->entryids= NULL;
+        o->ownerstart= NULL;
+        o->ownerids= NULL;
+        o->opts[0]= '\0';
+        o->lazy= LAZY_NONE;
+        o->lazystatus= ippStsNoErr;
+        o->lazyeoffset= 0;
+        o->lazyindex= 0;
+        o->statepat= NULL;
+        o->stateopts= NULL;
+        o->manifest= NULL;
+        o->manifestsize= 0;
     }	
     return 0;
 }
 
+/**
+ * \brief	map the arena holding the IPP states of a shared object
+ * \return	0 on success, -1 with exception set
+ *
+ * Shared objects are meant to be compiled before forking workers. Their
+ * states live in a private anonymous mapping instead of the malloc heap,
+ * so no python object or allocation shares a page with them. IPP keeps
+ * the match state inside the regexp state, so the first scan of a state
+ * in a child copies the pages it spans. The arena saves the compile in
+ * every child, not the resident memory of the states it scans.
+ */
+static int
+_mapArena(IppRegExpStateObject *o, size_t size)
+{
+    void *m;
+
+    m= mmap(NULL, size, PROT_READ|PROT_WRITE, \
+            MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (m == MAP_FAILED) {
+        PyErr_SetFromErrno(PyExc_OSError);
+        return -1;
+    }
+    o->arena= m;
+    o->arenasize= size;
+    o->arenaused= 0;
+    return 0;
+}
+
+/**
+ * \brief	hand out ARENA_ALIGN aligned memory of the arena
+ * \return	pointer into the arena, NULL if it is exhausted
+ */
+static void *
+_arenaAlloc(IppRegExpStateObject *o, size_t size)
+{
+    char *p;
+
+    if (o->arenaused + size > o->arenasize)
+        return NULL;
+    p= o->arena + o->arenaused;
+    o->arenaused+= (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    return p;
+}
+
+/**
+ * \brief	arena size needed for states of the given sizes
+ */
+static size_t
+_arenaSize(size_t size, int count)
+{
+    return size + (size_t)count * ARENA_ALIGN;
+}
+
+/**
+ * \brief	initialize a regexp state, in the arena for shared objects
+ * \return	ipp status
+ */
+static IppStatus
+_initState(IppRegExpStateObject *o, const char *pat, const char *opts, \
+        int size, IppRegExpState **state, int *ieos)
+{
+    if (o->arena == NULL)
+        return ippsRegExpInitAlloc(pat, opts, state, ieos);
+    *state= _arenaAlloc(o, size);
+    if (*state == NULL)
+        return ippStsNoMemErr;
+    return ippsRegExpInit(pat, opts, *state, ieos);
+}
+
+/**
+ * \brief	stop the cyclic gc from visiting the attributes of an object
+ *
+ * A collection writes to the gc header of every tracked container, so
+ * in forked children it would unshare the pages of the pattern metadata.
+ * The attributes only hold strings, ints and containers of them and the
+ * state object itself is not gc tracked, so no cycle can be missed.
+ */
+static void
+_untrackAttrs(PyObject *attr_dict)
+{
+    PyObject *patterns, *groupindex;
+    Py_ssize_t i;
+
+    patterns= PyDict_GetItemString(attr_dict, "patterns");
+    if (patterns && PyList_Check(patterns)) {
+        for (i= 0; i < PyList_GET_SIZE(patterns); ++i)
+            PyObject_GC_UnTrack(PyList_GET_ITEM(patterns, i));
+        PyObject_GC_UnTrack(patterns);
+    }
+    groupindex= PyDict_GetItemString(attr_dict, "groupindex");
+    if (groupindex)
+        PyObject_GC_UnTrack(groupindex);
+    PyObject_GC_UnTrack(attr_dict);
+}
+
+/**
+ * \brief	count the capture groups of a pattern
+ * \return	number of opening parentheses (upper bound of groups)
+ */
+static int
+_countCaptGroups(const char *pat, Py_ssize_t pat_len)
+{
+    int n= 0;
+    Py_ssize_t i;
+
+    for (i= 0; i < pat_len && pat[i]; ++i)
+        if (pat[i] == '(')
+            n++;
+    return n;
+}
+
+/**
+ * \brief	how a pattern depends on the text before a match
+ * \return	CONTEXT_NONE, CONTEXT_BYTE for ^, \b, \B, \A and \G or
+ *		CONTEXT_LOOKBEHIND
+ *
+ * Scanning a suffix of a buffer makes its first byte look like the
+ * start of the text, CONTEXT_BYTE patterns need the one byte before
+ * to match there correctly.
+ */
+static int
+_contextKind(const char *pat, Py_ssize_t pat_len)
+{
+    int kind= CONTEXT_NONE;
+    Py_ssize_t i;
+
+    for (i= 0; i < pat_len && pat[i]; ++i) {
+        if (pat[i] == '\\') {
+            i++;
+            if (i < pat_len && strchr("bBAG", pat[i]) && pat[i])
+                kind= CONTEXT_BYTE;
+        }
+        else if (pat[i] == '[') {
+            /* skip the class, a leading ] or ^] is a literal */
+            i++;
+            if (i < pat_len && pat[i] == '^')
+                i++;
+            if (i < pat_len && pat[i] == ']')
+                i++;
+            for (; i < pat_len && pat[i] && pat[i] != ']'; ++i)
+                if (pat[i] == '\\')
+                    i++;
+        }
+        else if (pat[i] == '^')
+            kind= CONTEXT_BYTE;
+        else if (pat[i] == '(' && i + 3 < pat_len && pat[i+1] == '?' \
+                && pat[i+2] == '<' && (pat[i+3] == '=' || pat[i+3] == '!'))
+            return CONTEXT_LOOKBEHIND;
+    }
+    return kind;
+}
+
+/**
+ * \brief	upper bound of the length of a match of pat
+ * \return	bound in bytes, -1 if unbounded or too deeply nested
+ *
+ * Every escape, class and literal counts one byte and lookarounds count
+ * like groups, so the bound also covers the bytes they inspect. Over-
+ * estimating only costs scanning a few more bytes.
+ */
+static Py_ssize_t
+_maxLength(const char *pat, Py_ssize_t pat_len)
+{
+    Py_ssize_t best[MAXDEPTH], cur[MAXDEPTH], last= 0, m, n, i, j;
+    int depth= 0;
+
+    best[0]= cur[0]= 0;
+    for (i= 0; i < pat_len && pat[i]; ++i) {
+        switch (pat[i]) {
+        case '(':
+            if (i + 1 < pat_len && pat[i+1] == '?') {
+                /* inline flags (?imsx) and comments (?#...) match nothing */
+                for (j= i + 2; j < pat_len && (isalpha((unsigned char) \
+                                pat[j]) || pat[j] == '-'); ++j)
+                    ;
+                if (j < pat_len && (pat[j] == ')' || pat[j] == '#')) {
+                    while (j < pat_len && pat[j] != ')')
+                        j++;
+                    i= j;
+                    last= 0;
+                    break;
+                }
+            }
+            if (++depth == MAXDEPTH)
+                return -1;
+            best[depth]= cur[depth]= 0;
+            last= 0;
+            break;
+        case ')':
+            if (depth == 0)
+                return -1;
+            last= cur[depth] > best[depth] ? cur[depth] : best[depth];
+            depth--;
+            cur[depth]+= last;
+            break;
+        case '|':
+            if (cur[depth] > best[depth])
+                best[depth]= cur[depth];
+            cur[depth]= 0;
+            last= 0;
+            break;
+        case '*':
+        case '+':
+            return -1;
+        case '?':
+        case '^':
+        case '$':
+            /* an optional atom still counts once */
+            break;
+        case '{':
+            /* {n} and {m,n} quantify, {m,} is unbounded, others are literal */
+            for (j= i + 1, n= 0; j < pat_len && isdigit((unsigned char) \
+                        pat[j]); ++j)
+                n= n <= 0xffff ? 10 * n + pat[j] - '0' : n;
+            if (j > i + 1 && j < pat_len && pat[j] == ',') {
+                if (j + 1 < pat_len && pat[j+1] == '}')
+                    return -1;
+                for (m= ++j, n= 0; j < pat_len && isdigit((unsigned char) \
+                            pat[j]); ++j)
+                    n= n <= 0xffff ? 10 * n + pat[j] - '0' : n;
+                if (j == m)
+                    n= -1;
+            }
+            if (j > i + 1 && n >= 0 && j < pat_len && pat[j] == '}') {
+                if (n > 0xffff)
+                    return -1;
+                if (n > 1)
+                    cur[depth]+= last * (n - 1);
+                i= j;
+                break;
+            }
+            cur[depth]++;
+            last= 1;
+            break;
+        case '\\':
+            i++;
+            if (i < pat_len && pat[i] >= '1' && pat[i] <= '9')
+                return -1;
+            if (i < pat_len && pat[i] == 'x')
+                for (j= 0; j < 2 && i + 1 < pat_len \
+                        && isxdigit((unsigned char)pat[i+1]); ++j)
+                    i++;
+            cur[depth]++;
+            last= 1;
+            break;
+        case '[':
+            /* skip the class, a leading ] or ^] is a literal */
+            i++;
+            if (i < pat_len && pat[i] == '^')
+                i++;
+            if (i < pat_len && pat[i] == ']')
+                i++;
+            for (; i < pat_len && pat[i] && pat[i] != ']'; ++i)
+                if (pat[i] == '\\')
+                    i++;
+            cur[depth]++;
+            last= 1;
+            break;
+        default:
+            cur[depth]++;
+            last= 1;
+        }
+        if (cur[depth] > 0x3fffffff)
+            return -1;
+    }
+    if (depth != 0)
+        return -1;
+    return cur[0] > best[0] ? cur[0] : best[0];
+}
+
+/**
+ * \brief	set an integer value for an (interned) key in a dict
+ * \return	0 on success, -1 on error
+ */
+static int
+_dictSetInt(PyObject *d, PyObject *key, long v)
+{
+    int r;
+    PyObject *i= PyInt_FromLong(v);
+
+    if (i == NULL)
+        return -1;
+    r= PyDict_SetItem(d, key, i);
+    Py_DECREF(i);
+    return r;
+}
+
+/**
+ * \brief	number capture groups and strip their names for ipp
+ * \return	number of capture groups, -1 with exception set
+ *
+ * (?P<name>...), (?<name>...) and (?'name'...) are written to out as
+ * plain groups and name -> number is stored in groupindex. Escapes,
+ * character classes and (?...) constructs do not count as groups. out
+ * needs room for pat_len + 1 bytes.
+ */
+static int
+_parseGroups(const char *pat, Py_ssize_t pat_len, char *out, \
+        PyObject *groupindex)
+{
+    PyObject *name;
+    Py_ssize_t i= 0, j= 0, k;
+    int n= 0, inclass= 0, r;
+    char close;
+
+    while (i < pat_len) {
+        if (pat[i] == '\\' && i + 1 < pat_len) {
+            out[j++]= pat[i++];
+            out[j++]= pat[i++];
+            continue;
+        }
+        if (inclass) {
+            if (pat[i] == ']')
+                inclass= 0;
+            out[j++]= pat[i++];
+            continue;
+        }
+        if (pat[i] == '[') {
+            inclass= 1;
+            out[j++]= pat[i++];
+            if (i < pat_len && pat[i] == '^')
+                out[j++]= pat[i++];
+            if (i < pat_len && pat[i] == ']')
+                out[j++]= pat[i++];
+            continue;
+        }
+        if (pat[i] != '(') {
+            out[j++]= pat[i++];
+            continue;
+        }
+        if (i + 1 >= pat_len || pat[i+1] != '?') {
+            n++;
+            out[j++]= pat[i++];
+            continue;
+        }
+        k= i + 2;
+        if (k < pat_len && pat[k] == 'P')
+            k++;
+        close= k < pat_len && pat[k] == '\'' ? '\'' : '>';
+        if (k >= pat_len || (pat[k] != '<' && pat[k] != '\'') || \
+                (k + 1 < pat_len && (pat[k+1] == '=' || pat[k+1] == '!'))) {
+            /* non capturing or lookaround */
+            out[j++]= pat[i++];
+            continue;
+        }
+        i= ++k;
+        while (k < pat_len && pat[k] != close)
+            k++;
+        if (k >= pat_len || k == i) {
+            PyErr_SetString(IppchError, "bad group name");
+            return -1;
+        }
+        n++;
+        name= PyString_FromStringAndSize(pat + i, k - i);
+        if (name == NULL)
+            return -1;
+        if (PyDict_GetItem(groupindex, name)) {
+            Py_DECREF(name);
+            PyErr_SetString(IppchError, "redefinition of group name");
+            return -1;
+        }
+        r= _dictSetInt(groupindex, name, n);
+        Py_DECREF(name);
+        if (r < 0)
+            return -1;
+        out[j++]= '(';
+        i= k + 1;
+    }
+    out[j]= '\0';
+    return n;
+}
+
+/**
+ * \brief	cheap syntax check of a pattern without compiling it
+ * \return	-1 if nothing was found, else the error offset with *istatus set
+ *
+ * Finds unbalanced groups, unterminated classes, a trailing backslash
+ * and quantifiers without operand. Everything else is left to the IPP
+ * compiler, which lazy objects only run on first use.
+ */
+static int
+_checkSyntax(const char *pat, IppStatus *istatus)
+{
+    int i, depth= 0, operand= 0, classat= -1, first= 0;
+
+    for (i= 0; pat[i]; ++i) {
+        if (pat[i] == '\\') {
+            if (pat[i+1] == '\0') {
+                *istatus= ippStsRegExpMetaChErr;
+                return i;
+            }
+            i++;
+            operand= 1;
+            continue;
+        }
+        if (classat >= 0) {
+            if (pat[i] == ']' && i > first) {
+                classat= -1;
+                operand= 1;
+            }
+            continue;
+        }
+        switch (pat[i]) {
+        case '[':
+            classat= i;
+            first= pat[i+1] == '^' ? i + 2 : i + 1;
+            break;
+        case '(':
+            depth++;
+            operand= 0;
+            /* (?: (?= (?! (?<= (?<! and inline options */
+            if (pat[i+1] == '?') {
+                i++;
+                if (pat[i+1] == '<' && (pat[i+2] == '=' || pat[i+2] == '!'))
+                    i+= 2;
+                else if (pat[i+1] == ':' || pat[i+1] == '=' || pat[i+1] == '!')
+                    i++;
+            }
+            break;
+        case ')':
+            if (depth == 0) {
+                *istatus= ippStsRegExpGroupingErr;
+                return i;
+            }
+            depth--;
+            operand= 1;
+            break;
+        case '|':
+            operand= 0;
+            break;
+        case '*': case '+': case '?':
+            if (!operand) {
+                *istatus= ippStsRegExpQuantifierErr;
+                return i;
+            }
+            if (pat[i+1] == '?' || pat[i+1] == '+')
+                i++;
+            operand= 0;
+            break;
+        case '^': case '$':
+            break;
+        default:
+            operand= 1;
+        }
+    }
+    if (classat >= 0) {
+        *istatus= ippStsRegExpChClassErr;
+        return classat;
+    }
+    if (depth) {
+        *istatus= ippStsRegExpGroupingErr;
+        return i;
+    }
+    return -1;
+}
+
+/**
+ * \brief	allocate multi find entries for numpatterns patterns
+ * \return	entries or NULL if no memory is available
+ *
+ * The entries and all their pFind arrays live in a single block, which
+ * is released with free(). No Python API is used, so this is safe to
+ * call without holding the GIL.
+ */
+static IppRegExpMultiFind *
+_newMultiFind(int numpatterns, const int *capacity)
+{
+    int i, total= 0;
+    IppRegExpMultiFind *mf;
+    IppRegExpFind *block;
+
+    for (i= 0; i < numpatterns; ++i)
+        total+= capacity[i];
+    mf= malloc(sizeof(IppRegExpMultiFind) * numpatterns \
+            + sizeof(IppRegExpFind) * total + 1);
+    if (mf == NULL)
+        return NULL;
+    memset(mf, 0, sizeof(IppRegExpMultiFind) * numpatterns);
+    block= (IppRegExpFind *)(mf + numpatterns);
+    for (i= 0; i < numpatterns; ++i) {
+        mf[i].pFind= block;
+        block+= capacity[i];
+    }
+    return mf;
+}
+
+/**
+ * \brief	compile the IPP states of an object, no GIL needed
+ * \return	ipp status, *ieos and *failed locate a pattern error
+ *
+ * Works only on what the constructor prepared in statepat, stateopts
+ * and the owner arrays, so lazy objects can be compiled on a worker or
+ * with the GIL released. The caller serializes on o->lock if the
+ * object is already visible to other threads.
+ */
+static IppStatus
+_buildStates(IppRegExpStateObject *o, int *ieos, int *failed)
+{
+    IppStatus istatus;
+    int k, ss= 0;
+
+    *failed= 0;
+    if (o->entrystate == NULL) {
+        ippsRegExpGetSize(o->statepat[0], &ss);
+        return _initState(o, o->statepat[0], o->opts, ss, &(o->ires), ieos);
+    }
+    if (o->arena) {
+        ippsRegExpMultiGetSize(o->numpatterns, &ss);
+        o->irems= _arenaAlloc(o, ss);
+        istatus= o->irems == NULL ? ippStsNoMemErr : \
+            ippsRegExpMultiInit(o->irems, (Ipp32u)o->numpatterns);
+    }
+    else
+        istatus= ippsRegExpMultiInitAlloc(&(o->irems), (Ipp32u)o->numpatterns);
+    if (istatus != ippStsNoErr)
+        return istatus;
+    for (k= 0; k < o->numpatterns; ++k) {
+        *failed= k;
+        ippsRegExpGetSize(o->statepat[k], &ss);
+        istatus= _initState(o, o->statepat[k], o->stateopts + 6 * k, ss, \
+                &(o->states[k]), ieos);
+        if (istatus != ippStsNoErr)
+            return istatus;
+        istatus= ippsRegExpMultiAdd(o->states[k], (Ipp32u)(k+1), o->irems);
+        if (istatus != ippStsNoErr)
+            return istatus;
+        /* !important! though groups can be 0 !!! */
+        o->capacity[k]= _countCaptGroups(o->statepat[k], \
+                strlen(o->statepat[k])) + 1;
+    }
+    o->multifind= _newMultiFind(o->numpatterns, o->capacity);
+    return o->multifind ? ippStsNoErr : ippStsNoMemErr;
+}
+
+/**
+ * \brief	raise IppchError for a failed compile of state failed
+ */
+static void
+_buildError(IppRegExpStateObject *o, IppStatus istatus, int ieos, int failed)
+{
+    PyObject *value;
+    int i;
+
+    if (o->entrystate == NULL)
+        value= Py_BuildValue("sisi",
+                "ippstatus", istatus,
+                "eoffset", ieos);
+    else {
+        /* report the first entry using the state */
+        for (i= 0; i < o->numentries && o->entrystate[i] != failed; ++i)
+            ;
+        value= Py_BuildValue("sisisi",
+                "ippstatus", istatus,
+                "idxerrpattern", i,
+                "eoffset", ieos);
+    }
+    if (value == NULL)
+        return;
+    PyErr_SetObject(IppchError, value);
+    Py_DECREF(value);
+}
+
+/**
+ * \brief	compile a pending lazy object, lock held, no GIL needed
+ */
+static void
+_lazyBuild(IppRegExpStateObject *o)
+{
+    int ieos= 0, failed= 0;
+
+    if (o->lazy != LAZY_PENDING)
+        return;
+    o->lazystatus= _buildStates(o, &ieos, &failed);
+    if (o->lazystatus != ippStsNoErr) {
+        o->lazyeoffset= ieos;
+        o->lazyindex= failed;
+        __atomic_store_n(&o->lazy, LAZY_FAILED, __ATOMIC_RELEASE);
+    }
+    else
+        __atomic_store_n(&o->lazy, LAZY_NONE, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief	make sure the single (multi) state of an object can be used
+ * \return	0 on success, -1 with exception set
+ *
+ * Pending lazy objects are compiled here without the GIL. A failed
+ * lazy compile is not retried, every later use raises the same error.
+ */
+static int
+_ensureState(IppRegExpStateObject *o, int multi)
+{
+    int lazy;
+
+    /* LAZY_NONE is stored after the states, it is final once seen */
+    lazy= __atomic_load_n(&o->lazy, __ATOMIC_ACQUIRE);
+    if (lazy != LAZY_NONE) {
+        /* a warmup job may be compiling, decide under its lock */
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(o->lock, 1);
+        _lazyBuild(o);
+        lazy= o->lazy;
+        PyThread_release_lock(o->lock);
+        Py_END_ALLOW_THREADS
+    }
+    if (lazy == LAZY_FAILED) {
+        _buildError(o, o->lazystatus, o->lazyeoffset, o->lazyindex);
+        return -1;
+    }
+    if (multi && o->irems == NULL) {
+        PyErr_SetString(IppchError, "No IppRegExpMultiState was created.");
+        return -1;
+    }
+    if (!multi && o->ires == NULL) {
+        PyErr_SetString(IppchError, "no IppRegExpState was created.");
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * \brief	create a new IppRegExpStateObject object based on pattern pattern (:
  * \return	new IppRegExpStateObject of Type IppRegExpStateObject_Type
+ *
+ * A lazy object is only checked by _checkSyntax, the IPP state is
+ * compiled on first use or by a warmup job.
  */
 static PyObject *
-_create_IppRegExpStateObject(PyObject *pattern, PyObject *flags)
+_create_IppRegExpStateObject(PyObject *pattern, PyObject *flags, int shared, \
+        int lazy, int priority)
 {
-    char *pat, *p;
+    char *pat;
 	char opts[6]= "\0";
     Py_ssize_t pat_len;
-    int ieos= 0, numCaptGroups= 0, i= 0, statesize= 0;
-    IppStatus istatus;
-    PyObject *value, *groupindex;
+    int ieos= 0, numCaptGroups= 0, statesize= 0, failed= 0;
+    IppStatus istatus= ippStsNoErr;
+    PyObject *groupindex= NULL, *ipppattern= NULL;
 	IppRegExpStateObject *ireso;
 
     ireso= PyObject_New(IppRegExpStateObject, &IppRegExpStateObject_Type);
     if (ireso == NULL)
         goto error;
-    /*FIXME(haai): this should do the init function but it doesnt !?!*/
-    ireso->ires= NULL;
-    ireso->irems= NULL;
-	ireso->attr_dict= NULL;
+    init_IppRegExpStateObject((PyObject *)ireso, NULL, NULL);
     if (!PyString_Check(pattern)) {
         PyErr_SetString(PyExc_TypeError, "wrong argument type!");
         goto error;
@@ -177,341 +941,5038 @@ _create_IppRegExpStateObject(PyObject *pattern, PyObject *flags)
     }
 
     PyString_AsStringAndSize(pattern, &pat, &pat_len);
+	groupindex= PyDict_New();
+	ipppattern= PyString_FromStringAndSize(NULL, pat_len);
+	if (!groupindex || !ipppattern)
+		goto error;
+    /* ipp does not know group names, compile the pattern without them */
+    numCaptGroups= _parseGroups(pat, pat_len, \
+            PyString_AS_STRING(ipppattern), groupindex);
+    if (numCaptGroups < 0)
+        goto error;
+    if (_PyString_Resize(&ipppattern, strlen(PyString_AS_STRING(ipppattern))) < 0)
+        goto error;
+    pat= PyString_AS_STRING(ipppattern);
+    if (lazy && (ieos= _checkSyntax(pat, &istatus)) >= 0) {
+        _buildError(ireso, istatus, ieos, 0);
+        goto error;
+    }
 	ippsRegExpGetSize(pat, &statesize);
 	_getIppOptString(flags, opts);
-    istatus= ippsRegExpInitAlloc(pat, NULL, &(ireso->ires), &ieos);
-    if (istatus != ippStsNoErr) {
-		value= Py_BuildValue("sisi",
-                "ippstatus", istatus,
-                "eoffset", ieos);
-        PyErr_SetObject(IppchError, value);
+    strcpy(ireso->opts, opts);
+    if (shared && _mapArena(ireso, _arenaSize(statesize, 1)) < 0)
+        goto error;
+    ireso->statepat= PyMem_New(const char *, 1);
+    if (ireso->statepat == NULL) {
+        PyErr_NoMemory();
         goto error;
     }
-    p= pat;
-	while (i++ < pat_len && *p) {
-		if (*p == '(')
-			numCaptGroups++; p++;
-	}
-	groupindex= PyDict_New();
-	if (!groupindex) {
-		goto error;
-	}
-	ireso->attr_dict= Py_BuildValue("{sisisNsOsi}",
+    /* ipppattern is kept alive by the attributes */
+    ireso->statepat[0]= pat;
+    ireso->numgroups= numCaptGroups;
+    if (lazy)
+        ireso->lazy= LAZY_PENDING;
+    else {
+        istatus= _buildStates(ireso, &ieos, &failed);
+        if (istatus != ippStsNoErr) {
+            _buildError(ireso, istatus, ieos, failed);
+            goto error;
+        }
+    }
+    ireso->lock= PyThread_allocate_lock();
+    if (ireso->lock == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+	ireso->attr_dict= Py_BuildValue("{sisisOsOsOsisisisi}",
 			"statesize", statesize,
 			"groups", numCaptGroups,
 			"groupindex", groupindex,
 			"pattern", pattern,
-            "ippstatus", istatus
+			"ipppattern", ipppattern,
+            "ippstatus", istatus,
+            "shared", shared,
+            "lazy", lazy,
+            "priority", priority
             );
-	if (ireso->attr_dict == NULL) {
-		Py_DECREF(groupindex); 
+	if (ireso->attr_dict == NULL)
 		goto error;
-	}
+    Py_DECREF(groupindex);
+    Py_DECREF(ipppattern);
+    if (shared)
+        _untrackAttrs(ireso->attr_dict);
 
 	return (PyObject *)ireso;
 error:
+    Py_XDECREF(groupindex);
+    Py_XDECREF(ipppattern);
     Py_XDECREF(ireso);
     return NULL;
 }
 
+/**
+ * \brief	split an entry of a compileMulti list into pattern, flags and id
+ * \return	0 or -1 with exception set, pattern and eflags are borrowed
+ *
+ * An entry is a pattern string or a tuple (pattern[, flags[, id]]).
+ * Missing flags default to the flags of the call, ids to index + 1.
+ */
+static int
+_multiEntry(PyObject *item, PyObject *flags, int i, PyObject **pattern, \
+        PyObject **eflags, long *id)
+{
+    PyObject *pid= NULL;
+
+    *eflags= flags;
+    *id= i + 1;
+    if (PyTuple_Check(item)) {
+        if (!PyArg_ParseTuple(item, "O|OO:compileMulti entry", pattern, \
+                    eflags, &pid))
+            return -1;
+        if (*eflags == Py_None)
+            *eflags= flags;
+        if (pid && pid != Py_None) {
+            *id= PyInt_AsLong(pid);
+            if (*id == -1 && PyErr_Occurred())
+                return -1;
+            if (*id < 0 || *id > 0x7fffffffL) {
+                PyErr_SetString(PyExc_ValueError, "pattern id out of range");
+                return -1;
+            }
+        }
+    }
+    else
+        *pattern= item;
+    if (!PyString_Check(*pattern) || !PyInt_Check(*eflags)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type!");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief	entry dict of a multi object, group names parsed like compile
+ * \return	new dict with pattern, ipppattern, groups, groupindex, flags
+ *		and id, NULL with exception set
+ */
+static PyObject *
+_entryDict(PyObject *pattern, PyObject *eflags, long id)
+{
+    PyObject *groupindex, *ipppattern, *value= NULL;
+    int groups= -1;
+
+    groupindex= PyDict_New();
+    ipppattern= PyString_FromStringAndSize(NULL, PyString_GET_SIZE(pattern));
+    if (groupindex && ipppattern)
+        groups= _parseGroups(PyString_AS_STRING(pattern), \
+                PyString_GET_SIZE(pattern), PyString_AS_STRING(ipppattern), \
+                groupindex);
+    if (groups >= 0 && _PyString_Resize(&ipppattern, \
+                strlen(PyString_AS_STRING(ipppattern))) == 0)
+        value= Py_BuildValue("{sOsOsisOsOsl}",
+                "pattern", pattern,
+                "ipppattern", ipppattern,
+                "groups", groups,
+                "groupindex", groupindex,
+                "flags", eflags,
+                "id", id);
+    Py_XDECREF(groupindex);
+    Py_XDECREF(ipppattern);
+    return value;
+}
+
+/**
+ * \brief	lock, attributes and (unless lazy) states of a multi object
+ * \return	0 on success, -1 with exception set
+ *
+ * Common tail of compileMulti and loadManifest, the entry and owner
+ * arrays, statepat and stateopts must be filled. patternlist is NULL
+ * for manifests, see _getPatterns.
+ */
+static int
+_finishMulti(IppRegExpStateObject *o, PyObject *patternlist, int statesize, \
+        int savedsize, int shared, int dedup, int lazy, int priority)
+{
+    int ieos= 0, failed= 0;
+    IppStatus istatus= ippStsNoErr;
+    PyObject *value;
+
+    o->lock= PyThread_allocate_lock();
+    if (o->lock == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+	o->attr_dict= PyDict_New();
+	if (o->attr_dict == NULL)
+		return -1;
+	if (patternlist \
+            && PyDict_SetItemString(o->attr_dict, "patterns", patternlist) < 0)
+        return -1;
+    if (lazy)
+        o->lazy= LAZY_PENDING;
+    else {
+        istatus= _buildStates(o, &ieos, &failed);
+        if (istatus != ippStsNoErr) {
+            _buildError(o, istatus, ieos, failed);
+            return -1;
+        }
+    }
+    value= Py_BuildValue("{sisisisisi}",
+            "entries", o->numentries,
+            "states", o->numpatterns,
+            "duplicates", o->numentries - o->numpatterns,
+            "statesize", statesize,
+            "savedsize", savedsize);
+    if (value == NULL \
+            || PyDict_SetItemString(o->attr_dict, "report", value) < 0) {
+        Py_XDECREF(value);
+        return -1;
+    }
+    Py_DECREF(value);
+    if (_dictSetInt(o->attr_dict, s_numpatterns, o->numentries) < 0
+            || _dictSetInt(o->attr_dict, s_statesize, statesize) < 0
+            || _dictSetInt(o->attr_dict, s_ippstatus, istatus) < 0
+            || _dictSetInt(o->attr_dict, s_shared, shared) < 0)
+        return -1;
+    value= Py_BuildValue("{sisisi}", "lazy", lazy, "priority", priority, \
+            "dedup", dedup);
+    if (value == NULL || PyDict_Update(o->attr_dict, value) < 0) {
+        Py_XDECREF(value);
+        return -1;
+    }
+    Py_DECREF(value);
+    if (shared)
+        _untrackAttrs(o->attr_dict);
+    return 0;
+}
+
 /**
  * \brief	create a new IppRegExpStateMultiObject
  * \return	new IppRegExpStateMultiObject of Type IppRegExpStateObject_Type
+ *
+ * With dedup, entries with the same pattern and options share one
+ * compiled state. Every entry keeps its own id, results of a state are
+ * reported once for each entry owning it. A lazy object only checks
+ * the patterns with _checkSyntax and compiles all states on first use.
+ */
+static PyObject *
+_create_IppRegExpMultiStateObject(PyObject *patterns, PyObject *flags, \
+        int shared, int dedup, int lazy, int priority)
+{
+	char opts[6]= "\0";
+    int ieos= 0, i= 0, k, statesize= 0, ss= 0;
+    int numentries, numstates= 0, savedsize= 0;
+    long id;
+    IppStatus istatus= ippStsNoErr;
+    PyObject *value, *tmpobj, *eflags, *key, *index, *patternlist= NULL;
+    PyObject *seen= NULL, *ipppattern;
+	IppRegExpStateObject *ireso;
+
+    ireso= PyObject_New(IppRegExpStateObject, &IppRegExpStateObject_Type);
+    if (ireso == NULL)
+        goto error;
+    init_IppRegExpStateObject((PyObject *)ireso, NULL, NULL);
+    if (!PyList_Check(patterns)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type!");
+        goto error;
+    }
+    if (!PyInt_Check(flags)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type!");
+        goto error;
+    }
+    numentries= PyList_Size(patterns);
+    ireso->numentries= numentries;
+    ireso->entrystate= PyMem_New(int, numentries + 1);
+    ireso->entryids= PyMem_New(Ipp32s, numentries + 1);
+    ireso->ownerids= PyMem_New(Ipp32s, numentries + 1);
+    ireso->statepat= PyMem_New(const char *, numentries + 1);
+    ireso->stateopts= PyMem_Malloc(6 * (numentries + 1));
+    patternlist= PyList_New(numentries);
+    seen= PyDict_New();
+    if (!ireso->entrystate || !ireso->entryids || !ireso->ownerids \
+            || !ireso->statepat || !ireso->stateopts || !patternlist \
+            || !seen) {
+        PyErr_NoMemory();
+        goto free;
+    }
+    /* canonical (pattern, options) -> state */
+	for (i= 0; i < numentries; ++i) {
+        if (_multiEntry(PyList_GET_ITEM(patterns, i), flags, i, &tmpobj, \
+                    &eflags, &id) < 0)
+            goto free;
+        opts[0]= '\0';
+        _getIppOptString(eflags, opts);
+        ireso->entryids[i]= (Ipp32s)id;
+        /* ipp does not know group names, the states use ipppattern */
+        value= _entryDict(tmpobj, eflags, id);
+        if (value == NULL)
+            goto free;
+		PyList_SET_ITEM(patternlist, i, value);
+        ipppattern= PyDict_GetItemString(value, "ipppattern");
+		ippsRegExpGetSize(PyString_AS_STRING(ipppattern), &ss);
+        key= Py_BuildValue("(Os)", tmpobj, opts);
+        if (key == NULL)
+            goto free;
+        index= dedup ? PyDict_GetItem(seen, key) : NULL;
+        if (index) {
+            ireso->entrystate[i]= (int)PyInt_AS_LONG(index);
+            savedsize+= ss;
+            Py_DECREF(key);
+            continue;
+        }
+        index= PyInt_FromLong(numstates);
+        if (index == NULL || PyDict_SetItem(seen, key, index) < 0) {
+            Py_XDECREF(index);
+            Py_DECREF(key);
+            goto free;
+        }
+        Py_DECREF(index);
+        Py_DECREF(key);
+        if (lazy && (ieos= _checkSyntax(PyString_AS_STRING(ipppattern), \
+                        &istatus)) >= 0) {
+            value= Py_BuildValue("sisisi",
+                    "ippstatus", istatus,
+                    "idxerrpattern", i,
+                    "eoffset", ieos);
+            PyErr_SetObject(IppchError, value);
+            Py_XDECREF(value);
+            goto free;
+        }
+        ireso->entrystate[i]= numstates;
+        /* ipppattern is kept alive by the patterns attribute */
+        ireso->statepat[numstates]= PyString_AS_STRING(ipppattern);
+        strcpy(ireso->stateopts + 6 * numstates, opts);
+        numstates++;
+		statesize+= ss;
+	}
+	ippsRegExpMultiGetSize(numstates, &ss);
+	statesize+= ss;
+    if (shared && _mapArena(ireso, _arenaSize(statesize, numstates + 1)) < 0)
+        goto free;
+    ireso->states= PyMem_Malloc(sizeof(IppRegExpState*) * (numstates + 1));
+    ireso->capacity= PyMem_Malloc(sizeof(int) * (numstates + 1));
+    ireso->ownerstart= PyMem_New(int, numstates + 1);
+    if (!ireso->states || !ireso->capacity || !ireso->ownerstart) {
+        PyErr_NoMemory();
+        goto free;
+    }
+    memset(ireso->states, 0, sizeof(IppRegExpState*) * numstates);
+    ireso->numpatterns= numstates;
+    /* owners grouped by state, ownerstart[k] .. ownerstart[k+1] */
+    memset(ireso->ownerstart, 0, sizeof(int) * (numstates + 1));
+    for (i= 0; i < numentries; ++i)
+        ireso->ownerstart[ireso->entrystate[i] + 1]++;
+    for (k= 0; k < numstates; ++k)
+        ireso->ownerstart[k+1]+= ireso->ownerstart[k];
+    for (k= 0; k < numstates; ++k)
+        ireso->capacity[k]= ireso->ownerstart[k];
+    for (i= 0; i < numentries; ++i)
+        ireso->ownerids[ireso->capacity[ireso->entrystate[i]]++]= \
+            ireso->entryids[i];
+    for (i= 0; i < numentries; ++i) {
+        value= PyInt_FromLong(ireso->entrystate[i]);
+        if (value == NULL || PyDict_SetItemString( \
+                    PyList_GET_ITEM(patternlist, i), "state", value) < 0) {
+            Py_XDECREF(value);
+            goto free;
+        }
+        Py_DECREF(value);
+    }
+    if (_finishMulti(ireso, patternlist, statesize, savedsize, shared, \
+                dedup, lazy, priority) < 0)
+        goto free;
+    Py_DECREF(patternlist);
+    Py_DECREF(seen);
+
+	return (PyObject*)ireso;
+free:
+	Py_XDECREF(patternlist);
+    Py_XDECREF(seen);
+error:
+    Py_XDECREF(ireso);
+    return NULL;
+}
+
+/**
+ * \brief	header of a rule set manifest
+ *
+ * The sections following the header are 4 byte aligned arrays in
+ * native byte order: entrystate, entryids, entryflags and entrygroups
+ * [numentries], ownerstart[numstates+1], ownerids[numentries], the
+ * offsets [numstates] of the state patterns and of their source text,
+ * stateopts[6*numstates] and the NUL terminated strings. A loaded
+ * object points into the read only mapping of the file instead of
+ * copying the arrays. The key only rejects stale files quickly, the
+ * source text, flags and id of every entry are compared on load.
+ */
+typedef struct {
+    char magic[8];                  /**< MANIFEST_MAGIC */
+    Ipp32u version;                 /**< MANIFEST_VERSION */
+    Ipp32u key[2];                  /**< crc32c and crc32 of the rule set */
+    Ipp32u numentries;
+    Ipp32u numstates;
+    Ipp32u dedup;
+    Ipp32s statesize;
+    Ipp32s savedsize;
+    char ippversion[128];           /**< ipps and ippch library versions */
+    Ipp32u entrystate;              /**< section offsets */
+    Ipp32u entryids;
+    Ipp32u entryflags;
+    Ipp32u entrygroups;
+    Ipp32u ownerstart;
+    Ipp32u ownerids;
+    Ipp32u statepat;
+    Ipp32u statesrc;
+    Ipp32u stateopts;
+    Ipp32u strings;
+    Ipp32u size;                    /**< size of the whole file */
+} IppchManifest;
+
+/**
+ * \brief	versions of the libraries the manifest is valid for
+ */
+static void
+_ippVersion(char *buf, size_t size)
+{
+    const IppLibraryVersion *s= ippsGetLibVersion();
+    const IppLibraryVersion *ch= ippchGetLibVersion();
+
+    snprintf(buf, size, "%s %s %s; %s %s %s", s->Name, s->Version, \
+            s->BuildDate, ch->Name, ch->Version, ch->BuildDate);
+}
+
+/**
+ * \brief	add one entry to a rule set key
+ */
+static void
+_keyEntry(Ipp32u *key, PyObject *pattern, PyObject *eflags, long id)
+{
+    Ipp32s v[3];
+
+    v[0]= (Ipp32s)PyString_GET_SIZE(pattern);
+    v[1]= (Ipp32s)PyInt_AS_LONG(eflags);
+    v[2]= (Ipp32s)id;
+    ippsCRC32C_8u((const Ipp8u *)v, sizeof(v), &key[0]);
+    ippsCRC32_8u((const Ipp8u *)v, sizeof(v), &key[1]);
+    ippsCRC32C_8u((const Ipp8u *)PyString_AS_STRING(pattern), \
+            (Ipp32u)v[0], &key[0]);
+    ippsCRC32_8u((const Ipp8u *)PyString_AS_STRING(pattern), v[0], &key[1]);
+}
+
+/**
+ * \brief	start a rule set key with the library versions and dedup
+ */
+static void
+_keyStart(Ipp32u *key, char *version, size_t size, int dedup, int n)
+{
+    Ipp32s v[2];
+
+    _ippVersion(version, size);
+    key[0]= key[1]= 0;
+    v[0]= dedup;
+    v[1]= n;
+    ippsCRC32C_8u((const Ipp8u *)version, (Ipp32u)strlen(version), &key[0]);
+    ippsCRC32_8u((const Ipp8u *)version, (int)strlen(version), &key[1]);
+    ippsCRC32C_8u((const Ipp8u *)v, sizeof(v), &key[0]);
+    ippsCRC32_8u((const Ipp8u *)v, sizeof(v), &key[1]);
+}
+
+/**
+ * \brief	patterns attribute of a multi object
+ * \return	borrowed list, NULL with exception set
+ *
+ * Objects loaded from a manifest build the list of entry dicts from
+ * the mapping on first access only.
+ */
+static PyObject *
+_getPatterns(IppRegExpStateObject *o)
+{
+    const IppchManifest *h= (const IppchManifest *)o->manifest;
+    const Ipp32s *eflagsv;
+    const Ipp32u *srcoff;
+    PyObject *patternlist, *value, *pattern, *eflags, *state;
+    Ipp32u i;
+
+    patternlist= o->attr_dict ? \
+        PyDict_GetItemString(o->attr_dict, "patterns") : NULL;
+    if (patternlist || h == NULL) {
+        if (patternlist == NULL)
+            PyErr_SetString(PyExc_AttributeError, "patterns");
+        return patternlist;
+    }
+    eflagsv= (const Ipp32s *)(o->manifest + h->entryflags);
+    srcoff= (const Ipp32u *)(o->manifest + h->statesrc);
+    patternlist= PyList_New(h->numentries);
+    if (patternlist == NULL)
+        return NULL;
+    for (i= 0; i < h->numentries; ++i) {
+        pattern= PyString_FromString(o->manifest + srcoff[o->entrystate[i]]);
+        eflags= PyInt_FromLong(eflagsv[i]);
+        state= PyInt_FromLong(o->entrystate[i]);
+        value= pattern && eflags && state ? \
+            _entryDict(pattern, eflags, o->entryids[i]) : NULL;
+        if (value && PyDict_SetItemString(value, "state", state) < 0)
+            Py_CLEAR(value);
+        Py_XDECREF(pattern);
+        Py_XDECREF(eflags);
+        Py_XDECREF(state);
+        if (value == NULL) {
+            Py_DECREF(patternlist);
+            return NULL;
+        }
+		PyList_SET_ITEM(patternlist, i, value);
+    }
+    if (PyDict_SetItemString(o->attr_dict, "patterns", patternlist) < 0) {
+        Py_DECREF(patternlist);
+        return NULL;
+    }
+    Py_DECREF(patternlist);
+    value= PyDict_GetItemString(o->attr_dict, "shared");
+    if (value && PyObject_IsTrue(value))
+        _untrackAttrs(o->attr_dict);
+    return patternlist;
+}
+
+/**
+ * \brief	getter of the patterns attribute
+ */
+static PyObject *
+_getattr_patterns(PyObject *self, void *closure)
+{
+    PyObject *patterns= _getPatterns((IppRegExpStateObject *)self);
+
+    Py_XINCREF(patterns);
+    return patterns;
+}
+
+/**
+ * \brief	IppRegExpStateObject method writing a rule set manifest
+ * \return	None
+ *
+ * The file is written next to path and renamed, so readers never see
+ * a partial manifest.
+ */
+static PyObject *
+save_manifest(PyObject *self, PyObject *args)
+{
+    IppRegExpStateObject *o= (IppRegExpStateObject *)self;
+    IppchManifest h;
+    PyObject *patterns, *report, *entry, *value, *tmpname= NULL;
+    char *path, *buf= NULL;
+    const char **src= NULL;
+    Ipp32u off, *patoff, *srcoff;
+    Ipp32s *flags, *groups;
+    int i, k, ns, ne, len;
+    FILE *f;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+        return NULL;
+    if (o->entrystate == NULL || o->attr_dict == NULL) {
+        PyErr_SetString(IppchError, "manifests need a compileMulti object");
+        return NULL;
+    }
+    patterns= _getPatterns(o);
+    value= PyDict_GetItemString(o->attr_dict, "dedup");
+    report= PyDict_GetItemString(o->attr_dict, "report");
+    if (patterns == NULL || value == NULL || report == NULL) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(IppchError, "rule set attributes missing");
+        return NULL;
+    }
+    ns= o->numpatterns;
+    ne= o->numentries;
+    /* source text of every state, taken from its first entry */
+    src= PyMem_New(const char *, ns + 1);
+    if (src == NULL)
+        return PyErr_NoMemory();
+    for (i= ne - 1; i >= 0; --i)
+        src[o->entrystate[i]]= PyString_AS_STRING(PyDict_GetItemString( \
+                    PyList_GET_ITEM(patterns, i), "pattern"));
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MANIFEST_MAGIC, sizeof(h.magic));
+    h.version= MANIFEST_VERSION;
+    h.numentries= ne;
+    h.numstates= ns;
+    h.dedup= PyInt_AsLong(value) != 0;
+    _keyStart(h.key, h.ippversion, sizeof(h.ippversion), h.dedup, ne);
+    for (i= 0; i < ne; ++i) {
+        entry= PyList_GET_ITEM(patterns, i);
+        _keyEntry(h.key, PyDict_GetItemString(entry, "pattern"), \
+                PyDict_GetItemString(entry, "flags"), o->entryids[i]);
+    }
+    h.statesize= PyInt_AsLong(PyDict_GetItemString(report, "statesize"));
+    h.savedsize= PyInt_AsLong(PyDict_GetItemString(report, "savedsize"));
+    off= sizeof(h);
+    h.entrystate= off;  off+= 4 * ne;
+    h.entryids= off;    off+= 4 * ne;
+    h.entryflags= off;  off+= 4 * ne;
+    h.entrygroups= off; off+= 4 * ne;
+    h.ownerstart= off;  off+= 4 * (ns + 1);
+    h.ownerids= off;    off+= 4 * ne;
+    h.statepat= off;    off+= 4 * ns;
+    h.statesrc= off;    off+= 4 * ns;
+    h.stateopts= off;   off+= (6 * ns + 3) & ~3;
+    h.strings= off;
+    for (k= 0; k < ns; ++k)
+        off+= strlen(o->statepat[k]) + strlen(src[k]) + 2;
+    h.size= off;
+    buf= PyMem_Malloc(h.size);
+    if (buf == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    memset(buf, 0, h.size);
+    memcpy(buf, &h, sizeof(h));
+    memcpy(buf + h.entrystate, o->entrystate, 4 * ne);
+    memcpy(buf + h.entryids, o->entryids, 4 * ne);
+    memcpy(buf + h.ownerstart, o->ownerstart, 4 * (ns + 1));
+    memcpy(buf + h.ownerids, o->ownerids, 4 * ne);
+    memcpy(buf + h.stateopts, o->stateopts, 6 * ns);
+    flags= (Ipp32s *)(buf + h.entryflags);
+    groups= (Ipp32s *)(buf + h.entrygroups);
+    for (i= 0; i < ne; ++i) {
+        entry= PyList_GET_ITEM(patterns, i);
+        flags[i]= PyInt_AsLong(PyDict_GetItemString(entry, "flags"));
+        groups[i]= PyInt_AsLong(PyDict_GetItemString(entry, "groups"));
+    }
+    patoff= (Ipp32u *)(buf + h.statepat);
+    srcoff= (Ipp32u *)(buf + h.statesrc);
+    for (off= h.strings, k= 0; k < ns; ++k) {
+        len= strlen(o->statepat[k]) + 1;
+        patoff[k]= off;
+        memcpy(buf + off, o->statepat[k], len);
+        off+= len;
+        len= strlen(src[k]) + 1;
+        srcoff[k]= off;
+        memcpy(buf + off, src[k], len);
+        off+= len;
+    }
+    tmpname= PyString_FromFormat("%s.%d.tmp", path, (int)getpid());
+    if (tmpname == NULL)
+        goto error;
+    f= fopen(PyString_AS_STRING(tmpname), "wb");
+    if (f == NULL) {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        goto error;
+    }
+    if (fwrite(buf, 1, h.size, f) != h.size) {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        fclose(f);
+        unlink(PyString_AS_STRING(tmpname));
+        goto error;
+    }
+    if (fclose(f) != 0 || rename(PyString_AS_STRING(tmpname), path) < 0) {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+        unlink(PyString_AS_STRING(tmpname));
+        goto error;
+    }
+    Py_DECREF(tmpname);
+    PyMem_Free(buf);
+    PyMem_Free(src);
+    Py_RETURN_NONE;
+error:
+    Py_XDECREF(tmpname);
+    PyMem_Free(buf);
+    PyMem_Free(src);
+    return NULL;
+}
+
+/**
+ * \brief	check that a manifest string starts in the strings section
+ *		and is NUL terminated inside the file
+ * \return	1 if it is, 0 if not
+ */
+static int
+_manifestString(const char *map, size_t size, Ipp32u strings, Ipp32u off)
+{
+    return off >= strings && off < size \
+        && memchr(map + off, '\0', size - off) != NULL;
+}
+
+/**
+ * \brief	check that a mapped manifest is complete and consistent
+ * \return	1 if it can be used, 0 if not
+ *
+ * Every string handed to ippsRegExpInit or compared on load has to be
+ * NUL terminated inside the mapping, the options of a state inside its
+ * 6 bytes.
+ */
+static int
+_checkManifest(const char *map, size_t size, const IppchManifest *want)
+{
+    const IppchManifest *h= (const IppchManifest *)map;
+    const Ipp32s *state, *start;
+    const Ipp32u *patoff, *srcoff;
+    size_t ne, ns, i;
+
+    if (size < sizeof(*h) || memcmp(h->magic, MANIFEST_MAGIC, 8) != 0 \
+            || h->version != MANIFEST_VERSION || h->size != size \
+            || h->key[0] != want->key[0] || h->key[1] != want->key[1] \
+            || h->numentries != want->numentries || h->dedup != want->dedup \
+            || strncmp(h->ippversion, want->ippversion, \
+                sizeof(h->ippversion)) != 0)
+        return 0;
+    ne= h->numentries;
+    ns= h->numstates;
+    if (ns > ne || h->strings > size || map[size-1] != '\0' \
+            || h->entrystate + 4 * ne > size || h->entryids + 4 * ne > size \
+            || h->entryflags + 4 * ne > size \
+            || h->entrygroups + 4 * ne > size \
+            || h->ownerstart + 4 * (ns + 1) > size \
+            || h->ownerids + 4 * ne > size || h->statepat + 4 * ns > size \
+            || h->statesrc + 4 * ns > size \
+            || h->stateopts + 6 * ns > h->strings \
+            || ((h->entrystate | h->entryids | h->entryflags | h->entrygroups \
+                    | h->ownerstart | h->ownerids | h->statepat \
+                    | h->statesrc) & 3))
+        return 0;
+    state= (const Ipp32s *)(map + h->entrystate);
+    for (i= 0; i < ne; ++i)
+        if (state[i] < 0 || (Ipp32u)state[i] >= ns)
+            return 0;
+    start= (const Ipp32s *)(map + h->ownerstart);
+    for (i= 0; i < ns; ++i)
+        if (start[i] < 0 || start[i] > start[i+1])
+            return 0;
+    if (start[ns] != (Ipp32s)ne)
+        return 0;
+    patoff= (const Ipp32u *)(map + h->statepat);
+    srcoff= (const Ipp32u *)(map + h->statesrc);
+    for (i= 0; i < ns; ++i)
+        if (!_manifestString(map, size, h->strings, patoff[i]) \
+                || !_manifestString(map, size, h->strings, srcoff[i]) \
+                || memchr(map + h->stateopts + 6 * i, '\0', 6) == NULL)
+            return 0;
+    return 1;
+}
+
+/**
+ * \brief	compare the entries of a checked manifest with the rule set
+ * \return	1 if every entry has the same source text, flags and id,
+ *		0 if not, -1 with exception set
+ */
+static int
+_matchManifest(const char *map, PyObject *patterns, PyObject *flags)
+{
+    const IppchManifest *h= (const IppchManifest *)map;
+    const Ipp32s *state= (const Ipp32s *)(map + h->entrystate);
+    const Ipp32s *ids= (const Ipp32s *)(map + h->entryids);
+    const Ipp32s *eflagsv= (const Ipp32s *)(map + h->entryflags);
+    const Ipp32u *srcoff= (const Ipp32u *)(map + h->statesrc);
+    PyObject *tmpobj, *eflags;
+    const char *text;
+    Ipp32u i;
+    long id;
+
+    for (i= 0; i < h->numentries; ++i) {
+        if (_multiEntry(PyList_GET_ITEM(patterns, i), flags, i, &tmpobj, \
+                    &eflags, &id) < 0)
+            return -1;
+        text= map + srcoff[state[i]];
+        if (id != ids[i] || PyInt_AS_LONG(eflags) != eflagsv[i] \
+                || strlen(text) != (size_t)PyString_GET_SIZE(tmpobj) \
+                || memcmp(text, PyString_AS_STRING(tmpobj), \
+                    PyString_GET_SIZE(tmpobj)) != 0)
+            return 0;
+    }
+    return 1;
+}
+
+/**
+ * \brief	load a rule set manifest written by saveManifest
+ * \return	IppRegExpStateObject or None if the manifest is missing or
+ *          does not match patterns, flags, dedup and the libraries
+ *
+ * Only the IPP states are compiled (unless lazy), the analysis of the
+ * patterns done by compileMulti is taken from the manifest.
+ */
+static PyObject *
+_loadManifest(PyObject *self, PyObject *args)
+{
+    char *path, *map= MAP_FAILED;
+    PyObject *patterns, *flags, *tmpobj, *eflags, *value;
+    int dedup= 1, shared= 0, lazy= 0, priority= 0, fd, i, k;
+    long id;
+    struct stat st;
+    IppchManifest want;
+    const IppchManifest *h;
+    const Ipp32u *patoff;
+	IppRegExpStateObject *ireso= NULL;
+
+    if (!PyArg_ParseTuple(args, "sOO|iiii", &path, &patterns, &flags, \
+                &dedup, &shared, &lazy, &priority))
+        return NULL;
+    if (!PyList_Check(patterns) || !PyInt_Check(flags)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type!");
+        return NULL;
+    }
+    memset(&want, 0, sizeof(want));
+    want.numentries= PyList_GET_SIZE(patterns);
+    want.dedup= dedup != 0;
+    _keyStart(want.key, want.ippversion, sizeof(want.ippversion), \
+            want.dedup, want.numentries);
+	for (i= 0; i < (int)want.numentries; ++i) {
+        if (_multiEntry(PyList_GET_ITEM(patterns, i), flags, i, &tmpobj, \
+                    &eflags, &id) < 0)
+            return NULL;
+        _keyEntry(want.key, tmpobj, eflags, id);
+    }
+    fd= open(path, O_RDONLY);
+    if (fd < 0) {
+        if (errno == ENOENT)
+            Py_RETURN_NONE;
+        return PyErr_SetFromErrnoWithFilename(PyExc_IOError, path);
+    }
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(IppchManifest))
+        map= mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        Py_RETURN_NONE;
+    if (!_checkManifest(map, st.st_size, &want) \
+            || (i= _matchManifest(map, patterns, flags)) <= 0) {
+        munmap(map, st.st_size);
+        if (PyErr_Occurred())
+            return NULL;
+        Py_RETURN_NONE;
+    }
+    h= (const IppchManifest *)map;
+    ireso= PyObject_New(IppRegExpStateObject, &IppRegExpStateObject_Type);
+    if (ireso == NULL) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    init_IppRegExpStateObject((PyObject *)ireso, NULL, NULL);
+    ireso->manifest= map;
+    ireso->manifestsize= st.st_size;
+    ireso->numentries= h->numentries;
+    ireso->numpatterns= h->numstates;
+    ireso->entrystate= (int *)(map + h->entrystate);
+    ireso->entryids= (Ipp32s *)(map + h->entryids);
+    ireso->ownerstart= (int *)(map + h->ownerstart);
+    ireso->ownerids= (Ipp32s *)(map + h->ownerids);
+    ireso->stateopts= map + h->stateopts;
+    ireso->statepat= PyMem_New(const char *, h->numstates + 1);
+    ireso->states= PyMem_Malloc(sizeof(IppRegExpState*) * (h->numstates + 1));
+    ireso->capacity= PyMem_Malloc(sizeof(int) * (h->numstates + 1));
+    if (!ireso->statepat || !ireso->states || !ireso->capacity) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    memset(ireso->states, 0, sizeof(IppRegExpState*) * h->numstates);
+    patoff= (const Ipp32u *)(map + h->statepat);
+    for (k= 0; k < (int)h->numstates; ++k)
+        ireso->statepat[k]= map + patoff[k];
+    /* the patterns attribute is built from the mapping on first access */
+    if (shared && _mapArena(ireso, \
+                _arenaSize(h->statesize, h->numstates + 1)) < 0)
+        goto error;
+    if (_finishMulti(ireso, NULL, h->statesize, h->savedsize, shared, \
+                dedup, lazy, priority) < 0)
+        goto error;
+    value= PyString_FromString(path);
+    if (value == NULL \
+            || PyDict_SetItemString(ireso->attr_dict, "manifest", value) < 0) {
+        Py_XDECREF(value);
+        goto error;
+    }
+    Py_DECREF(value);
+    return (PyObject *)ireso;
+error:
+    Py_DECREF(ireso);
+    return NULL;
+}
+
+/**
+ * \brief	IppRegExpStateObject method returning state size
+ * \return	size of the IppRegExpState! (not IppRegExpStateObject)
+ */
+static PyObject *
+get_state_size(PyObject *self, PyObject *args)
+{
+	PyObject *_size;
+	IppRegExpStateObject *o= (IppRegExpStateObject*)self;
+	if (o->ires == NULL) {
+		return Py_BuildValue("i", 0);
+	}
+	_size= PyDict_GetItemString(o->attr_dict, "statesize");
+	if (_size == NULL)
+		return Py_BuildValue("i", 0);
+	/* XXX(haai): borrowed reference?!? */
+	return _size;
+}
+/**
+ * \brief	tells whether the IPP states of the object exist
+ * \return	False while a lazy object waits for its first use
+ */
+static PyObject *
+is_compiled(PyObject *self, PyObject *args)
+{
+    IppRegExpStateObject *o= (IppRegExpStateObject *)self;
+
+    return PyBool_FromLong( \
+            __atomic_load_n(&o->lazy, __ATOMIC_ACQUIRE) == LAZY_NONE \
+            && (o->ires != NULL || o->irems != NULL));
+}
+
+
+/**
+ * \brief	timers of the native profiler
+ */
+enum {
+    PROF_FIND= 0,                       /**< ippsRegExpFind_8u calls */
+    PROF_MULTIFIND,                     /**< ippsRegExpMultiFind_8u calls */
+    PROF_BATCH,                         /**< whole *Into batch calls */
+    PROF_ASYNC,                         /**< *_async submit to scan done */
+    PROF_NUMTIMERS
+};
+
+static const char *prof_names[PROF_NUMTIMERS]= {
+    "find", "multifind", "batch", "async"
+};
+
+/**
+ * \brief	log-linear cycle histogram of one timer
+ *
+ * Bucket i < 8 counts i cycles, above each power of two is split into
+ * 8 linear sub buckets, so percentiles are exact to 12.5%.
+ */
+typedef struct {
+    Ipp64u count;
+    Ipp64u cycles;                      /**< sum of cycles */
+    Ipp64u max;                         /**< max cycles */
+    Ipp64u buckets[PROF_BUCKETS];
+} IppchTimer;
+
+/**
+ * \brief	record of the trace ring
+ */
+typedef struct {
+    Ipp64u tsc;                         /**< clocks at scan start */
+    Ipp32u cycles;                      /**< duration, saturated */
+    Ipp32s timer;                       /**< PROF_* */
+    Ipp64s len;                         /**< bytes scanned */
+} IppchTrace;
+
+/**
+ * \brief	trace ring, size never changes after publication
+ */
+typedef struct {
+    Ipp64u size;                        /**< records in the ring */
+    volatile Ipp64u pos;                /**< records ever written */
+    IppchTrace records[1];
+} IppchTraceRing;
+
+static volatile int prof_enabled;       /**< timers are updated */
+static int prof_mhz;                    /**< calibrated tsc frequency */
+static IppchTimer prof_timers[PROF_NUMTIMERS];
+static IppchTraceRing * volatile prof_ring; /**< trace ring or NULL */
+static volatile int prof_users;         /**< threads accessing prof_ring */
+
+/**
+ * \brief	pin the trace ring for use without the GIL
+ * \return	ring or NULL, call _profUnpin afterwards in both cases
+ *
+ * The user count is raised before the pointer is read, a ring replaced
+ * by _profEnable is freed only after the count dropped to zero.
+ */
+static IppchTraceRing *
+_profPin(void)
+{
+    __sync_fetch_and_add(&prof_users, 1);
+    return prof_ring;
+}
+
+/**
+ * \brief	release a ring returned by _profPin
+ */
+static void
+_profUnpin(void)
+{
+    __sync_fetch_and_sub(&prof_users, 1);
+}
+
+/**
+ * \brief	start a measurement
+ * \return	current tsc or 0 if profiling is disabled
+ */
+static Ipp64u
+_profStart(void)
+{
+    return prof_enabled ? ippGetCpuClocks() : 0;
+}
+
+/**
+ * \brief	histogram bucket of a cycle count
+ */
+static int
+_profBucket(Ipp64u v)
+{
+    int e= 0;
+
+    if (v < 8)
+        return (int)v;
+    while ((v >> e) >= 16)
+        e++;
+    /* v >> e is in [8, 16) */
+    return (e + 1) * 8 + (int)((v >> e) & 7);
+}
+
+/**
+ * \brief	upper bound in cycles of a histogram bucket
+ */
+static Ipp64u
+_profBucketLimit(int i)
+{
+    if (i < 8)
+        return (Ipp64u)i;
+    return ((Ipp64u)(8 + i % 8 + 1) << (i / 8 - 1)) - 1;
+}
+
+/**
+ * \brief	finish a measurement started at t0, safe without GIL
+ */
+static void
+_profRecord(int timer, Ipp64u t0, Ipp64s len)
+{
+    Ipp64u c, m, pos;
+    IppchTimer *t= prof_timers + timer;
+    IppchTraceRing *ring;
+    IppchTrace *r;
+
+    if (t0 == 0)
+        return;
+    c= ippGetCpuClocks() - t0;
+    __sync_fetch_and_add(&t->count, 1);
+    __sync_fetch_and_add(&t->cycles, c);
+    __sync_fetch_and_add(&t->buckets[_profBucket(c)], 1);
+    for (m= t->max; c > m; m= t->max)
+        if (__sync_bool_compare_and_swap(&t->max, m, c))
+            break;
+    if (prof_ring == NULL)
+        return;
+    ring= _profPin();
+    if (ring) {
+        pos= __sync_fetch_and_add(&ring->pos, 1);
+        r= ring->records + pos % ring->size;
+        r->tsc= t0;
+        r->cycles= c > 0xffffffffULL ? 0xffffffffU : (Ipp32u)c;
+        r->timer= timer;
+        r->len= len;
+    }
+    _profUnpin();
+}
+
+/**
+ * \brief	convert cycles to nanoseconds with the calibrated frequency
+ */
+static double
+_profNs(Ipp64u cycles)
+{
+    return prof_mhz > 0 ? (double)cycles * 1000.0 / prof_mhz : 0.0;
+}
+
+/**
+ * \brief	enables or disables the native profiler
+ *
+ * Enabling calibrates the tsc frequency once. With tracesize > 0 the
+ * last tracesize scans are kept in a ring for _profDump.
+ */
+static PyObject *
+_profEnable(PyObject *self, PyObject *args)
+{
+    int on;
+    Py_ssize_t tracesize= 0;
+    IppchTraceRing *ring, *old;
+
+    if (!PyArg_ParseTuple(args, "i|n", &on, &tracesize))
+        return NULL;
+    if (tracesize < 0) {
+        PyErr_SetString(PyExc_ValueError, "invalid trace size");
+        return NULL;
+    }
+    prof_enabled= 0;
+    if (!on)
+        Py_RETURN_NONE;
+    if (prof_mhz <= 0 && ippGetCpuFreqMhz(&prof_mhz) != ippStsNoErr) {
+        PyErr_SetString(IppchError, "could not calibrate the cpu frequency");
+        return NULL;
+    }
+    old= prof_ring;
+    if ((Ipp64u)tracesize != (old ? old->size : 0)) {
+        ring= NULL;
+        if (tracesize > 0) {
+            ring= calloc(1, sizeof(IppchTraceRing) \
+                    + (tracesize - 1) * sizeof(IppchTrace));
+            if (ring == NULL)
+                return PyErr_NoMemory();
+            ring->size= tracesize;
+        }
+        __sync_synchronize();
+        prof_ring= ring;
+        __sync_synchronize();
+        /* scans in flight may still write the old ring, they hold it
+         * only for a few stores */
+        if (old) {
+            Py_BEGIN_ALLOW_THREADS
+            while (prof_users > 0)
+                sched_yield();
+            Py_END_ALLOW_THREADS
+            free(old);
+        }
+    }
+    prof_enabled= 1;
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	clears all timers and the trace ring
+ */
+static PyObject *
+_profReset(PyObject *self, PyObject *args)
+{
+    memset(prof_timers, 0, sizeof(prof_timers));
+    if (prof_ring)
+        prof_ring->pos= 0;
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	percentile of a timer histogram in cycles
+ */
+static Ipp64u
+_profPercentile(const IppchTimer *t, double q)
+{
+    int i;
+    Ipp64u n= 0, want= (Ipp64u)(q * t->count + 0.5);
+
+    if (want == 0)
+        want= 1;
+    for (i= 0; i < PROF_BUCKETS; ++i) {
+        n+= t->buckets[i];
+        if (n >= want)
+            return _profBucketLimit(i) < t->max ? _profBucketLimit(i) : t->max;
+    }
+    return t->max;
+}
+
+/**
+ * \brief	returns the timers as {name: {count, mean, p50, p99, p999, max}}
+ *
+ * All times are in nanoseconds.
+ */
+static PyObject *
+_profStats(PyObject *self, PyObject *args)
+{
+    int i;
+    PyObject *retval, *v;
+    IppchTimer t;
+
+    retval= PyDict_New();
+    if (retval == NULL)
+        return NULL;
+    for (i= 0; i < PROF_NUMTIMERS; ++i) {
+        memcpy(&t, prof_timers + i, sizeof(IppchTimer));
+        v= Py_BuildValue("{sKsdsdsdsdsd}",
+                "count", (unsigned PY_LONG_LONG)t.count,
+                "mean", t.count ? _profNs(t.cycles) / t.count : 0.0,
+                "p50", _profNs(_profPercentile(&t, 0.50)),
+                "p99", _profNs(_profPercentile(&t, 0.99)),
+                "p999", _profNs(_profPercentile(&t, 0.999)),
+                "max", _profNs(t.max));
+        if (v == NULL || PyDict_SetItemString(retval, prof_names[i], v) < 0) {
+            Py_XDECREF(v);
+            Py_DECREF(retval);
+            return NULL;
+        }
+        Py_DECREF(v);
+    }
+    v= PyInt_FromLong(prof_mhz);
+    if (v == NULL || PyDict_SetItemString(retval, "mhz", v) < 0) {
+        Py_XDECREF(v);
+        Py_DECREF(retval);
+        return NULL;
+    }
+    Py_DECREF(v);
+    return retval;
+}
+
+/**
+ * \brief	writes the trace ring oldest first as text to path
+ * \return	number of records written
+ *
+ * One line per scan: tsc timer cycles ns bytes
+ */
+static PyObject *
+_profDump(PyObject *self, PyObject *args)
+{
+    const char *path;
+    FILE *f;
+    Ipp64u i, first, last;
+    IppchTraceRing *ring;
+    IppchTrace *r;
+    int err= 0;
+
+    if (!PyArg_ParseTuple(args, "s", &path))
+        return NULL;
+    ring= _profPin();
+    if (ring == NULL) {
+        _profUnpin();
+        PyErr_SetString(IppchError, "tracing is not enabled");
+        return NULL;
+    }
+    last= ring->pos;
+    first= last > ring->size ? last - ring->size : 0;
+    Py_BEGIN_ALLOW_THREADS
+    f= fopen(path, "w");
+    if (f) {
+        fprintf(f, "# tsc timer cycles ns bytes (%i MHz)\n", prof_mhz);
+        for (i= first; i < last; ++i) {
+            r= ring->records + i % ring->size;
+            fprintf(f, "%llu %s %u %.0f %lld\n", (unsigned long long)r->tsc, \
+                    prof_names[r->timer], r->cycles, _profNs(r->cycles), \
+                    (long long)r->len);
+        }
+        err= ferror(f);
+        if (fclose(f) != 0)
+            err= 1;
+    }
+    _profUnpin();
+    Py_END_ALLOW_THREADS
+    if (f == NULL || err) {
+        PyErr_SetFromErrnoWithFilename(PyExc_IOError, (char *)path);
+        return NULL;
+    }
+    return PyLong_FromUnsignedLongLong(last - first);
+}
+
+/**
+ * \brief	run ippsRegExpFind_8u with the state lock held
+ *
+ * Must be called with the lock held and may be called without the GIL.
+ */
+static IppStatus
+_findUnlocked(IppRegExpState *ires, const Ipp8u *src, int len, \
+        IppRegExpFind *find, int *numfind)
+{
+    IppStatus istatus;
+    Ipp64u t0;
+
+    if (ires == NULL)
+        return ippStsNullPtrErr;
+    t0= _profStart();
+    istatus= ippsRegExpFind_8u(src, len, ires, find, numfind);
+    _profRecord(PROF_FIND, t0, len);
+    return istatus;
+}
+
+/**
+ * \brief	run ippsRegExpFind_8u on ires, a state of o, serialized by its lock
+ * \return	ipp status
+ *
+ * Must be called with the GIL held. Short sources are scanned with the
+ * GIL held when the lock is free, otherwise the GIL is released while
+ * waiting and scanning. The lock is never held while waiting for the GIL.
+ */
+static IppStatus
+_findWith(IppRegExpStateObject *o, IppRegExpState *ires, const Ipp8u *src, \
+        int len, IppRegExpFind *find, int *numfind)
+{
+    IppStatus istatus;
+
+    if (len < NOGIL_THRESHOLD && PyThread_acquire_lock(o->lock, 0)) {
+        istatus= _findUnlocked(ires, src, len, find, numfind);
+        PyThread_release_lock(o->lock);
+        return istatus;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(o->lock, 1);
+    istatus= _findUnlocked(ires, src, len, find, numfind);
+    PyThread_release_lock(o->lock);
+    Py_END_ALLOW_THREADS
+    return istatus;
+}
+
+/**
+ * \brief	_findWith on the state of the compiled pattern
+ */
+static IppStatus
+_find(IppRegExpStateObject *o, const Ipp8u *src, int len, \
+        IppRegExpFind *find, int *numfind)
+{
+    return _findWith(o, o->ires, src, len, find, numfind);
+}
+
+/**
+ * \brief	run ippsRegExpMultiFind_8u with the state lock held
+ */
+static IppStatus
+_multiFindUnlocked(const IppRegExpMultiState *irems, int numpatterns, \
+        const int *capacity, const Ipp8u *src, int len, \
+        IppRegExpMultiFind *multifind)
+{
+    int i;
+    IppStatus istatus;
+    Ipp64u t0;
+
+    if (irems == NULL)
+        return ippStsNullPtrErr;
+    for (i= 0; i < numpatterns; ++i)
+        multifind[i].numMultiFind= capacity[i];
+    t0= _profStart();
+    istatus= ippsRegExpMultiFind_8u(src, len, multifind, irems);
+    _profRecord(PROF_MULTIFIND, t0, len);
+    return istatus;
+}
+
+/**
+ * \brief	monotonic time in seconds
+ */
+static double
+_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * \brief	best time of repeat multi finds over src, no GIL needed
+ */
+static double
+_timeMultiFind(const IppRegExpMultiState *irems, int numpatterns, \
+        const int *capacity, IppRegExpMultiFind *multifind, \
+        const Ipp8u *src, int len, int repeat)
+{
+    double t, best= -1.0;
+    int r;
+
+    for (r= 0; r < repeat; ++r) {
+        t= _now();
+        _multiFindUnlocked(irems, numpatterns, capacity, src, len, multifind);
+        t= _now() - t;
+        if (best < 0.0 || t < best)
+            best= t;
+    }
+    return best;
+}
+
+/**
+ * \brief	measure the scan time saved by dedup on a sample
+ * \return	report dict with scantime, fullscantime and scansaved
+ *
+ * A temporary multi state with one state per entry, as compiled
+ * without dedup, is scanned over sample next to the deduplicated one.
+ * Times are the best of repeat runs in seconds and are kept in the
+ * report attribute.
+ */
+static PyObject *
+measure_dedup(PyObject *self, PyObject *args)
+{
+    IppRegExpStateObject *o= (IppRegExpStateObject *)self;
+    IppRegExpMultiState *full= NULL;
+    IppRegExpState **states= NULL;
+    IppRegExpMultiFind *mf= NULL;
+    IppStatus istatus= ippStsNoMemErr;
+    PyObject *report, *value;
+    Py_buffer view;
+    int *cap= NULL, i, k, ieos= 0, repeat= 5, ne= o->numentries;
+    double tdedup= 0.0, tfull= 0.0;
+
+    if (!PyArg_ParseTuple(args, "s*|i", &view, &repeat))
+        return NULL;
+    if (o->entrystate == NULL || _ensureState(o, 1) < 0) {
+        if (!PyErr_Occurred())
+            PyErr_SetString(IppchError, "No IppRegExpMultiState was created.");
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    if (repeat < 1)
+        repeat= 1;
+    Py_BEGIN_ALLOW_THREADS
+    states= calloc(ne + 1, sizeof(IppRegExpState *));
+    cap= calloc(ne + 1, sizeof(int));
+    if (states && cap)
+        istatus= ippsRegExpMultiInitAlloc(&full, (Ipp32u)ne);
+    for (i= 0; istatus == ippStsNoErr && i < ne; ++i) {
+        k= o->entrystate[i];
+        cap[i]= o->capacity[k];
+        istatus= ippsRegExpInitAlloc(o->statepat[k], o->stateopts + 6 * k, \
+                &states[i], &ieos);
+        if (istatus == ippStsNoErr)
+            istatus= ippsRegExpMultiAdd(states[i], (Ipp32u)(i+1), full);
+    }
+    if (istatus == ippStsNoErr) {
+        mf= _newMultiFind(ne, cap);
+        if (mf == NULL)
+            istatus= ippStsNoMemErr;
+    }
+    if (istatus == ippStsNoErr) {
+        tfull= _timeMultiFind(full, ne, cap, mf, view.buf, (int)view.len, \
+                repeat);
+        PyThread_acquire_lock(o->lock, 1);
+        tdedup= _timeMultiFind(o->irems, o->numpatterns, o->capacity, \
+                o->multifind, view.buf, (int)view.len, repeat);
+        PyThread_release_lock(o->lock);
+    }
+    free(mf);
+    if (full)
+        ippsRegExpMultiFree(full);
+    for (i= 0; states && i < ne; ++i)
+        if (states[i])
+            ippsRegExpFree(states[i]);
+    free(states);
+    free(cap);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("sisi", "ippstatus", istatus, "eoffset", ieos);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        return NULL;
+    }
+    report= PyDict_GetItemString(o->attr_dict, "report");
+    if (report == NULL) {
+        PyErr_SetString(IppchError, "no compile report");
+        return NULL;
+    }
+    value= Py_BuildValue("{sdsdsd}",
+            "scantime", tdedup,
+            "fullscantime", tfull,
+            "scansaved", tfull - tdedup);
+    if (value == NULL || PyDict_Update(report, value) < 0) {
+        Py_XDECREF(value);
+        return NULL;
+    }
+    Py_DECREF(value);
+    Py_INCREF(report);
+    return report;
+}
+
+/**
+ * \brief	build the python result list of a multi find
+ * \return	list with one result dict per pattern entry
+ *
+ * Entries sharing a state get the result of that state under their
+ * own id.
+ */
+static PyObject *
+_buildMultiResult(IppRegExpStateObject *o, IppRegExpMultiFind *multifind)
+{
+    PyObject *retval, *result, *entry;
+    int i;
+	IppRegExpMultiFind *p_iremf;
+
+    retval= PyList_New(o->numentries);
+    if (retval == NULL)
+        goto error;
+    for (i= 0; i < o->numentries; ++i) {
+        p_iremf= multifind + o->entrystate[i];
+        entry= PyDict_New();
+        if (entry == NULL)
+            goto free;
+        PyList_SET_ITEM(retval, i, entry);
+        if (_dictSetInt(entry, s_patternid, o->entryids[i]) < 0
+                || _dictSetInt(entry, s_done, p_iremf->regexpDoneFlag) < 0)
+            goto free;
+        if (p_iremf->status != ippStsNoErr) {
+            /* Error occoured! */
+            if (_dictSetInt(entry, s_ipperror, p_iremf->status) < 0)
+                goto free;
+            continue;
+        }
+        if (_dictSetInt(entry, s_ippstatus, p_iremf->status) < 0)
+            goto free;
+        if (p_iremf->numMultiFind > 0) {
+            /* No Error and something is found! */
+            result= PyDict_New();
+            if (result == NULL)
+                goto free;
+            if (_dictSetInt(result, s_numfind, p_iremf->numMultiFind) < 0
+                    || PyDict_SetItem(entry, s_result, result) < 0) {
+                Py_DECREF(result);
+                goto free;
+            }
+            Py_DECREF(result);
+        }
+        /* No Error but nothing found! */
+        else if (PyDict_SetItem(entry, s_result, Py_None) < 0)
+            goto free;
+    }
+    return retval;
+free:
+    Py_DECREF(retval);
+error:
+    return NULL;
+}
+
+/**
+ * \brief	search string with given multi regexp database
+ * \return	list with one result dict per pattern
+ *
+ * The preallocated multifind entries of the object are used while the
+ * lock is free and the source is short. Otherwise private entries are
+ * allocated and the scan runs without the GIL.
+ */
+static PyObject *
+searchMulti(PyObject *self, PyObject *source)
+{
+    PyObject *retval= NULL, *value;
+    const Ipp8u *src;
+    int src_len;
+    IppStatus istatus= -1;
+	IppRegExpMultiFind *mf;
+    IppRegExpStateObject *o;
+    
+    o= (IppRegExpStateObject*)self;
+    if (_ensureState(o, 1) < 0)
+        goto error;
+    if (!PyString_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type");
+        goto error;
+    }
+    src= (const Ipp8u*)PyString_AS_STRING(source);
+    src_len= (int)PyString_GET_SIZE(source);
+    if (src_len < NOGIL_THRESHOLD && PyThread_acquire_lock(o->lock, 0)) {
+        istatus= _multiFindUnlocked(o->irems, o->numpatterns, o->capacity, \
+                src, src_len, o->multifind);
+        if (istatus == ippStsNoErr)
+            retval= _buildMultiResult(o, o->multifind);
+        PyThread_release_lock(o->lock);
+    }
+    else {
+        mf= _newMultiFind(o->numpatterns, o->capacity);
+        if (mf == NULL) {
+            PyErr_NoMemory();
+            goto error;
+        }
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(o->lock, 1);
+        istatus= _multiFindUnlocked(o->irems, o->numpatterns, o->capacity, \
+                src, src_len, mf);
+        PyThread_release_lock(o->lock);
+        Py_END_ALLOW_THREADS
+        if (istatus == ippStsNoErr)
+            retval= _buildMultiResult(o, mf);
+        free(mf);
+    }
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("si", "IppRegExpMultiFind: Error Ipp Status", \
+                istatus);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        goto error;
+    }
+    return retval;
+error:
+    return NULL;
+}
+
+/**
+ * \brief	build the python result of a single find
+ * \return	result dict or None if nothing was found
+ */
+static PyObject *
+_buildSearchResult(int numfind)
+{
+    PyObject *retval;
+
+    if (numfind <= 0)
+        Py_RETURN_NONE;
+    retval= PyDict_New();
+    if (retval == NULL)
+        return NULL;
+    if (_dictSetInt(retval, s_numfind, numfind) < 0
+            || _dictSetInt(retval, s_ippstatus, ippStsNoErr) < 0) {
+        Py_DECREF(retval);
+        return NULL;
+    }
+    return retval;
+}
+
+/**
+ * \brief	search string with given regexp
+ * \return	result dict or None if nothing was found
+ */
+static PyObject *
+search(PyObject *self, PyObject *source)
+{
+    PyObject *value;
+    IppStatus istatus= -1;
+    int iNumFind;
+    IppRegExpFind sfind[STACKFIND], *iFind= sfind;
+    IppRegExpStateObject *o;
+    
+    o= (IppRegExpStateObject*)self;
+    if (_ensureState(o, 0) < 0)
+        goto error;
+    if (!PyString_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type");
+        goto error;
+    }
+    iNumFind= o->numgroups + 1;
+    if (iNumFind > STACKFIND) {
+        iFind= PyMem_Malloc(sizeof(IppRegExpFind) * iNumFind);
+        if (iFind == NULL) {
+            PyErr_NoMemory();
+            goto error;
+        }
+    }
+    istatus= _find(o, (const Ipp8u*)PyString_AS_STRING(source), \
+			(int)PyString_GET_SIZE(source), iFind, &iNumFind);
+    if (iFind != sfind)
+        PyMem_Free(iFind);
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("si", "IppRegExpFind: Error Ipp Status", istatus);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        goto error;
+    }
+    return _buildSearchResult(iNumFind);
+error:
+    return NULL;
+}
+
+/**
+ * \brief	anchored variant of the pattern of a single state object
+ * \return	state compiled on first use, NULL with exception set
+ *
+ * The variants are compiled with the GIL held and never replaced, so
+ * they can be scanned under the object lock like ires.
+ */
+static IppRegExpState *
+_anchoredState(IppRegExpStateObject *o, int kind)
+{
+    PyObject *pattern, *anchored, *value;
+    IppRegExpState *state= NULL;
+    IppStatus istatus;
+    int ieos= 0;
+
+    if (o->anchored[kind])
+        return o->anchored[kind];
+    pattern= PyDict_GetItemString(o->attr_dict, "ipppattern");
+    if (pattern == NULL || !PyString_Check(pattern)) {
+        PyErr_SetString(IppchError, "no pattern to anchor");
+        return NULL;
+    }
+    if (kind == ANCHOR_CONTEXT)
+        anchored= PyString_FromFormat("[\\s\\S](?:%s)", \
+                PyString_AS_STRING(pattern));
+    else
+        anchored= PyString_FromFormat("\\A(?:%s)%s", \
+                PyString_AS_STRING(pattern), kind == ANCHOR_FULL ? "\\z" : "");
+    if (anchored == NULL)
+        return NULL;
+    istatus= ippsRegExpInitAlloc(PyString_AS_STRING(anchored), o->opts, \
+            &state, &ieos);
+    Py_DECREF(anchored);
+    if (kind != ANCHOR_CONTEXT)
+        o->maxlength= _maxLength(PyString_AS_STRING(pattern), \
+                PyString_GET_SIZE(pattern));
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("sisi", "ippstatus", istatus, "eoffset", ieos);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        return NULL;
+    }
+    o->anchored[kind]= state;
+    return state;
+}
+
+/**
+ * \brief	result dict of match() and fullmatch()
+ * \return	{numfind, ippstatus, spans} with (start, end) per group,
+ *		(-1, -1) for groups that did not participate
+ */
+static PyObject *
+_buildMatchResult(const Ipp8u *src, const IppRegExpFind *find, int numfind)
+{
+    PyObject *retval, *spans, *span;
+    Py_ssize_t start;
+    int i;
+
+    retval= _buildSearchResult(numfind);
+    if (retval == NULL || retval == Py_None)
+        return retval;
+    spans= PyList_New(numfind);
+    if (spans == NULL)
+        goto error;
+    for (i= 0; i < numfind; ++i) {
+        start= find[i].pFind ? (const Ipp8u *)find[i].pFind - src : -1;
+        span= Py_BuildValue("nn", start, \
+                start < 0 ? -1 : start + find[i].lenFind);
+        if (span == NULL) {
+            Py_DECREF(spans);
+            goto error;
+        }
+        PyList_SET_ITEM(spans, i, span);
+    }
+    if (PyDict_SetItemString(retval, "spans", spans) < 0) {
+        Py_DECREF(spans);
+        goto error;
+    }
+    Py_DECREF(spans);
+    return retval;
+error:
+    Py_DECREF(retval);
+    return NULL;
+}
+
+/**
+ * \brief	common part of match and fullmatch
+ *
+ * The anchored variant lets the engine give up after the attempt at
+ * offset 0, the checks of the span only guard against multiline
+ * anchors matching elsewhere. A string longer than the bound of the
+ * pattern never fullmatches, and match() only hands ipp the bytes a
+ * match can span plus two, enough for \b, $ and \Z after the match to
+ * see the same bytes, so ipp never scans a long tail.
+ */
+static PyObject *
+_matchAnchored(PyObject *self, PyObject *source, int kind)
+{
+    PyObject *retval= NULL, *value;
+    IppStatus istatus;
+    IppRegExpState *state;
+    IppRegExpFind sfind[STACKFIND], *iFind= sfind;
+    IppRegExpStateObject *o= (IppRegExpStateObject *)self;
+    const Ipp8u *src;
+    int len, iNumFind;
+
+    if (_ensureState(o, 0) < 0)
+        return NULL;
+    if (!PyString_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type");
+        return NULL;
+    }
+    state= _anchoredState(o, kind);
+    if (state == NULL)
+        return NULL;
+    iNumFind= o->numgroups + 1;
+    if (iNumFind > STACKFIND) {
+        iFind= PyMem_Malloc(sizeof(IppRegExpFind) * iNumFind);
+        if (iFind == NULL)
+            return PyErr_NoMemory();
+    }
+    src= (const Ipp8u *)PyString_AS_STRING(source);
+    len= (int)PyString_GET_SIZE(source);
+    if (o->maxlength >= 0 && kind == ANCHOR_FULL && len > o->maxlength) {
+        retval= _buildMatchResult(src, iFind, 0);
+        goto free;
+    }
+    if (o->maxlength >= 0 && kind == ANCHOR_MATCH \
+            && len > o->maxlength + 2)
+        len= (int)o->maxlength + 2;
+    istatus= _findWith(o, state, src, len, iFind, &iNumFind);
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("si", "IppRegExpFind: Error Ipp Status", istatus);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        goto free;
+    }
+    if (iNumFind > 0 && (iFind[0].pFind != (void *)src || (kind == \
+                    ANCHOR_FULL && iFind[0].lenFind != len)))
+        iNumFind= 0;
+    retval= _buildMatchResult(src, iFind, iNumFind);
+free:
+    if (iFind != sfind)
+        PyMem_Free(iFind);
+    return retval;
+}
+
+/**
+ * \brief	match the pattern at the beginning of string
+ * \return	result dict or None
+ */
+static PyObject *
+match(PyObject *self, PyObject *source)
+{
+    return _matchAnchored(self, source, ANCHOR_MATCH);
+}
+
+/**
+ * \brief	match the pattern against the whole string
+ * \return	result dict or None
+ */
+static PyObject *
+fullmatch(PyObject *self, PyObject *source)
+{
+    return _matchAnchored(self, source, ANCHOR_FULL);
+}
+
+/**
+ * \brief	IppchSplitObject, lazy split of a buffer by a compiled pattern
+ *
+ * Every next() runs at most one scan, so splitting a large buffer into
+ * many fields only holds the current piece.
+ */
+typedef struct {
+    PyObject_HEAD
+    IppRegExpStateObject *o;        /**< compiled pattern */
+    PyObject *view;                 /**< memoryview of the source or NULL */
+    Py_buffer buf;                  /**< exported source, pinned */
+    Py_ssize_t pos;                 /**< start of the current piece */
+    Py_ssize_t at;                  /**< offset of the next scan */
+    Py_ssize_t nsplit;              /**< splits done */
+    Py_ssize_t maxsplit;            /**< 0 for no limit */
+    int offsets;                    /**< yield (start, end) pairs */
+    int done;                       /**< last piece was returned */
+    int numfind;                    /**< groups of the last match + 1 */
+    int nextgroup;                  /**< next group of it to yield */
+    IppRegExpFind *find;            /**< numgroups + 1 entries */
+    IppRegExpState *context;        /**< ANCHOR_CONTEXT state or NULL */
+} IppchSplitObject;
+
+static PyTypeObject IppchSplitObject_Type;
+
+/**
+ * \brief	IppchSplitObject dealloc function
+ */
+static void
+_dealloc_IppchSplitObject(PyObject *self)
+{
+    IppchSplitObject *it= (IppchSplitObject *)self;
+
+    Py_XDECREF(it->view);
+    if (it->buf.obj)
+        PyBuffer_Release(&it->buf);
+    PyMem_Free(it->find);
+    Py_XDECREF(it->o);
+    PyObject_Del(self);
+}
+
+/**
+ * \brief	piece [start, end) of the source
+ * \return	memoryview slice, (start, end) in offsets mode, None if start < 0
+ */
+static PyObject *
+_splitPiece(IppchSplitObject *it, Py_ssize_t start, Py_ssize_t end)
+{
+    if (start < 0)
+        Py_RETURN_NONE;
+    if (it->offsets)
+        return Py_BuildValue("nn", start, end);
+    return PySequence_GetSlice(it->view, start, end);
+}
+
+/**
+ * \brief	next piece or captured group
+ */
+static PyObject *
+_next_IppchSplitObject(PyObject *self)
+{
+    IppchSplitObject *it= (IppchSplitObject *)self;
+    const Ipp8u *src= it->buf.buf;
+    Py_ssize_t len= it->buf.len, ms, me, start;
+    IppStatus istatus;
+    PyObject *piece, *value;
+    int i, numfind, skip;
+
+    if (it->nextgroup < it->numfind) {
+        i= it->nextgroup++;
+        start= it->find[i].pFind ? (const Ipp8u *)it->find[i].pFind - src : -1;
+        return _splitPiece(it, start, start + it->find[i].lenFind);
+    }
+    if (it->done)
+        return NULL;
+    while (it->maxsplit == 0 || it->nsplit < it->maxsplit) {
+        if (it->at > len)
+            break;
+        numfind= it->o->numgroups + 1;
+        /* with the byte before the scan, whose match is left out */
+        skip= it->context && it->at > 0;
+        istatus= _findWith(it->o, skip ? it->context : it->o->ires, \
+                src + it->at - skip, (int)(len - it->at + skip), \
+                it->find, &numfind);
+        if (istatus != ippStsNoErr) {
+            value= Py_BuildValue("si", \
+                    "IppRegExpFind: Error Ipp Status", istatus);
+            PyErr_SetObject(IppchError, value);
+            Py_XDECREF(value);
+            return NULL;
+        }
+        if (numfind <= 0 || it->find[0].pFind == NULL)
+            break;
+        ms= (const Ipp8u *)it->find[0].pFind - src + skip;
+        me= ms + it->find[0].lenFind - skip;
+        if (me == ms) {
+            /* empty matches do not split */
+            it->at= ms + 1;
+            continue;
+        }
+        piece= _splitPiece(it, it->pos, ms);
+        it->pos= it->at= me;
+        it->nsplit++;
+        it->numfind= numfind;
+        it->nextgroup= 1;
+        return piece;
+    }
+    it->done= 1;
+    it->numfind= 0;
+    return _splitPiece(it, it->pos, len);
+}
+
+/**
+ * \brief	IppchSplitObject type definition
+ */
+static PyTypeObject IppchSplitObject_Type= {
+    PyObject_HEAD_INIT(NULL)
+    0,                              /**< ob_size */
+    "_ippch.IppchSplitObject",      /**< tp_name */
+    sizeof(IppchSplitObject),       /**< tp_basicsize */
+    0,                              /**< tp_itemsize */
+    (destructor)_dealloc_IppchSplitObject, /**< tp_dealloc */
+    0,                              /**< tp_print */
+    0,                              /**< tp_getattr */
+    0,                              /**< tp_setattr */
+    0,                              /**< tp_compare */
+    0,                              /**< tp_repr */
+    0,                              /**< tp_as_number */
+    0,                              /**< tp_as_sequence */
+    0,                              /**< tp_as_mapping */
+    0,                              /**< tp_hash */
+    0,                              /**< tp_call */
+    0,                              /**< tp_str */
+    0,                              /**< tp_getattro */
+    0,                              /**< tp_setattro */
+    0,                              /**< tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,             /**< tp_flags */
+    "iterator over the pieces of a split", /**< tp_doc */
+    0,                              /**< tp_traverse */
+    0,                              /**< tp_clear */
+    0,                              /**< tp_richcompare */
+    0,                              /**< tp_weaklistoffset */
+    PyObject_SelfIter,              /**< tp_iter */
+    (iternextfunc)_next_IppchSplitObject, /**< tp_iternext */
+};
+
+/**
+ * \brief	split iterator over source
+ * \return	IppchSplitObject
+ */
+static PyObject *
+isplit(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"source", "maxsplit", "offsets", NULL};
+    PyObject *source, *pattern;
+    Py_ssize_t maxsplit= 0;
+    int offsets= 0, kind;
+    IppchSplitObject *it;
+    IppRegExpStateObject *o= (IppRegExpStateObject *)self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ni", kwlist, \
+                &source, &maxsplit, &offsets))
+        return NULL;
+    if (_ensureState(o, 0) < 0)
+        return NULL;
+    if (maxsplit < 0)
+        maxsplit= 0;
+    pattern= PyDict_GetItemString(o->attr_dict, "ipppattern");
+    kind= pattern && PyString_Check(pattern) ? _contextKind( \
+            PyString_AS_STRING(pattern), PyString_GET_SIZE(pattern)) : 0;
+    if (kind == CONTEXT_LOOKBEHIND) {
+        PyErr_SetString(PyExc_ValueError, \
+                "split does not support lookbehind assertions");
+        return NULL;
+    }
+    it= PyObject_New(IppchSplitObject, &IppchSplitObject_Type);
+    if (it == NULL)
+        return NULL;
+    Py_INCREF(o);
+    it->o= o;
+    it->view= NULL;
+    it->buf.obj= NULL;
+    it->pos= it->at= it->nsplit= 0;
+    it->maxsplit= maxsplit;
+    it->offsets= offsets;
+    it->done= 0;
+    it->numfind= it->nextgroup= 0;
+    it->context= NULL;
+    it->find= PyMem_New(IppRegExpFind, o->numgroups + 1);
+    if (it->find == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    if (PyObject_GetBuffer(source, &it->buf, PyBUF_SIMPLE) < 0)
+        goto error;
+    if (it->buf.len > INT_MAX) {
+        PyErr_SetString(PyExc_ValueError, "source too large");
+        goto error;
+    }
+    if (kind == CONTEXT_BYTE) {
+        it->context= _anchoredState(o, ANCHOR_CONTEXT);
+        if (it->context == NULL)
+            goto error;
+    }
+    if (!offsets) {
+        it->view= PyMemoryView_FromObject(source);
+        if (it->view == NULL)
+            goto error;
+    }
+    return (PyObject *)it;
+error:
+    Py_DECREF(it);
+    return NULL;
+}
+
+/**
+ * \brief	split source into a list
+ * \return	list of memoryview slices or (start, end) pairs, captured
+ *		groups included, None for groups that did not participate
+ */
+static PyObject *
+split(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    PyObject *it, *retval;
+
+    it= isplit(self, args, kwds);
+    if (it == NULL)
+        return NULL;
+    retval= PySequence_List(it);
+    Py_DECREF(it);
+    return retval;
+}
+
+/**
+ * \brief	batch of sources, either packed or a list of strings
+ */
+typedef struct {
+    const Ipp8u *data;                  /**< packed data or NULL */
+    const Ipp32s *offsets;              /**< n+1 offsets into data */
+    const Ipp8u **srcs;                 /**< sources of a list batch */
+    int *lens;                          /**< lengths of a list batch */
+    Py_ssize_t n;                       /**< number of sources */
+} IppchBatch;
+
+/**
+ * \brief	get source i of a batch
+ */
+static void
+_batchItem(const IppchBatch *b, Py_ssize_t i, const Ipp8u **src, int *len)
+{
+    if (b->data) {
+        *src= b->data + b->offsets[i];
+        *len= b->offsets[i+1] - b->offsets[i];
+    }
+    else {
+        *src= b->srcs[i];
+        *len= b->lens[i];
+    }
+}
+
+/**
+ * \brief	columnar outputs of the *Into scan methods
+ */
+typedef struct {
+    Py_buffer views[4];                 /**< ids, starts, ends, inputs */
+    Ipp32s *ids;
+    Ipp32s *starts;
+    Ipp32s *ends;
+    Ipp32s *inputs;                     /**< NULL if not requested */
+    Py_ssize_t capacity;                /**< records fitting all outputs */
+} IppchColumns;
+
+/**
+ * \brief	get a writable int32 view on obj
+ * \return	number of int32 entries, -1 with exception set
+ *
+ * Accepts contiguous buffers with 4 byte integer items (numpy
+ * int32/uint32) or raw byte buffers like bytearray (format "B" or
+ * none), which are read as native int32 and must hold whole entries.
+ */
+static Py_ssize_t
+_getInt32Buffer(PyObject *obj, Py_buffer *view, int writable)
+{
+    int flags= PyBUF_C_CONTIGUOUS|PyBUF_FORMAT;
+    const char *fmt;
+    int ok;
+
+    if (writable)
+        flags|= PyBUF_WRITABLE;
+    if (PyObject_GetBuffer(obj, view, flags) < 0)
+        return -1;
+    fmt= view->format;
+    if (fmt && (*fmt == '@' || *fmt == '=' || *fmt == '<' || *fmt == '>' \
+                || *fmt == '!'))
+        fmt++;
+    if (view->itemsize == 4)
+        ok= fmt == NULL || (fmt[0] && fmt[1] == '\0' && strchr("iIlL", fmt[0]));
+    else if (view->itemsize == 1)
+        ok= fmt == NULL || strcmp(fmt, "B") == 0;
+    else
+        ok= 0;
+    if (!ok || view->len % 4 != 0) {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_ValueError, "int32 buffer expected");
+        return -1;
+    }
+    return view->len / 4;
+}
+
+/**
+ * \brief	free the arrays of a batch built by _batchFromList
+ */
+static void
+_freeBatch(IppchBatch *b)
+{
+    PyMem_Free(b->srcs);
+    PyMem_Free(b->lens);
+    b->srcs= NULL;
+    b->lens= NULL;
+}
+
+/**
+ * \brief	fill a batch from a sequence of strings
+ * \return	fast sequence the batch points into, NULL with exception set
+ *
+ * Keep the returned sequence alive while the batch is used and free the
+ * batch with _freeBatch.
+ */
+static PyObject *
+_batchFromList(IppchBatch *b, PyObject *sources)
+{
+    PyObject *seq, *item;
+    Py_ssize_t i;
+
+    memset(b, 0, sizeof(IppchBatch));
+    seq= PySequence_Fast(sources, "sources must be a sequence");
+    if (seq == NULL)
+        return NULL;
+    b->n= PySequence_Fast_GET_SIZE(seq);
+    b->srcs= PyMem_Malloc(sizeof(Ipp8u *) * (b->n + 1));
+    b->lens= PyMem_Malloc(sizeof(int) * (b->n + 1));
+    if (b->srcs == NULL || b->lens == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (i= 0; i < b->n; ++i) {
+        item= PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyString_Check(item)) {
+            PyErr_SetString(PyExc_TypeError, "wrong argument type");
+            goto error;
+        }
+        b->srcs[i]= (const Ipp8u *)PyString_AS_STRING(item);
+        b->lens[i]= (int)PyString_GET_SIZE(item);
+    }
+    return seq;
+error:
+    _freeBatch(b);
+    Py_DECREF(seq);
+    return NULL;
+}
+
+/**
+ * \brief	fill a batch from packed data and int32 offsets
+ * \return	0 or -1 with exception set
+ *
+ * Source i is data[offsets[i]:offsets[i+1]]. On success dview and oview
+ * must be released by the caller.
+ */
+static int
+_batchFromPacked(IppchBatch *b, PyObject *data, PyObject *offsets, \
+        Py_buffer *dview, Py_buffer *oview)
+{
+    Py_ssize_t i, n;
+
+    memset(b, 0, sizeof(IppchBatch));
+    if (PyObject_GetBuffer(data, dview, PyBUF_SIMPLE) < 0)
+        return -1;
+    n= _getInt32Buffer(offsets, oview, 0);
+    if (n < 0) {
+        PyBuffer_Release(dview);
+        return -1;
+    }
+    b->data= (const Ipp8u *)dview->buf;
+    b->offsets= (const Ipp32s *)oview->buf;
+    b->n= n > 0 ? n - 1 : 0;
+    for (i= 0; i < b->n; ++i) {
+        if (b->offsets[i] < 0 || b->offsets[i] > b->offsets[i+1] \
+                || b->offsets[i+1] > dview->len) {
+            PyErr_SetString(PyExc_ValueError, "offsets out of range");
+            PyBuffer_Release(oview);
+            PyBuffer_Release(dview);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * \brief	total number of bytes of a batch
+ */
+static Py_ssize_t
+_batchBytes(const IppchBatch *b)
+{
+    Py_ssize_t i, total= 0;
+
+    if (b->data)
+        return b->n > 0 ? b->offsets[b->n] - b->offsets[0] : 0;
+    for (i= 0; i < b->n; ++i)
+        total+= b->lens[i];
+    return total;
+}
+
+/**
+ * \brief	release the views of columnar outputs
+ */
+static void
+_releaseColumns(IppchColumns *c)
+{
+    int i;
+
+    for (i= 0; i < 4; ++i)
+        if (c->views[i].obj || c->views[i].buf)
+            PyBuffer_Release(&c->views[i]);
+}
+
+/**
+ * \brief	get the columnar outputs, inputs may be None
+ * \return	0 on success, -1 with exception set
+ */
+static int
+_getColumns(IppchColumns *c, PyObject *ids, PyObject *starts, \
+        PyObject *ends, PyObject *inputs)
+{
+    PyObject *objs[4];
+    Ipp32s **ptrs[4];
+    Py_ssize_t n;
+    int i;
+
+    objs[0]= ids; objs[1]= starts; objs[2]= ends; objs[3]= inputs;
+    ptrs[0]= &c->ids; ptrs[1]= &c->starts;
+    ptrs[2]= &c->ends; ptrs[3]= &c->inputs;
+    memset(c, 0, sizeof(IppchColumns));
+    c->capacity= PY_SSIZE_T_MAX;
+    for (i= 0; i < 4; ++i) {
+        if (objs[i] == NULL || objs[i] == Py_None)
+            continue;
+        n= _getInt32Buffer(objs[i], &c->views[i], 1);
+        if (n < 0) {
+            memset(&c->views[i], 0, sizeof(Py_buffer));
+            _releaseColumns(c);
+            return -1;
+        }
+        *ptrs[i]= (Ipp32s *)c->views[i].buf;
+        if (n < c->capacity)
+            c->capacity= n;
+    }
+    return 0;
+}
+
+/**
+ * \brief	scan a batch into columnar outputs, lock held, no GIL needed
+ * \return	number of records written
+ *
+ * Scanning starts at source *next. One record is written per match,
+ * the span of the whole match (pFind[0]), capture groups are not. A
+ * source whose matches do not fit into the remaining outputs is left
+ * for the next call, *next is set to the first source not written. A
+ * match of a shared state is written once for every id owning it.
+ */
+static Py_ssize_t
+_multiFindInto(IppRegExpStateObject *o, const IppchBatch *b, \
+        Py_ssize_t *next, IppRegExpMultiFind *mf, IppchColumns *c, \
+        IppStatus *istatus)
+{
+    Py_ssize_t i, nw= 0;
+    int p, k, q, len;
+    const Ipp8u *src;
+
+    *istatus= ippStsNoErr;
+    for (i= *next; i < b->n; ++i) {
+        _batchItem(b, i, &src, &len);
+        *istatus= _multiFindUnlocked(o->irems, o->numpatterns, \
+                o->capacity, src, len, mf);
+        if (*istatus != ippStsNoErr)
+            break;
+        for (k= 0, p= 0; p < o->numpatterns; ++p)
+            if (mf[p].status == ippStsNoErr && mf[p].numMultiFind > 0)
+                k+= o->ownerstart[p+1] - o->ownerstart[p];
+        if (nw + k > c->capacity)
+            break;
+        for (p= 0; p < o->numpatterns; ++p) {
+            if (mf[p].status != ippStsNoErr || mf[p].numMultiFind <= 0)
+                continue;
+            for (q= o->ownerstart[p]; q < o->ownerstart[p+1]; ++q) {
+                c->ids[nw]= o->ownerids[q];
+                c->starts[nw]= (Ipp32s)((const Ipp8u *)mf[p].pFind[0].pFind \
+                        - src);
+                c->ends[nw]= c->starts[nw] + mf[p].pFind[0].lenFind;
+                if (c->inputs)
+                    c->inputs[nw]= (Ipp32s)i;
+                nw++;
+            }
+        }
+    }
+    *next= i;
+    return nw;
+}
+
+/**
+ * \brief	common part of searchMultiBatchInto and searchMultiPackedInto
+ * \return	tuple (records written, next source index)
+ */
+static PyObject *
+_searchMultiInto(IppRegExpStateObject *o, IppchBatch *b, Py_ssize_t first, \
+        IppchColumns *c)
+{
+    PyObject *value;
+    Py_ssize_t nw, next= first;
+    IppStatus istatus;
+    IppRegExpMultiFind *mf;
+    Ipp64u t0;
+
+    if (c->ids == NULL || c->starts == NULL || c->ends == NULL) {
+        PyErr_SetString(PyExc_TypeError, "ids, starts and ends are required");
+        return NULL;
+    }
+    if (first < 0 || first > b->n) {
+        PyErr_SetString(PyExc_IndexError, "first out of range");
+        return NULL;
+    }
+    mf= _newMultiFind(o->numpatterns, o->capacity);
+    if (mf == NULL)
+        return PyErr_NoMemory();
+    Py_BEGIN_ALLOW_THREADS
+    t0= _profStart();
+    PyThread_acquire_lock(o->lock, 1);
+    nw= _multiFindInto(o, b, &next, mf, c, &istatus);
+    PyThread_release_lock(o->lock);
+    _profRecord(PROF_BATCH, t0, next - first);
+    Py_END_ALLOW_THREADS
+    free(mf);
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("si", "IppRegExpMultiFind: Error Ipp Status", \
+                istatus);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        return NULL;
+    }
+    if (nw == 0 && next < b->n) {
+        PyErr_SetString(PyExc_ValueError, \
+                "output buffers too small for the matches of one source");
+        return NULL;
+    }
+    return Py_BuildValue("nn", nw, next);
+}
+
+/**
+ * \brief	searchMulti over a list of strings into columnar int32 outputs
+ * \return	tuple (records written, next source index)
+ */
+static PyObject *
+searchMultiBatchInto(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"sources", "ids", "starts", "ends", "inputs", \
+        "first", NULL};
+    PyObject *sources, *seq, *ids, *starts, *ends;
+    PyObject *inputs= NULL, *retval= NULL;
+    Py_ssize_t first= 0;
+    IppchBatch b;
+    IppchColumns c;
+    IppRegExpStateObject *o= (IppRegExpStateObject *)self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOO|On", kwlist, \
+                &sources, &ids, &starts, &ends, &inputs, &first))
+        return NULL;
+    if (_ensureState(o, 1) < 0)
+        return NULL;
+    seq= _batchFromList(&b, sources);
+    if (seq == NULL)
+        return NULL;
+    if (_getColumns(&c, ids, starts, ends, inputs) == 0) {
+        retval= _searchMultiInto(o, &b, first, &c);
+        _releaseColumns(&c);
+    }
+    _freeBatch(&b);
+    Py_DECREF(seq);
+    return retval;
+}
+
+/**
+ * \brief	searchMulti over packed sources into columnar int32 outputs
+ * \return	tuple (records written, next source index)
+ *
+ * Source i is data[offsets[i]:offsets[i+1]], offsets is an int32 buffer.
+ */
+static PyObject *
+searchMultiPackedInto(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"data", "offsets", "ids", "starts", "ends", \
+        "inputs", "first", NULL};
+    PyObject *data, *offsets, *ids, *starts, *ends;
+    PyObject *inputs= NULL, *retval= NULL;
+    Py_ssize_t first= 0;
+    Py_buffer dview, oview;
+    IppchBatch b;
+    IppchColumns c;
+    IppRegExpStateObject *o= (IppRegExpStateObject *)self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOOO|On", kwlist, \
+                &data, &offsets, &ids, &starts, &ends, &inputs, &first))
+        return NULL;
+    if (_ensureState(o, 1) < 0)
+        return NULL;
+    if (_batchFromPacked(&b, data, offsets, &dview, &oview) < 0)
+        return NULL;
+    if (_getColumns(&c, ids, starts, ends, inputs) == 0) {
+        retval= _searchMultiInto(o, &b, first, &c);
+        _releaseColumns(&c);
+    }
+    PyBuffer_Release(&oview);
+    PyBuffer_Release(&dview);
+    return retval;
+}
+
+/**
+ * \brief	spans of every group over every source of a batch
+ *
+ * starts[g][i]/ends[g][i] receive the span of group g in source i,
+ * -1 if the group did not participate or the source did not match.
+ * Runs without the GIL, the caller holds the lock of o.
+ */
+static IppStatus
+_extractRun(IppRegExpStateObject *o, const IppchBatch *b, int numgroups, \
+        IppRegExpFind *find, Ipp32s **starts, Ipp32s **ends)
+{
+    Py_ssize_t i;
+    const Ipp8u *src;
+    int g, len, numfind;
+    IppStatus istatus;
+
+    for (i= 0; i < b->n; ++i) {
+        _batchItem(b, i, &src, &len);
+        numfind= numgroups;
+        istatus= _findUnlocked(o->ires, src, len, find, &numfind);
+        if (istatus != ippStsNoErr)
+            return istatus;
+        for (g= 0; g < numgroups; ++g) {
+            if (g < numfind && find[g].pFind) {
+                starts[g][i]= (Ipp32s)((const Ipp8u *)find[g].pFind - src);
+                ends[g][i]= starts[g][i] + find[g].lenFind;
+            }
+            else
+                starts[g][i]= ends[g][i]= -1;
+        }
+    }
+    return ippStsNoErr;
+}
+
+/**
+ * \brief	column keys of a state object, the group name or its number
+ * \return	new list with numgroups + 1 keys, NULL with exception set
+ */
+static PyObject *
+_groupKeys(IppRegExpStateObject *o)
+{
+    PyObject *keys, *groupindex, *name, *num;
+    Py_ssize_t pos= 0;
+    long g;
+
+    keys= PyList_New(o->numgroups + 1);
+    if (keys == NULL)
+        return NULL;
+    for (g= 0; g <= o->numgroups; ++g) {
+        num= PyInt_FromLong(g);
+        if (num == NULL) {
+            Py_DECREF(keys);
+            return NULL;
+        }
+        PyList_SET_ITEM(keys, g, num);
+    }
+    groupindex= PyDict_GetItemString(o->attr_dict, "groupindex");
+    while (groupindex && PyDict_Next(groupindex, &pos, &name, &num)) {
+        g= PyInt_AsLong(num);
+        if (g > 0 && g <= o->numgroups) {
+            Py_INCREF(name);
+            PyList_SetItem(keys, g, name);
+        }
+    }
+    return keys;
+}
+
+/**
+ * \brief	common part of extract and extractPacked
+ * \return	{key: list of str or None} or with spans
+ *		{key: (starts, ends)} of int32 bytearrays
+ */
+static PyObject *
+_extract(IppRegExpStateObject *o, IppchBatch *b, int spans)
+{
+    PyObject *retval= NULL, *keys= NULL, *col, *item, **cols= NULL, *value;
+    Ipp32s **starts= NULL, **ends= NULL;
+    IppRegExpFind *find= NULL;
+    IppStatus istatus;
+    Py_ssize_t i;
+    const Ipp8u *src;
+    int g, len, numgroups= o->numgroups + 1;
+
+    if (_ensureState(o, 0) < 0)
+        return NULL;
+    keys= _groupKeys(o);
+    if (keys == NULL)
+        return NULL;
+    starts= PyMem_New(Ipp32s *, numgroups);
+    ends= PyMem_New(Ipp32s *, numgroups);
+    cols= PyMem_New(PyObject *, 2 * numgroups);
+    find= PyMem_New(IppRegExpFind, numgroups);
+    if (!starts || !ends || !cols || !find) {
+        PyErr_NoMemory();
+        goto free;
+    }
+    memset(cols, 0, sizeof(PyObject *) * 2 * numgroups);
+    for (g= 0; g < 2 * numgroups; ++g) {
+        /* bytearrays are the columns with spans, scratch otherwise */
+        cols[g]= PyByteArray_FromStringAndSize(NULL, b->n * 4);
+        if (cols[g] == NULL)
+            goto free;
+    }
+    for (g= 0; g < numgroups; ++g) {
+        starts[g]= (Ipp32s *)PyByteArray_AS_STRING(cols[2*g]);
+        ends[g]= (Ipp32s *)PyByteArray_AS_STRING(cols[2*g+1]);
+    }
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(o->lock, 1);
+    istatus= _extractRun(o, b, numgroups, find, starts, ends);
+    PyThread_release_lock(o->lock);
+    Py_END_ALLOW_THREADS
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("si", "IppRegExpFind: Error Ipp Status", istatus);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        goto free;
+    }
+    retval= PyDict_New();
+    if (retval == NULL)
+        goto free;
+    for (g= 0; g < numgroups; ++g) {
+        if (spans)
+            col= PyTuple_Pack(2, cols[2*g], cols[2*g+1]);
+        else {
+            col= PyList_New(b->n);
+            for (i= 0; col && i < b->n; ++i) {
+                _batchItem(b, i, &src, &len);
+                if (starts[g][i] < 0) {
+                    Py_INCREF(Py_None);
+                    item= Py_None;
+                }
+                else
+                    item= PyString_FromStringAndSize((const char *)src \
+                            + starts[g][i], ends[g][i] - starts[g][i]);
+                if (item == NULL)
+                    Py_CLEAR(col);
+                else
+                    PyList_SET_ITEM(col, i, item);
+            }
+        }
+        if (col == NULL || PyDict_SetItem(retval, \
+                    PyList_GET_ITEM(keys, g), col) < 0) {
+            Py_XDECREF(col);
+            Py_CLEAR(retval);
+            goto free;
+        }
+        Py_DECREF(col);
+    }
+free:
+    if (cols)
+        for (g= 0; g < 2 * numgroups; ++g)
+            Py_XDECREF(cols[g]);
+    PyMem_Free(cols);
+    PyMem_Free(starts);
+    PyMem_Free(ends);
+    PyMem_Free(find);
+    Py_XDECREF(keys);
+    return retval;
+}
+
+/**
+ * \brief	run the pattern over a list of strings into group columns
+ */
+static PyObject *
+extract(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"sources", "spans", NULL};
+    PyObject *sources, *seq, *retval;
+    int spans= 0;
+    IppchBatch b;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist, \
+                &sources, &spans))
+        return NULL;
+    seq= _batchFromList(&b, sources);
+    if (seq == NULL)
+        return NULL;
+    retval= _extract((IppRegExpStateObject *)self, &b, spans);
+    _freeBatch(&b);
+    Py_DECREF(seq);
+    return retval;
+}
+
+/**
+ * \brief	run the pattern over packed sources into group columns
+ */
+static PyObject *
+extractPacked(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"data", "offsets", "spans", NULL};
+    PyObject *data, *offsets, *retval;
+    Py_buffer dview, oview;
+    int spans= 0;
+    IppchBatch b;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|i", kwlist, \
+                &data, &offsets, &spans))
+        return NULL;
+    if (_batchFromPacked(&b, data, offsets, &dview, &oview) < 0)
+        return NULL;
+    retval= _extract((IppRegExpStateObject *)self, &b, spans);
+    PyBuffer_Release(&oview);
+    PyBuffer_Release(&dview);
+    return retval;
+}
+
+/**
+ * \brief	hash functions of _hashBatch and _hashPacked
+ */
+enum {
+    HASH_CRC32= 0,                  /**< ippsCRC32_8u, zlib compatible */
+    HASH_CRC32C,                    /**< ippsCRC32C_8u, SSE4.2 crc32 */
+    HASH_IPP                        /**< ippsHash_8u32u string hash */
+};
+
+/**
+ * \brief	hash every source of a batch into out
+ */
+static IppStatus
+_hashRun(const IppchBatch *b, int kind, Ipp32u seed, Ipp32u *out)
+{
+    Py_ssize_t i;
+    const Ipp8u *src;
+    int len;
+    IppStatus istatus= ippStsNoErr;
+
+    for (i= 0; i < b->n && istatus == ippStsNoErr; ++i) {
+        _batchItem(b, i, &src, &len);
+        out[i]= seed;
+        switch (kind) {
+            case HASH_CRC32:
+                istatus= ippsCRC32_8u(src, len, &out[i]);
+                break;
+            case HASH_CRC32C:
+                istatus= ippsCRC32C_8u(src, (Ipp32u)len, &out[i]);
+                break;
+            default:
+                istatus= ippsHash_8u32u(src, len, &out[i]);
+                break;
+        }
+    }
+    return istatus;
+}
+
+/**
+ * \brief	int32 result buffer of a batch function
+ * \return	out or a new bytearray of n entries if out is None, NULL with
+ *		exception set; view is filled on success
+ */
+static PyObject *
+_getResultBuffer(PyObject *out, Py_ssize_t n, Py_buffer *view)
+{
+    PyObject *retval;
+    Py_ssize_t len;
+
+    if (out == NULL || out == Py_None) {
+        retval= PyByteArray_FromStringAndSize(NULL, n * 4);
+        if (retval == NULL)
+            return NULL;
+        if (PyObject_GetBuffer(retval, view, PyBUF_WRITABLE) < 0) {
+            Py_DECREF(retval);
+            return NULL;
+        }
+        return retval;
+    }
+    len= _getInt32Buffer(out, view, 1);
+    if (len < 0)
+        return NULL;
+    if (len < n) {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_ValueError, "out too small");
+        return NULL;
+    }
+    Py_INCREF(out);
+    return out;
+}
+
+/**
+ * \brief	common part of _hashBatch and _hashPacked
+ * \return	out, or a new bytearray of native uint32 hashes if out is None
+ *
+ * The result can be wrapped with numpy.frombuffer(r, numpy.uint32).
+ */
+static PyObject *
+_hashInto(IppchBatch *b, const char *kind, unsigned long seed, PyObject *out)
+{
+    PyObject *retval, *value;
+    Py_buffer view;
+    Ipp32u *hashes;
+    IppStatus istatus;
+    int k;
+
+    if (strcmp(kind, "crc32") == 0)
+        k= HASH_CRC32;
+    else if (strcmp(kind, "crc32c") == 0)
+        k= HASH_CRC32C;
+    else if (strcmp(kind, "hash") == 0)
+        k= HASH_IPP;
+    else {
+        PyErr_SetString(PyExc_ValueError, \
+                "kind must be 'crc32', 'crc32c' or 'hash'");
+        return NULL;
+    }
+    retval= _getResultBuffer(out, b->n, &view);
+    if (retval == NULL)
+        return NULL;
+    hashes= (Ipp32u *)view.buf;
+    if (_batchBytes(b) < NOGIL_THRESHOLD)
+        istatus= _hashRun(b, k, (Ipp32u)seed, hashes);
+    else {
+        Py_BEGIN_ALLOW_THREADS
+        istatus= _hashRun(b, k, (Ipp32u)seed, hashes);
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&view);
+    if (istatus != ippStsNoErr) {
+        Py_DECREF(retval);
+        value= Py_BuildValue("si", "ippsHash: Error Ipp Status", istatus);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        return NULL;
+    }
+    return retval;
+}
+
+/**
+ * \brief	hash a sequence of strings in one call
+ * \return	uint32 hashes, see _hashInto
+ */
+static PyObject *
+_hashBatch(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"sources", "kind", "seed", "out", NULL};
+    PyObject *sources, *seq, *out= NULL, *retval;
+    const char *kind= "crc32c";
+    unsigned long seed= 0;
+    IppchBatch b;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|skO", kwlist, \
+                &sources, &kind, &seed, &out))
+        return NULL;
+    seq= _batchFromList(&b, sources);
+    if (seq == NULL)
+        return NULL;
+    retval= _hashInto(&b, kind, seed, out);
+    _freeBatch(&b);
+    Py_DECREF(seq);
+    return retval;
+}
+
+/**
+ * \brief	hash packed sources data[offsets[i]:offsets[i+1]] in one call
+ * \return	uint32 hashes, see _hashInto
+ */
+static PyObject *
+_hashPacked(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"data", "offsets", "kind", "seed", "out", NULL};
+    PyObject *data, *offsets, *out= NULL, *retval;
+    const char *kind= "crc32c";
+    unsigned long seed= 0;
+    Py_buffer dview, oview;
+    IppchBatch b;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|skO", kwlist, \
+                &data, &offsets, &kind, &seed, &out))
+        return NULL;
+    if (_batchFromPacked(&b, data, offsets, &dview, &oview) < 0)
+        return NULL;
+    retval= _hashInto(&b, kind, seed, out);
+    PyBuffer_Release(&oview);
+    PyBuffer_Release(&dview);
+    return retval;
+}
+
+/**
+ * \brief	ascii case folding without the locale of the C library
+ */
+#define LATIN_LOWER(c)  ((c) >= 'A' && (c) <= 'Z' ? (c) + 32 : (c))
+#define LATIN_UPPER(c)  ((c) >= 'a' && (c) <= 'z' ? (c) - 32 : (c))
+
+/**
+ * \brief	find sub in src ignoring latin case, without folded copies
+ *
+ * ippsFindCAny_8u locates candidates for both cases of the first char,
+ * ippsCompareIgnoreCaseLatin_8u verifies them in place.
+ */
+static IppStatus
+_findIgnoreCase(const Ipp8u *src, int len, const Ipp8u *sub, int sublen, \
+        int *index)
+{
+    Ipp8u first[2];
+    int i= 0, at, cmp;
+    IppStatus istatus;
+
+    first[0]= LATIN_LOWER(sub[0]);
+    first[1]= LATIN_UPPER(sub[0]);
+    while (len - i >= sublen) {
+        istatus= ippsFindCAny_8u(src + i, len - i - sublen + 1, first, 2, &at);
+        if (istatus != ippStsNoErr || at < 0)
+            return istatus;
+        i+= at;
+        istatus= ippsCompareIgnoreCaseLatin_8u(src + i, sub, sublen, &cmp);
+        if (istatus != ippStsNoErr)
+            return istatus;
+        if (cmp == 0) {
+            *index= i;
+            return ippStsNoErr;
+        }
+        i++;
+    }
+    return ippStsNoErr;
+}
+
+/**
+ * \brief	index of sub in src or -1
+ */
+static IppStatus
+_strFindOne(const Ipp8u *src, int len, const Ipp8u *sub, int sublen, \
+        int icase, int *index)
+{
+    *index= -1;
+    if (sublen == 0) {
+        *index= 0;
+        return ippStsNoErr;
+    }
+    if (sublen > len)
+        return ippStsNoErr;
+    if (icase)
+        return _findIgnoreCase(src, len, sub, sublen, index);
+    return ippsFind_8u(src, len, sub, sublen, index);
+}
+
+/**
+ * \brief	compare a and b like memcmp, shorter sorts first
+ */
+static IppStatus
+_strCompareOne(const Ipp8u *a, int alen, const Ipp8u *b, int blen, \
+        int icase, int *result)
+{
+    int n= alen < blen ? alen : blen;
+    IppStatus istatus= ippStsNoErr;
+
+    *result= 0;
+    if (n > 0)
+        istatus= icase ? ippsCompareIgnoreCaseLatin_8u(a, b, n, result) \
+                : ippsCompare_8u(a, b, n, result);
+    if (*result == 0)
+        *result= alen - blen;
+    *result= *result < 0 ? -1 : *result > 0;
+    return istatus;
+}
+
+/**
+ * \brief	raise IppchError for an ipp error status
+ */
+static PyObject *
+_strError(const char *fn, IppStatus istatus)
+{
+    PyObject *value;
+
+    value= Py_BuildValue("si", fn, istatus);
+    PyErr_SetObject(IppchError, value);
+    Py_XDECREF(value);
+    return NULL;
+}
+
+/**
+ * \brief	index of sub in src[start:] ignoring case with icase
+ * \return	index into src or -1
+ */
+static PyObject *
+_strFind(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"src", "sub", "start", "icase", NULL};
+    Py_buffer src, sub;
+    Py_ssize_t start= 0;
+    int icase= 0, index= -1;
+    IppStatus istatus= ippStsNoErr;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s*s*|ni", kwlist, \
+                &src, &sub, &start, &icase))
+        return NULL;
+    if (start < 0)
+        start= 0;
+    if (start <= src.len) {
+        if (src.len - start < NOGIL_THRESHOLD)
+            istatus= _strFindOne((Ipp8u *)src.buf + start, \
+                    (int)(src.len - start), sub.buf, (int)sub.len, \
+                    icase, &index);
+        else {
+            Py_BEGIN_ALLOW_THREADS
+            istatus= _strFindOne((Ipp8u *)src.buf + start, \
+                    (int)(src.len - start), sub.buf, (int)sub.len, \
+                    icase, &index);
+            Py_END_ALLOW_THREADS
+        }
+    }
+    PyBuffer_Release(&sub);
+    PyBuffer_Release(&src);
+    if (istatus != ippStsNoErr)
+        return _strError("ippsFind: Error Ipp Status", istatus);
+    return PyInt_FromSsize_t(index < 0 ? -1 : start + index);
+}
+
+/**
+ * \brief	index of the first byte of src[start:] that is one of chars
+ * \return	index into src or -1
+ */
+static PyObject *
+_strFindAny(PyObject *self, PyObject *args)
+{
+    Py_buffer src, chars;
+    Py_ssize_t start= 0;
+    int index= -1;
+    IppStatus istatus= ippStsNoErr;
+
+    if (!PyArg_ParseTuple(args, "s*s*|n", &src, &chars, &start))
+        return NULL;
+    if (start < 0)
+        start= 0;
+    if (start < src.len && chars.len > 0) {
+        if (src.len - start < NOGIL_THRESHOLD)
+            istatus= ippsFindCAny_8u((Ipp8u *)src.buf + start, \
+                    (int)(src.len - start), chars.buf, (int)chars.len, \
+                    &index);
+        else {
+            Py_BEGIN_ALLOW_THREADS
+            istatus= ippsFindCAny_8u((Ipp8u *)src.buf + start, \
+                    (int)(src.len - start), chars.buf, (int)chars.len, \
+                    &index);
+            Py_END_ALLOW_THREADS
+        }
+    }
+    PyBuffer_Release(&chars);
+    PyBuffer_Release(&src);
+    if (istatus != ippStsNoErr)
+        return _strError("ippsFindCAny_8u: Error Ipp Status", istatus);
+    return PyInt_FromSsize_t(index < 0 ? -1 : start + index);
+}
+
+/**
+ * \brief	index of the last occurence of sub in src
+ * \return	index or -1
+ */
+static PyObject *
+_strRFind(PyObject *self, PyObject *args)
+{
+    Py_buffer src, sub;
+    int index= -1;
+    IppStatus istatus= ippStsNoErr;
+
+    if (!PyArg_ParseTuple(args, "s*s*", &src, &sub))
+        return NULL;
+    if (sub.len == 0)
+        index= (int)src.len;
+    else if (sub.len <= src.len) {
+        if (src.len < NOGIL_THRESHOLD)
+            istatus= ippsFindRev_8u(src.buf, (int)src.len, sub.buf, \
+                    (int)sub.len, &index);
+        else {
+            Py_BEGIN_ALLOW_THREADS
+            istatus= ippsFindRev_8u(src.buf, (int)src.len, sub.buf, \
+                    (int)sub.len, &index);
+            Py_END_ALLOW_THREADS
+        }
+    }
+    PyBuffer_Release(&sub);
+    PyBuffer_Release(&src);
+    if (istatus != ippStsNoErr)
+        return _strError("ippsFindRev_8u: Error Ipp Status", istatus);
+    return PyInt_FromLong(index);
+}
+
+/**
+ * \brief	compare two buffers, latin case insensitive with icase
+ * \return	-1, 0 or 1
+ */
+static PyObject *
+_strCompare(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"a", "b", "icase", NULL};
+    Py_buffer a, b;
+    int icase= 0, result;
+    IppStatus istatus;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "s*s*|i", kwlist, \
+                &a, &b, &icase))
+        return NULL;
+    istatus= _strCompareOne(a.buf, (int)a.len, b.buf, (int)b.len, icase, \
+            &result);
+    PyBuffer_Release(&b);
+    PyBuffer_Release(&a);
+    if (istatus != ippStsNoErr)
+        return _strError("ippsCompare: Error Ipp Status", istatus);
+    return PyInt_FromLong(result);
+}
+
+/**
+ * \brief	string transforms of _strTransform
+ */
+enum { STR_UPPER= 0, STR_LOWER, STR_REPLACEC };
+
+/**
+ * \brief	common part of _strUpper, _strLower and _strReplaceC
+ * \return	new string if dst is None, else None after writing dst
+ *
+ * dst may be src itself to transform a writable buffer in place.
+ */
+static PyObject *
+_strTransform(PyObject *srcobj, PyObject *dst, int op, Ipp8u oldc, \
+        Ipp8u newc)
+{
+    PyObject *retval= NULL;
+    Py_buffer src, d;
+    Ipp8u *out;
+    IppStatus istatus= ippStsNoErr;
+    int havedst= 0;
+
+    if (PyObject_GetBuffer(srcobj, &src, PyBUF_SIMPLE) < 0)
+        return NULL;
+    if (dst == NULL || dst == Py_None) {
+        retval= PyString_FromStringAndSize(NULL, src.len);
+        if (retval == NULL)
+            goto release;
+        out= (Ipp8u *)PyString_AS_STRING(retval);
+    }
+    else {
+        if (PyObject_GetBuffer(dst, &d, PyBUF_WRITABLE) < 0)
+            goto release;
+        if (d.len < src.len) {
+            PyBuffer_Release(&d);
+            PyErr_SetString(PyExc_ValueError, "dst too small");
+            goto release;
+        }
+        out= d.buf;
+        havedst= 1;
+        retval= Py_None;
+        Py_INCREF(retval);
+    }
+    if (src.len == 0)
+        goto done;
+    Py_BEGIN_ALLOW_THREADS
+    switch (op * 2 + (out == src.buf)) {
+        case STR_UPPER * 2:
+            istatus= ippsUppercaseLatin_8u(src.buf, out, (int)src.len);
+            break;
+        case STR_UPPER * 2 + 1:
+            istatus= ippsUppercaseLatin_8u_I(out, (int)src.len);
+            break;
+        case STR_LOWER * 2:
+            istatus= ippsLowercaseLatin_8u(src.buf, out, (int)src.len);
+            break;
+        case STR_LOWER * 2 + 1:
+            istatus= ippsLowercaseLatin_8u_I(out, (int)src.len);
+            break;
+        default:
+            istatus= ippsReplaceC_8u(src.buf, out, (int)src.len, oldc, newc);
+            break;
+    }
+    Py_END_ALLOW_THREADS
+done:
+    if (havedst)
+        PyBuffer_Release(&d);
+    if (istatus != ippStsNoErr) {
+        Py_CLEAR(retval);
+        _strError("ippsString: Error Ipp Status", istatus);
+    }
+release:
+    PyBuffer_Release(&src);
+    return retval;
+}
+
+/**
+ * \brief	latin uppercase of src into a new string or dst
+ */
+static PyObject *
+_strUpper(PyObject *self, PyObject *args)
+{
+    PyObject *src, *dst= NULL;
+
+    if (!PyArg_ParseTuple(args, "O|O", &src, &dst))
+        return NULL;
+    return _strTransform(src, dst, STR_UPPER, 0, 0);
+}
+
+/**
+ * \brief	latin lowercase of src into a new string or dst
+ */
+static PyObject *
+_strLower(PyObject *self, PyObject *args)
+{
+    PyObject *src, *dst= NULL;
+
+    if (!PyArg_ParseTuple(args, "O|O", &src, &dst))
+        return NULL;
+    return _strTransform(src, dst, STR_LOWER, 0, 0);
+}
+
+/**
+ * \brief	replace every byte old of src by new into a new string or dst
+ */
+static PyObject *
+_strReplaceC(PyObject *self, PyObject *args)
+{
+    PyObject *src, *dst= NULL;
+    char oldc, newc;
+
+    if (!PyArg_ParseTuple(args, "Occ|O", &src, &oldc, &newc, &dst))
+        return NULL;
+    return _strTransform(src, dst, STR_REPLACEC, (Ipp8u)oldc, (Ipp8u)newc);
+}
+
+/**
+ * \brief	strip any of chars from both ends of src
+ * \return	new string
+ */
+static PyObject *
+_strTrim(PyObject *self, PyObject *args)
+{
+    PyObject *retval;
+    Py_buffer src;
+    const char *chars= " \t\n\r\f\v";
+    int charslen= 6, len= 0;
+    IppStatus istatus= ippStsNoErr;
+
+    if (!PyArg_ParseTuple(args, "s*|s#", &src, &chars, &charslen))
+        return NULL;
+    retval= PyString_FromStringAndSize(NULL, src.len);
+    if (retval == NULL)
+        goto release;
+    if (src.len > 0 && charslen > 0)
+        istatus= ippsTrimCAny_8u(src.buf, (int)src.len, (const Ipp8u *)chars, \
+                charslen, (Ipp8u *)PyString_AS_STRING(retval), &len);
+    else {
+        memcpy(PyString_AS_STRING(retval), src.buf, src.len);
+        len= (int)src.len;
+    }
+    if (istatus != ippStsNoErr) {
+        Py_CLEAR(retval);
+        _strError("ippsTrimCAny_8u: Error Ipp Status", istatus);
+    }
+    else
+        _PyString_Resize(&retval, len);
+release:
+    PyBuffer_Release(&src);
+    return retval;
+}
+
+/**
+ * \brief	find or compare every source of a batch against sub
+ */
+static IppStatus
+_strBatchRun(const IppchBatch *b, int compare, const Ipp8u *sub, \
+        int sublen, int icase, Ipp32s *out)
+{
+    Py_ssize_t i;
+    const Ipp8u *src;
+    int len;
+    IppStatus istatus= ippStsNoErr;
+
+    for (i= 0; i < b->n && istatus == ippStsNoErr; ++i) {
+        _batchItem(b, i, &src, &len);
+        if (compare)
+            istatus= _strCompareOne(src, len, sub, sublen, icase, &out[i]);
+        else
+            istatus= _strFindOne(src, len, sub, sublen, icase, &out[i]);
+    }
+    return istatus;
+}
+
+/**
+ * \brief	common part of the find/compare batch functions
+ * \return	int32 results, see _getResultBuffer
+ */
+static PyObject *
+_strBatch(IppchBatch *b, int compare, PyObject *subobj, int icase, \
+        PyObject *out)
+{
+    PyObject *retval;
+    Py_buffer sub, view;
+    IppStatus istatus;
+
+    if (PyObject_GetBuffer(subobj, &sub, PyBUF_SIMPLE) < 0)
+        return NULL;
+    retval= _getResultBuffer(out, b->n, &view);
+    if (retval == NULL) {
+        PyBuffer_Release(&sub);
+        return NULL;
+    }
+    if (_batchBytes(b) < NOGIL_THRESHOLD)
+        istatus= _strBatchRun(b, compare, sub.buf, (int)sub.len, icase, \
+                view.buf);
+    else {
+        Py_BEGIN_ALLOW_THREADS
+        istatus= _strBatchRun(b, compare, sub.buf, (int)sub.len, icase, \
+                view.buf);
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&view);
+    PyBuffer_Release(&sub);
+    if (istatus != ippStsNoErr) {
+        Py_DECREF(retval);
+        return _strError("ippsString: Error Ipp Status", istatus);
+    }
+    return retval;
+}
+
+/**
+ * \brief	common part of the list batch functions
+ */
+static PyObject *
+_strBatchList(PyObject *args, PyObject *kwds, int compare)
+{
+    static char *kwlist[]= {"sources", "sub", "icase", "out", NULL};
+    PyObject *sources, *sub, *seq, *out= NULL, *retval;
+    int icase= 0;
+    IppchBatch b;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OO|iO", kwlist, \
+                &sources, &sub, &icase, &out))
+        return NULL;
+    seq= _batchFromList(&b, sources);
+    if (seq == NULL)
+        return NULL;
+    retval= _strBatch(&b, compare, sub, icase, out);
+    _freeBatch(&b);
+    Py_DECREF(seq);
+    return retval;
+}
+
+/**
+ * \brief	common part of the packed batch functions
+ */
+static PyObject *
+_strBatchPacked(PyObject *args, PyObject *kwds, int compare)
+{
+    static char *kwlist[]= {"data", "offsets", "sub", "icase", "out", NULL};
+    PyObject *data, *offsets, *sub, *out= NULL, *retval;
+    int icase= 0;
+    Py_buffer dview, oview;
+    IppchBatch b;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOO|iO", kwlist, \
+                &data, &offsets, &sub, &icase, &out))
+        return NULL;
+    if (_batchFromPacked(&b, data, offsets, &dview, &oview) < 0)
+        return NULL;
+    retval= _strBatch(&b, compare, sub, icase, out);
+    PyBuffer_Release(&oview);
+    PyBuffer_Release(&dview);
+    return retval;
+}
+
+/**
+ * \brief	index of sub in every string of sources
+ */
+static PyObject *
+_strFindBatch(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    return _strBatchList(args, kwds, 0);
+}
+
+/**
+ * \brief	index of sub in every packed source
+ */
+static PyObject *
+_strFindPacked(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    return _strBatchPacked(args, kwds, 0);
+}
+
+/**
+ * \brief	comparison of every string of sources with sub
+ */
+static PyObject *
+_strCompareBatch(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    return _strBatchList(args, kwds, 1);
+}
+
+/**
+ * \brief	comparison of every packed source with sub
+ */
+static PyObject *
+_strComparePacked(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    return _strBatchPacked(args, kwds, 1);
+}
+
+/**
+ * \brief	normalization steps of a pipeline, applied in this order
+ */
+enum {
+    NORM_URLDECODE= 1<<0,           /**< %xx escapes and + */
+    NORM_STRIP= 1<<1,               /**< drop control bytes but whitespace */
+    NORM_COLLAPSE= 1<<2,            /**< whitespace runs to one space */
+    NORM_LOWER= 1<<3                /**< latin lowercase */
+};
+
+static const char *norm_names[]= {"urldecode", "strip", "collapse", "lower"};
+
+/**
+ * \brief	run of scratch bytes with a constant offset to the original
+ *
+ * Scratch byte j was made of the original bytes [o, o + w), the bytes
+ * after it up to the next run were copied one to one from o + w on.
+ */
+typedef struct {
+    Ipp32s j;                       /**< first scratch byte of the run */
+    Ipp32s o;                       /**< original start of byte j */
+    Ipp32s w;                       /**< original bytes of byte j */
+} IppchRun;
+
+/**
+ * \brief	IppchPipelineObject, normalization fused with a scan
+ *
+ * All steps run in a single pass into a scratch buffer which is kept
+ * between calls. Only where a step shifts the offsets a run is
+ * recorded, match offsets are mapped back by a binary search.
+ */
+typedef struct {
+    PyObject_HEAD
+    IppRegExpStateObject *o;        /**< compiled state, strong reference */
+    int steps;                      /**< NORM_* mask */
+    Ipp8u *scratch;                 /**< normalized input, malloc */
+    int capacity;                   /**< size of the scratch buffer */
+    IppchRun *runs;                 /**< offset runs, malloc */
+    int numruns;                    /**< runs of the last input */
+    int maxruns;                    /**< size of runs */
+    PyThread_type_lock lock;        /**< guards the scratch buffers */
+} IppchPipelineObject;
+
+static PyTypeObject IppchPipelineObject_Type;
+
+/**
+ * \brief	IppchPipelineObject dealloc function
+ */
+static void
+_dealloc_IppchPipelineObject(PyObject *self)
+{
+    IppchPipelineObject *p= (IppchPipelineObject *)self;
+
+    free(p->scratch);
+    free(p->runs);
+    if (p->lock)
+        PyThread_free_lock(p->lock);
+    Py_XDECREF(p->o);
+    PyObject_Del(self);
+}
+
+/**
+ * \brief	value of a hex digit or -1
+ */
+static int
+_hexValue(Ipp8u c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c= LATIN_LOWER(c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+/**
+ * \brief	start a run at scratch byte j
+ * \return	0 on success, -1 if no memory is available
+ */
+static int
+_addRun(IppchPipelineObject *p, int j, int o, int w)
+{
+    IppchRun *runs;
+    int n;
+
+    if (p->numruns == p->maxruns) {
+        n= p->maxruns ? 2 * p->maxruns : 64;
+        runs= realloc(p->runs, sizeof(IppchRun) * n);
+        if (runs == NULL)
+            return -1;
+        p->runs= runs;
+        p->maxruns= n;
+    }
+    runs= p->runs + p->numruns++;
+    runs->j= j;
+    runs->o= o;
+    runs->w= w;
+    return 0;
+}
+
+/**
+ * \brief	original [start, end) of scratch byte j
+ */
+static void
+_origin(const IppchPipelineObject *p, int j, Ipp32s *start, Ipp32s *end)
+{
+    const IppchRun *r;
+    int lo= 0, hi= p->numruns - 1, mid;
+
+    /* last run with r->j <= j, runs[0].j is 0 */
+    while (lo < hi) {
+        mid= (lo + hi + 1) >> 1;
+        if (p->runs[mid].j <= j)
+            lo= mid;
+        else
+            hi= mid - 1;
+    }
+    r= p->runs + lo;
+    if (j == r->j) {
+        *start= r->o;
+        *end= r->o + r->w;
+    }
+    else {
+        *start= r->o + r->w + (j - r->j - 1);
+        *end= *start + 1;
+    }
+}
+
+/**
+ * \brief	normalize src into the scratch buffer, lock held, no GIL needed
+ * \return	normalized length or -1 if no memory is available
+ *
+ * No step makes the input longer, so the scratch buffer only grows to
+ * the largest input seen. A new run is recorded only for bytes not
+ * copied one to one right after the previous byte.
+ */
+static int
+_normalize(IppchPipelineObject *p, const Ipp8u *src, int len)
+{
+    int i= 0, j= 0, n, start, hi, lo, space= 0, pend= -1;
+    Ipp32s ps, pe;
+    Ipp8u c, *scratch;
+
+    if (len > p->capacity || p->scratch == NULL) {
+        /* never hand ipp a NULL source, even for empty inputs */
+        n= len > 0 ? len : 1;
+        scratch= realloc(p->scratch, n);
+        if (scratch == NULL)
+            return -1;
+        p->scratch= scratch;
+        p->capacity= n;
+    }
+    p->numruns= 0;
+    while (i < len) {
+        start= i;
+        c= src[i++];
+        if (p->steps & NORM_URLDECODE) {
+            if (c == '%' && i + 1 < len && (hi= _hexValue(src[i])) >= 0 \
+                    && (lo= _hexValue(src[i+1])) >= 0) {
+                c= (Ipp8u)(hi << 4 | lo);
+                i+= 2;
+            }
+            else if (c == '+')
+                c= ' ';
+        }
+        if ((p->steps & NORM_STRIP) && (c == 0x7f \
+                    || (c < 0x20 && (c < '\t' || c > '\r'))))
+            continue;
+        if (p->steps & NORM_COLLAPSE) {
+            if (c == ' ' || (c >= '\t' && c <= '\r')) {
+                if (space) {
+                    /* the space j-1 now ends at i, it heads its run */
+                    if (p->runs[p->numruns-1].j != j - 1) {
+                        _origin(p, j - 1, &ps, &pe);
+                        if (_addRun(p, j - 1, ps, 1) < 0)
+                            return -1;
+                    }
+                    p->runs[p->numruns-1].w= i - p->runs[p->numruns-1].o;
+                    pend= i;
+                    continue;
+                }
+                c= ' ';
+                space= 1;
+            }
+            else
+                space= 0;
+        }
+        if (p->steps & NORM_LOWER)
+            c= LATIN_LOWER(c);
+        p->scratch[j]= c;
+        if ((start != pend || i - start != 1) \
+                && _addRun(p, j, start, i - start) < 0)
+            return -1;
+        pend= i;
+        j++;
+    }
+    if (p->numruns == 0 && _addRun(p, 0, 0, 1) < 0)
+        return -1;
+    return j;
+}
+
+/**
+ * \brief	original (start, end) of a find in the len long normalized
+ *          input of a srclen long source, (-1, -1) if it did not match
+ */
+static void
+_mapSpan(IppchPipelineObject *p, const IppRegExpFind *find, int len, \
+        int srclen, Ipp32s *span)
+{
+    Ipp32s unused;
+    int s;
+
+    if (find->pFind == NULL) {
+        span[0]= span[1]= -1;
+        return;
+    }
+    s= (int)((const Ipp8u *)find->pFind - p->scratch);
+    if (s < len)
+        _origin(p, s, &span[0], &unused);
+    else
+        span[0]= srclen;
+    if (find->lenFind > 0)
+        _origin(p, s + find->lenFind - 1, &unused, &span[1]);
+    else
+        span[1]= span[0];
+}
+
+/**
+ * \brief	normalize and scan, both locks held, no GIL needed
+ * \return	ipp status, ippStsNoMemErr if the scratch could not grow
+ *
+ * For a single state find[*numfind] is filled, for a multi state mf.
+ * spans receives the original (start, end) of every find entry, or of
+ * the first find of every multi state.
+ */
+static IppStatus
+_pipeScan(IppchPipelineObject *p, const Ipp8u *src, int srclen, \
+        IppRegExpFind *find, int *numfind, IppRegExpMultiFind *mf, \
+        Ipp32s *spans)
+{
+    IppRegExpStateObject *o= p->o;
+    IppStatus istatus;
+    int i, len;
+
+    len= _normalize(p, src, srclen);
+    if (len < 0)
+        return ippStsNoMemErr;
+    if (mf == NULL) {
+        istatus= _findUnlocked(o->ires, p->scratch, len, find, numfind);
+        for (i= 0; istatus == ippStsNoErr && i < *numfind; ++i)
+            _mapSpan(p, find + i, len, srclen, spans + 2 * i);
+        return istatus;
+    }
+    istatus= _multiFindUnlocked(o->irems, o->numpatterns, o->capacity, \
+            p->scratch, len, mf);
+    for (i= 0; istatus == ippStsNoErr && i < o->numpatterns; ++i) {
+        if (mf[i].status == ippStsNoErr && mf[i].numMultiFind > 0)
+            _mapSpan(p, mf[i].pFind, len, srclen, spans + 2 * i);
+        else
+            spans[2*i]= spans[2*i+1]= -1;
+    }
+    return istatus;
+}
+
+/**
+ * \brief	run _pipeScan with the pipeline and state locks
+ *
+ * Short inputs are scanned with the GIL if both locks are free, like
+ * search() does, everything else releases the GIL first.
+ */
+static IppStatus
+_pipeRun(IppchPipelineObject *p, const Ipp8u *src, int len, \
+        IppRegExpFind *find, int *numfind, IppRegExpMultiFind *mf, \
+        Ipp32s *spans)
+{
+    IppStatus istatus;
+
+    if (len < NOGIL_THRESHOLD && PyThread_acquire_lock(p->lock, 0)) {
+        if (PyThread_acquire_lock(p->o->lock, 0)) {
+            istatus= _pipeScan(p, src, len, find, numfind, mf, spans);
+            PyThread_release_lock(p->o->lock);
+            PyThread_release_lock(p->lock);
+            return istatus;
+        }
+        PyThread_release_lock(p->lock);
+    }
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(p->lock, 1);
+    PyThread_acquire_lock(p->o->lock, 1);
+    istatus= _pipeScan(p, src, len, find, numfind, mf, spans);
+    PyThread_release_lock(p->o->lock);
+    PyThread_release_lock(p->lock);
+    Py_END_ALLOW_THREADS
+    return istatus;
+}
+
+/**
+ * \brief	IppchPipelineObject method returning the normalized source
+ * \return	string
+ */
+static PyObject *
+pipe_normalize(PyObject *self, PyObject *source)
+{
+    IppchPipelineObject *p= (IppchPipelineObject *)self;
+    PyObject *retval;
+    int len;
+
+    if (!PyString_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(p->lock, 1);
+    Py_END_ALLOW_THREADS
+    len= _normalize(p, (const Ipp8u *)PyString_AS_STRING(source), \
+            (int)PyString_GET_SIZE(source));
+    retval= len < 0 ? PyErr_NoMemory() : \
+        PyString_FromStringAndSize((const char *)p->scratch, len);
+    PyThread_release_lock(p->lock);
+    return retval;
+}
+
+/**
+ * \brief	IppchPipelineObject method, search() on the normalized source
+ * \return	None or result dict, spans are offsets of the original source
+ */
+static PyObject *
+pipe_search(PyObject *self, PyObject *source)
+{
+    IppchPipelineObject *p= (IppchPipelineObject *)self;
+    PyObject *retval= NULL, *list, *span, *value;
+    IppRegExpFind *find;
+    Ipp32s *spans;
+    IppStatus istatus;
+    int i, numfind;
+
+    if (_ensureState(p->o, 0) < 0)
+        return NULL;
+    if (!PyString_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type");
+        return NULL;
+    }
+    numfind= p->o->numgroups + 1;
+    find= PyMem_New(IppRegExpFind, numfind);
+    spans= PyMem_New(Ipp32s, 2 * numfind);
+    if (find == NULL || spans == NULL) {
+        PyErr_NoMemory();
+        goto free;
+    }
+    istatus= _pipeRun(p, (const Ipp8u *)PyString_AS_STRING(source), \
+            (int)PyString_GET_SIZE(source), find, &numfind, NULL, spans);
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("si", "IppRegExpFind: Error Ipp Status", istatus);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        goto free;
+    }
+    retval= _buildSearchResult(numfind);
+    if (retval == NULL || retval == Py_None)
+        goto free;
+    list= PyList_New(numfind);
+    if (list == NULL)
+        goto error;
+    for (i= 0; i < numfind; ++i) {
+        span= Py_BuildValue("ii", spans[2*i], spans[2*i+1]);
+        if (span == NULL) {
+            Py_DECREF(list);
+            goto error;
+        }
+        PyList_SET_ITEM(list, i, span);
+    }
+    if (PyDict_SetItemString(retval, "spans", list) < 0) {
+        Py_DECREF(list);
+        goto error;
+    }
+    Py_DECREF(list);
+    goto free;
+error:
+    Py_CLEAR(retval);
+free:
+    PyMem_Free(find);
+    PyMem_Free(spans);
+    return retval;
+}
+
+/**
+ * \brief	IppchPipelineObject method, searchMulti() on the normalized source
+ * \return	list as searchMulti(), found entries get the original "span"
+ */
+static PyObject *
+pipe_searchMulti(PyObject *self, PyObject *source)
+{
+    IppchPipelineObject *p= (IppchPipelineObject *)self;
+    IppRegExpStateObject *o= p->o;
+    PyObject *retval= NULL, *span, *value;
+    IppRegExpMultiFind *mf= NULL;
+    Ipp32s *spans= NULL, *sp;
+    IppStatus istatus;
+    int i;
+
+    if (_ensureState(o, 1) < 0)
+        return NULL;
+    if (!PyString_Check(source)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type");
+        return NULL;
+    }
+    mf= _newMultiFind(o->numpatterns, o->capacity);
+    spans= PyMem_New(Ipp32s, 2 * o->numpatterns + 1);
+    if (mf == NULL || spans == NULL) {
+        PyErr_NoMemory();
+        goto free;
+    }
+    istatus= _pipeRun(p, (const Ipp8u *)PyString_AS_STRING(source), \
+            (int)PyString_GET_SIZE(source), NULL, NULL, mf, spans);
+    if (istatus != ippStsNoErr) {
+        value= Py_BuildValue("si", \
+                "IppRegExpMultiFind: Error Ipp Status", istatus);
+        PyErr_SetObject(IppchError, value);
+        Py_XDECREF(value);
+        goto free;
+    }
+    retval= _buildMultiResult(o, mf);
+    if (retval == NULL)
+        goto free;
+    for (i= 0; i < o->numentries; ++i) {
+        sp= spans + 2 * o->entrystate[i];
+        if (sp[0] < 0)
+            continue;
+        span= Py_BuildValue("ii", sp[0], sp[1]);
+        if (span == NULL || PyDict_SetItemString( \
+                    PyList_GET_ITEM(retval, i), "span", span) < 0) {
+            Py_XDECREF(span);
+            Py_CLEAR(retval);
+            goto free;
+        }
+        Py_DECREF(span);
+    }
+free:
+    free(mf);
+    PyMem_Free(spans);
+    return retval;
+}
+
+/**
+ * \brief	IppchPipelineObject Methods
+ */
+static PyMethodDef IppchPipelineObject_Methods[]= {
+    {"normalize", pipe_normalize, METH_O,
+        "The source after the normalization steps"},
+    {"search", pipe_search, METH_O,
+        "search() on the normalized source, spans index the original"},
+    {"searchMulti", pipe_searchMulti, METH_O,
+        "searchMulti() on the normalized source, spans index the original"},
+	{NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+/**
+ * \brief	IppchPipelineObject Members
+ */
+static PyMemberDef IppchPipelineObject_Members[]= {
+    {"state", T_OBJECT, offsetof(IppchPipelineObject, o), READONLY,
+        "compiled state scanned after normalizing"},
+    {"steps", T_INT, offsetof(IppchPipelineObject, steps), READONLY,
+        "mask of the normalization steps"},
+	{NULL} /* Sentinel */
+};
+
+/**
+ * \brief	IppchPipelineObject type definition
+ */
+static PyTypeObject IppchPipelineObject_Type= {
+    PyObject_HEAD_INIT(NULL)
+    0,                              /**< ob_size */
+    "_ippch.IppchPipelineObject",   /**< tp_name */
+    sizeof(IppchPipelineObject),    /**< tp_basicsize */
+    0,                              /**< tp_itemsize */
+    (destructor)_dealloc_IppchPipelineObject, /**< tp_dealloc */
+    0,                              /**< tp_print */
+    0,                              /**< tp_getattr */
+    0,                              /**< tp_setattr */
+    0,                              /**< tp_compare */
+    0,                              /**< tp_repr */
+    0,                              /**< tp_as_number */
+    0,                              /**< tp_as_sequence */
+    0,                              /**< tp_as_mapping */
+    0,                              /**< tp_hash */
+    0,                              /**< tp_call */
+    0,                              /**< tp_str */
+    0,                              /**< tp_getattro */
+    0,                              /**< tp_setattro */
+    0,                              /**< tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,             /**< tp_flags */
+    "normalization steps fused with a compiled state", /**< tp_doc */
+    0,                              /**< tp_traverse */
+    0,                              /**< tp_clear */
+    0,                              /**< tp_richcompare */
+    0,                              /**< tp_weaklistoffset */
+    0,                              /**< tp_iter */
+    0,                              /**< tp_iternext */
+    IppchPipelineObject_Methods,    /**< tp_methods */
+    IppchPipelineObject_Members,    /**< tp_members */
+};
+
+/**
+ * \brief	create a pipeline from a compiled state and step names
+ * \return	IppchPipelineObject
+ */
+static PyObject *
+_pipeline(PyObject *self, PyObject *args)
+{
+    PyObject *state, *steps, *seq, *item;
+    IppchPipelineObject *p;
+    Py_ssize_t i;
+    int k, mask= 0;
+
+    if (!PyArg_ParseTuple(args, "O!O", &IppRegExpStateObject_Type, &state, \
+                &steps))
+        return NULL;
+    seq= PySequence_Fast(steps, "steps must be a sequence");
+    if (seq == NULL)
+        return NULL;
+    for (i= 0; i < PySequence_Fast_GET_SIZE(seq); ++i) {
+        item= PySequence_Fast_GET_ITEM(seq, i);
+        for (k= 0; k < 4; ++k)
+            if (PyString_Check(item) \
+                    && strcmp(PyString_AS_STRING(item), norm_names[k]) == 0)
+                break;
+        if (k == 4) {
+            Py_DECREF(seq);
+            PyErr_SetString(PyExc_ValueError, \
+                    "steps are urldecode, strip, collapse and lower");
+            return NULL;
+        }
+        mask|= 1 << k;
+    }
+    Py_DECREF(seq);
+    p= PyObject_New(IppchPipelineObject, &IppchPipelineObject_Type);
+    if (p == NULL)
+        return NULL;
+    Py_INCREF(state);
+    p->o= (IppRegExpStateObject *)state;
+    p->steps= mask;
+    p->scratch= NULL;
+    p->capacity= 0;
+    p->runs= NULL;
+    p->numruns= p->maxruns= 0;
+    p->lock= PyThread_allocate_lock();
+    if (p->lock == NULL) {
+        Py_DECREF(p);
+        return PyErr_NoMemory();
+    }
+    return (PyObject *)p;
+}
+
+/**
+ * \brief	Aho-Corasick automaton of a keyword index
+ *
+ * States are numbered in breadth first order, the edges of state s are
+ * edgechar/edgenext[edgestart[s] .. edgestart[s+1]) sorted by byte.
+ * The root uses a dense table. outnext links a state to the nearest
+ * state on its fail chain ending a keyword, kwnext chains keywords
+ * with the same text.
+ */
+typedef struct {
+    int numstates;
+    int numkeywords;
+    Ipp32s root[256];               /**< dense transitions of state 0 */
+    Ipp32s *edgestart;              /**< [numstates + 1] */
+    Ipp8u *edgechar;                /**< [numstates - 1] */
+    Ipp32s *edgenext;               /**< [numstates - 1] */
+    Ipp32s *fail;                   /**< [numstates] */
+    Ipp32s *out;                    /**< first keyword ending in s or -1 */
+    Ipp32s *outnext;                /**< [numstates] */
+    Ipp32s *kwid;                   /**< [numkeywords] */
+    Ipp32s *kwlen;                  /**< [numkeywords] */
+    Ipp32s *kwnext;                 /**< [numkeywords] */
+    size_t size;                    /**< bytes of the tables */
+} IppchAutomaton;
+
+/**
+ * \brief	keyword trie of an index, grown by add()
+ *
+ * A first child/next sibling trie holding the folded keyword bytes, so
+ * the automaton is packed from it without touching Python objects.
+ * tout chains the keywords ending in a node through kwnext.
+ */
+typedef struct {
+    int numnodes;
+    int maxnodes;
+    int numkeywords;
+    int maxkeywords;
+    Ipp32s root[256];               /**< children of node 0 by byte */
+    Ipp32s *child;                  /**< first child or 0 */
+    Ipp32s *sib;                    /**< next sibling or 0 */
+    Ipp32s *tout;                   /**< first keyword ending here or -1 */
+    Ipp8u *tchar;                   /**< byte of the edge into the node */
+    Ipp32s *kwid;                   /**< [numkeywords] */
+    Ipp32s *kwlen;                  /**< [numkeywords] */
+    Ipp32s *kwnext;                 /**< [numkeywords] */
+} IppchTrie;
+
+/**
+ * \brief	IppchKeywordsObject, multi literal index
+ */
+typedef struct {
+    PyObject_HEAD
+    int icase;                      /**< latin case insensitive */
+    int dirty;                      /**< keywords added since the build */
+    Ipp8u fold[256];                /**< byte translation of input */
+    IppchTrie trie;
+    IppchAutomaton ac;
+    PyThread_type_lock buildlock;   /**< guards trie and builds */
+    PyThread_type_lock lock;        /**< guards ac during scans */
+} IppchKeywordsObject;
+
+static PyTypeObject IppchKeywordsObject_Type;
+
+/**
+ * \brief	free the tables of an automaton
+ */
+static void
+_acFree(IppchAutomaton *a)
+{
+    free(a->edgestart);
+    free(a->edgechar);
+    free(a->edgenext);
+    free(a->fail);
+    free(a->out);
+    free(a->outnext);
+    free(a->kwid);
+    free(a->kwlen);
+    free(a->kwnext);
+    memset(a, 0, sizeof(IppchAutomaton));
+}
+
+/**
+ * \brief	goto of state s on byte c, following fail links
+ * \return	next state, 0 (root) if no keyword prefix continues
+ */
+static Ipp32s
+_acNext(const IppchAutomaton *a, Ipp32s s, Ipp8u c)
+{
+    Ipp32s lo, hi, mid;
+
+    for (;;) {
+        if (s == 0)
+            return a->root[c];
+        lo= a->edgestart[s];
+        hi= a->edgestart[s+1];
+        while (lo < hi) {
+            mid= (lo + hi) >> 1;
+            if (a->edgechar[mid] < c)
+                lo= mid + 1;
+            else
+                hi= mid;
+        }
+        if (lo < a->edgestart[s+1] && a->edgechar[lo] == c)
+            return a->edgenext[lo];
+        s= a->fail[s];
+    }
+}
+
+/**
+ * \brief	free the tables of a trie
+ */
+static void
+_trieFree(IppchTrie *t)
+{
+    free(t->child);
+    free(t->sib);
+    free(t->tout);
+    free(t->tchar);
+    free(t->kwid);
+    free(t->kwlen);
+    free(t->kwnext);
+    memset(t, 0, sizeof(IppchTrie));
+}
+
+/**
+ * \brief	make room for nodes more nodes and keywords more keywords
+ * \return	0 on success, -1 if no memory is available
+ *
+ * The trie is unchanged on failure, an empty trie gets its root node.
+ */
+static int
+_trieGrow(IppchTrie *t, int nodes, int keywords)
+{
+    void *p;
+    int n, i;
+
+    if (t->numnodes == 0)
+        nodes++;
+    if (t->numnodes + nodes > t->maxnodes) {
+        n= t->maxnodes ? t->maxnodes : 64;
+        while (n < t->numnodes + nodes)
+            n*= 2;
+        if ((p= realloc(t->child, sizeof(Ipp32s) * n)) == NULL)
+            return -1;
+        t->child= p;
+        if ((p= realloc(t->sib, sizeof(Ipp32s) * n)) == NULL)
+            return -1;
+        t->sib= p;
+        if ((p= realloc(t->tout, sizeof(Ipp32s) * n)) == NULL)
+            return -1;
+        t->tout= p;
+        if ((p= realloc(t->tchar, n)) == NULL)
+            return -1;
+        t->tchar= p;
+        t->maxnodes= n;
+    }
+    if (t->numkeywords + keywords > t->maxkeywords) {
+        n= t->maxkeywords ? t->maxkeywords : 16;
+        while (n < t->numkeywords + keywords)
+            n*= 2;
+        if ((p= realloc(t->kwid, sizeof(Ipp32s) * n)) == NULL)
+            return -1;
+        t->kwid= p;
+        if ((p= realloc(t->kwlen, sizeof(Ipp32s) * n)) == NULL)
+            return -1;
+        t->kwlen= p;
+        if ((p= realloc(t->kwnext, sizeof(Ipp32s) * n)) == NULL)
+            return -1;
+        t->kwnext= p;
+        t->maxkeywords= n;
+    }
+    if (t->numnodes == 0) {
+        for (i= 0; i < 256; ++i)
+            t->root[i]= 0;
+        t->child[0]= t->sib[0]= 0;
+        t->tout[0]= -1;
+        t->numnodes= 1;
+    }
+    return 0;
+}
+
+/**
+ * \brief	insert a keyword, room was made by _trieGrow()
+ */
+static void
+_trieInsert(IppchTrie *t, const Ipp8u *fold, const Ipp8u *kw, int len, \
+        Ipp32s id)
+{
+    int j, node= 0, u;
+    Ipp8u c;
+
+    for (j= 0; j < len; ++j) {
+        c= fold[kw[j]];
+        if (node == 0)
+            u= t->root[c];
+        else
+            for (u= t->child[node]; u && t->tchar[u] != c; u= t->sib[u])
+                ;
+        if (u == 0) {
+            u= t->numnodes++;
+            t->tchar[u]= c;
+            t->child[u]= 0;
+            t->tout[u]= -1;
+            t->sib[u]= t->child[node];
+            t->child[node]= u;
+            if (node == 0)
+                t->root[c]= u;
+        }
+        node= u;
+    }
+    u= t->numkeywords++;
+    t->kwid[u]= id;
+    t->kwlen[u]= len;
+    t->kwnext[u]= t->tout[node];
+    t->tout[node]= u;
+}
+
+/**
+ * \brief	pack a trie into an automaton, no GIL needed
+ * \return	0 on success, -1 if no memory is available
+ *
+ * The trie is renumbered breadth first into the packed edge arrays,
+ * fail and output links are filled in the same pass.
+ */
+static int
+_acPack(IppchAutomaton *a, const IppchTrie *tr)
+{
+    Ipp32s *order= NULL, kids[256];
+    int i, j, m, node, t, head, tail, e= 0, n= tr->numkeywords;
+    int nodes= tr->numnodes;
+    Ipp32s u, v, f;
+
+    memset(a, 0, sizeof(IppchAutomaton));
+    a->kwid= malloc(sizeof(Ipp32s) * (n + 1));
+    a->kwlen= malloc(sizeof(Ipp32s) * (n + 1));
+    a->kwnext= malloc(sizeof(Ipp32s) * (n + 1));
+    a->edgestart= malloc(sizeof(Ipp32s) * (nodes + 1));
+    a->edgechar= malloc(nodes);
+    a->edgenext= malloc(sizeof(Ipp32s) * nodes);
+    a->fail= malloc(sizeof(Ipp32s) * nodes);
+    a->out= malloc(sizeof(Ipp32s) * nodes);
+    a->outnext= malloc(sizeof(Ipp32s) * nodes);
+    order= malloc(sizeof(Ipp32s) * nodes);
+    if (!a->kwid || !a->kwlen || !a->kwnext || !a->edgestart \
+            || !a->edgechar || !a->edgenext || !a->fail || !a->out \
+            || !a->outnext || !order) {
+        free(order);
+        _acFree(a);
+        return -1;
+    }
+    memcpy(a->kwid, tr->kwid, sizeof(Ipp32s) * n);
+    memcpy(a->kwlen, tr->kwlen, sizeof(Ipp32s) * n);
+    memcpy(a->kwnext, tr->kwnext, sizeof(Ipp32s) * n);
+    a->numkeywords= n;
+    a->numstates= nodes;
+    /* order: trie node of a state */
+    order[0]= 0;
+    a->fail[0]= 0;
+    a->out[0]= -1;
+    a->outnext[0]= 0;
+    for (head= 0, tail= 1; head < tail; ++head) {
+        u= head;
+        node= order[head];
+        a->edgestart[u]= e;
+        for (m= 0, t= tr->child[node]; t; t= tr->sib[t])
+            kids[m++]= t;
+        /* sort the children by byte, at most 256 of them */
+        for (i= 1; i < m; ++i) {
+            t= kids[i];
+            for (j= i; j > 0 && tr->tchar[kids[j-1]] > tr->tchar[t]; --j)
+                kids[j]= kids[j-1];
+            kids[j]= t;
+        }
+        for (i= 0; i < m; ++i) {
+            t= kids[i];
+            v= tail++;
+            order[v]= t;
+            a->edgechar[e]= tr->tchar[t];
+            a->edgenext[e]= v;
+            e++;
+        }
+        if (u == 0) {
+            memset(a->root, 0, sizeof(a->root));
+            for (i= a->edgestart[0]; i < e; ++i)
+                a->root[a->edgechar[i]]= a->edgenext[i];
+        }
+        /* states of u's children: fail links point to lower depths */
+        for (i= a->edgestart[u]; i < e; ++i) {
+            v= a->edgenext[i];
+            f= u == 0 ? 0 : _acNext(a, a->fail[u], a->edgechar[i]);
+            a->fail[v]= f;
+            a->out[v]= tr->tout[order[v]];
+            a->outnext[v]= a->out[f] >= 0 ? f : a->outnext[f];
+        }
+    }
+    a->edgestart[nodes]= e;
+    a->size= sizeof(IppchAutomaton) + (size_t)nodes * (5 * sizeof(Ipp32s) \
+            + 1) + sizeof(Ipp32s) * (1 + 3 * (size_t)n);
+    free(order);
+    return 0;
+}
+
+/**
+ * \brief	grow the malloc'd ids/starts/ends of a search() result
+ * \return	0 on success, -1 if no memory is available
+ */
+static int
+_growColumns(IppchColumns *c)
+{
+    Py_ssize_t n= c->capacity ? 2 * c->capacity : 64;
+    void *p;
+
+    if ((p= realloc(c->ids, sizeof(Ipp32s) * n)) == NULL)
+        return -1;
+    c->ids= p;
+    if ((p= realloc(c->starts, sizeof(Ipp32s) * n)) == NULL)
+        return -1;
+    c->starts= p;
+    if ((p= realloc(c->ends, sizeof(Ipp32s) * n)) == NULL)
+        return -1;
+    c->ends= p;
+    c->capacity= n;
+    return 0;
+}
+
+/**
+ * \brief	scan one source, no GIL needed
+ * \return	number of matches, records past c->capacity are not written
+ *
+ * Every occurrence is reported, overlapping ones included, ordered by
+ * end offset. With grow set the columns are grown by _growColumns()
+ * instead, a result larger than c->capacity means no memory.
+ */
+static Py_ssize_t
+_acScan(const IppchKeywordsObject *kw, const Ipp8u *src, int len, \
+        Ipp32s input, IppchColumns *c, Py_ssize_t nw, int grow)
+{
+    const IppchAutomaton *a= &kw->ac;
+    Py_ssize_t found= 0;
+    Ipp32s s= 0, t, k;
+    int i;
+
+    if (a->numstates == 0)
+        return 0;
+    for (i= 0; i < len; ++i) {
+        s= _acNext(a, s, kw->fold[src[i]]);
+        for (t= s; t; t= a->outnext[t]) {
+            for (k= a->out[t]; k >= 0; k= a->kwnext[k], found++) {
+                if (nw + found >= c->capacity \
+                        && (!grow || _growColumns(c) < 0))
+                    continue;
+                c->ids[nw+found]= a->kwid[k];
+                c->starts[nw+found]= i + 1 - a->kwlen[k];
+                c->ends[nw+found]= i + 1;
+                if (c->inputs)
+                    c->inputs[nw+found]= input;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * \brief	rebuild the automaton if keywords were added, GIL held
+ * \return	0 on success, -1 with exception set
+ *
+ * The tables are packed from the trie without the GIL and swapped in
+ * under the lock, so scans keep using the old ones meanwhile.
+ */
+static int
+_kwEnsure(IppchKeywordsObject *kw)
+{
+    IppchAutomaton a, old;
+    int r= 0;
+
+    if (!kw->dirty)
+        return 0;
+    memset(&old, 0, sizeof(IppchAutomaton));
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(kw->buildlock, 1);
+    /* another thread may have built it meanwhile */
+    if (kw->dirty) {
+        r= _acPack(&a, &kw->trie);
+        if (r == 0) {
+            PyThread_acquire_lock(kw->lock, 1);
+            old= kw->ac;
+            kw->ac= a;
+            kw->dirty= 0;
+            PyThread_release_lock(kw->lock);
+        }
+    }
+    PyThread_release_lock(kw->buildlock);
+    _acFree(&old);
+    Py_END_ALLOW_THREADS
+    if (r < 0) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief	append keywords, entries are strings or (keyword, id) tuples
+ * \return	0 on success, -1 with exception set
+ *
+ * Ids default to the position in the index + 1 like compileMulti. The
+ * new keywords are inserted into the trie, all entries are checked
+ * first so the index is unchanged on errors.
+ */
+static int
+_kwAdd(IppchKeywordsObject *kw, PyObject *keywords)
+{
+    PyObject *seq, *item, *pid, **words= NULL;
+    Py_ssize_t i, n, total= 0;
+    Ipp32s *ids= NULL;
+    IppchTrie *t= &kw->trie;
+    long id;
+    int r, dflt, retval= -1;
+
+    seq= PySequence_Fast(keywords, "keywords must be a sequence");
+    if (seq == NULL)
+        return -1;
+    n= PySequence_Fast_GET_SIZE(seq);
+    words= PyMem_New(PyObject *, n + 1);
+    ids= PyMem_New(Ipp32s, n + 1);
+    if (!words || !ids) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    for (i= 0; i < n; ++i) {
+        item= PySequence_Fast_GET_ITEM(seq, i);
+        id= 0;
+        dflt= 1;
+        words[i]= item;
+        if (PyTuple_Check(item)) {
+            pid= NULL;
+            if (!PyArg_ParseTuple(item, "O|O:keyword entry", &words[i], \
+                        &pid))
+                goto error;
+            if (pid && pid != Py_None) {
+                id= PyInt_AsLong(pid);
+                if (id == -1 && PyErr_Occurred())
+                    goto error;
+                dflt= 0;
+            }
+        }
+        if (!PyString_Check(words[i])) {
+            PyErr_SetString(PyExc_TypeError, "wrong argument type!");
+            goto error;
+        }
+        if (PyString_GET_SIZE(words[i]) == 0 || id < 0 \
+                || id > 0x7fffffffL) {
+            PyErr_SetString(PyExc_ValueError, \
+                    "empty keyword or id out of range");
+            goto error;
+        }
+        /* -1 for the default id, assigned under the lock */
+        ids[i]= dflt ? -1 : (Ipp32s)id;
+        total+= PyString_GET_SIZE(words[i]);
+    }
+    if (total > 0x7fffffffL - kw->trie.numnodes || n > 0x7fffffffL / 2) {
+        PyErr_SetString(PyExc_ValueError, "too many keywords");
+        goto error;
+    }
+    if (!PyThread_acquire_lock(kw->buildlock, 0)) {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(kw->buildlock, 1);
+        Py_END_ALLOW_THREADS
+    }
+    r= _trieGrow(t, (int)total, (int)n);
+    if (r == 0) {
+        for (i= 0; i < n; ++i)
+            _trieInsert(t, kw->fold, \
+                    (const Ipp8u *)PyString_AS_STRING(words[i]), \
+                    (int)PyString_GET_SIZE(words[i]), \
+                    ids[i] >= 0 ? ids[i] : t->numkeywords + 1);
+        kw->dirty= 1;
+    }
+    PyThread_release_lock(kw->buildlock);
+    if (r < 0) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    retval= 0;
+error:
+    PyMem_Free(words);
+    PyMem_Free(ids);
+    Py_DECREF(seq);
+    return retval;
+}
+
+/**
+ * \brief	IppchKeywordsObject dealloc function
+ */
+static void
+_dealloc_IppchKeywordsObject(PyObject *self)
+{
+    IppchKeywordsObject *kw= (IppchKeywordsObject *)self;
+
+    _acFree(&kw->ac);
+    _trieFree(&kw->trie);
+    if (kw->lock)
+        PyThread_free_lock(kw->lock);
+    if (kw->buildlock)
+        PyThread_free_lock(kw->buildlock);
+    PyObject_Del(self);
+}
+
+/**
+ * \brief	IppchKeywordsObject method adding keywords
+ * \return	None, the automaton is rebuilt on the next scan
+ */
+static PyObject *
+kw_add(PyObject *self, PyObject *keywords)
+{
+    if (_kwAdd((IppchKeywordsObject *)self, keywords) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	IppchKeywordsObject method rebuilding the automaton now
+ * \return	None
+ */
+static PyObject *
+kw_rebuild(PyObject *self, PyObject *args)
+{
+    if (_kwEnsure((IppchKeywordsObject *)self) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	IppchKeywordsObject method, all occurrences in a buffer
+ * \return	list of (id, start, end) ordered by end
+ */
+static PyObject *
+kw_search(PyObject *self, PyObject *source)
+{
+    IppchKeywordsObject *kw= (IppchKeywordsObject *)self;
+    PyObject *retval= NULL, *item;
+    IppchColumns c;
+    Py_buffer view;
+    Py_ssize_t i, n;
+
+    if (_kwEnsure(kw) < 0)
+        return NULL;
+    if (PyObject_GetBuffer(source, &view, PyBUF_SIMPLE) < 0)
+        return NULL;
+    memset(&c, 0, sizeof(c));
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(kw->lock, 1);
+    n= _acScan(kw, view.buf, (int)view.len, 0, &c, 0, 1);
+    PyThread_release_lock(kw->lock);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    if (n > c.capacity)
+        PyErr_NoMemory();
+    else
+        retval= PyList_New(n);
+    for (i= 0; retval && i < n; ++i) {
+        item= Py_BuildValue("iii", c.ids[i], c.starts[i], c.ends[i]);
+        if (item == NULL)
+            Py_CLEAR(retval);
+        else
+            PyList_SET_ITEM(retval, i, item);
+    }
+    free(c.ids);
+    free(c.starts);
+    free(c.ends);
+    return retval;
+}
+
+/**
+ * \brief	scan a batch into columnar outputs, the *Into common part
+ * \return	tuple (records written, next source index)
+ */
+static PyObject *
+_kwScanInto(IppchKeywordsObject *kw, IppchBatch *b, Py_ssize_t first, \
+        IppchColumns *c)
+{
+    Py_ssize_t i, m, nw= 0;
+    const Ipp8u *src;
+    int len;
+
+    if (c->ids == NULL || c->starts == NULL || c->ends == NULL) {
+        PyErr_SetString(PyExc_TypeError, "ids, starts and ends are required");
+        return NULL;
+    }
+    if (first < 0 || first > b->n) {
+        PyErr_SetString(PyExc_IndexError, "first out of range");
+        return NULL;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(kw->lock, 1);
+    for (i= first; i < b->n; ++i) {
+        _batchItem(b, i, &src, &len);
+        m= _acScan(kw, src, len, (Ipp32s)i, c, nw, 0);
+        /* a source is written completely or left for the next call */
+        if (nw + m > c->capacity)
+            break;
+        nw+= m;
+    }
+    PyThread_release_lock(kw->lock);
+    Py_END_ALLOW_THREADS
+    if (nw == 0 && i < b->n) {
+        PyErr_SetString(PyExc_ValueError, \
+                "output buffers too small for the matches of one source");
+        return NULL;
+    }
+    return Py_BuildValue("nn", nw, i);
+}
+
+/**
+ * \brief	IppchKeywordsObject method, searchMultiBatchInto() equivalent
+ * \return	tuple (records written, next source index)
+ */
+static PyObject *
+kw_searchBatchInto(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"sources", "ids", "starts", "ends", "inputs", \
+        "first", NULL};
+    PyObject *sources, *seq, *ids, *starts, *ends;
+    PyObject *inputs= NULL, *retval= NULL;
+    Py_ssize_t first= 0;
+    IppchBatch b;
+    IppchColumns c;
+    IppchKeywordsObject *kw= (IppchKeywordsObject *)self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOO|On", kwlist, \
+                &sources, &ids, &starts, &ends, &inputs, &first))
+        return NULL;
+    if (_kwEnsure(kw) < 0)
+        return NULL;
+    seq= _batchFromList(&b, sources);
+    if (seq == NULL)
+        return NULL;
+    if (_getColumns(&c, ids, starts, ends, inputs) == 0) {
+        retval= _kwScanInto(kw, &b, first, &c);
+        _releaseColumns(&c);
+    }
+    _freeBatch(&b);
+    Py_DECREF(seq);
+    return retval;
+}
+
+/**
+ * \brief	IppchKeywordsObject method, searchMultiPackedInto() equivalent
+ * \return	tuple (records written, next source index)
+ */
+static PyObject *
+kw_searchPackedInto(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"data", "offsets", "ids", "starts", "ends", \
+        "inputs", "first", NULL};
+    PyObject *data, *offsets, *ids, *starts, *ends;
+    PyObject *inputs= NULL, *retval= NULL;
+    Py_ssize_t first= 0;
+    Py_buffer dview, oview;
+    IppchBatch b;
+    IppchColumns c;
+    IppchKeywordsObject *kw= (IppchKeywordsObject *)self;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "OOOOO|On", kwlist, \
+                &data, &offsets, &ids, &starts, &ends, &inputs, &first))
+        return NULL;
+    if (_kwEnsure(kw) < 0)
+        return NULL;
+    if (_batchFromPacked(&b, data, offsets, &dview, &oview) < 0)
+        return NULL;
+    if (_getColumns(&c, ids, starts, ends, inputs) == 0) {
+        retval= _kwScanInto(kw, &b, first, &c);
+        _releaseColumns(&c);
+    }
+    PyBuffer_Release(&oview);
+    PyBuffer_Release(&dview);
+    return retval;
+}
+
+/**
+ * \brief	IppchKeywordsObject getter of the index statistics
+ * \return	dict with keywords, states and statesize
+ */
+static PyObject *
+kw_getStats(PyObject *self, void *closure)
+{
+    IppchKeywordsObject *kw= (IppchKeywordsObject *)self;
+
+    if (_kwEnsure(kw) < 0)
+        return NULL;
+    return Py_BuildValue("{sisisnsi}",
+            "keywords", kw->ac.numkeywords,
+            "states", kw->ac.numstates,
+            "statesize", (Py_ssize_t)kw->ac.size,
+            "icase", kw->icase);
+}
+
+/**
+ * \brief	IppchKeywordsObject Methods
+ */
+static PyMethodDef IppchKeywordsObject_Methods[]= {
+    {"add", kw_add, METH_O,
+        "Add keywords (strings or (keyword, id)), rebuilt on the next scan"},
+    {"rebuild", kw_rebuild, METH_NOARGS,
+        "Rebuild the automaton now instead of on the next scan"},
+    {"search", kw_search, METH_O,
+        "All keyword occurrences in a buffer as (id, start, end)"},
+    {"searchBatchInto", (PyCFunction)kw_searchBatchInto,
+        METH_VARARGS|METH_KEYWORDS,
+        "Scan a list into int32 id/start/end/input buffers"},
+    {"searchPackedInto", (PyCFunction)kw_searchPackedInto,
+        METH_VARARGS|METH_KEYWORDS,
+        "Scan data+offsets into int32 id/start/end/input buffers"},
+	{NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+/**
+ * \brief	IppchKeywordsObject Getters
+ */
+static PyGetSetDef IppchKeywordsObject_GetSet[]= {
+    {"stats", kw_getStats, NULL,
+        "keywords, states, statesize and icase of the index", NULL},
+	{NULL} /* Sentinel */
+};
+
+/**
+ * \brief	IppchKeywordsObject type definition
+ */
+static PyTypeObject IppchKeywordsObject_Type= {
+    PyObject_HEAD_INIT(NULL)
+    0,                              /**< ob_size */
+    "_ippch.IppchKeywordsObject",   /**< tp_name */
+    sizeof(IppchKeywordsObject),    /**< tp_basicsize */
+    0,                              /**< tp_itemsize */
+    (destructor)_dealloc_IppchKeywordsObject, /**< tp_dealloc */
+    0,                              /**< tp_print */
+    0,                              /**< tp_getattr */
+    0,                              /**< tp_setattr */
+    0,                              /**< tp_compare */
+    0,                              /**< tp_repr */
+    0,                              /**< tp_as_number */
+    0,                              /**< tp_as_sequence */
+    0,                              /**< tp_as_mapping */
+    0,                              /**< tp_hash */
+    0,                              /**< tp_call */
+    0,                              /**< tp_str */
+    0,                              /**< tp_getattro */
+    0,                              /**< tp_setattro */
+    0,                              /**< tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,             /**< tp_flags */
+    "Aho-Corasick index of literal keywords", /**< tp_doc */
+    0,                              /**< tp_traverse */
+    0,                              /**< tp_clear */
+    0,                              /**< tp_richcompare */
+    0,                              /**< tp_weaklistoffset */
+    0,                              /**< tp_iter */
+    0,                              /**< tp_iternext */
+    IppchKeywordsObject_Methods,    /**< tp_methods */
+    0,                              /**< tp_members */
+    IppchKeywordsObject_GetSet,     /**< tp_getset */
+};
+
+/**
+ * \brief	create a keyword index
+ * \return	IppchKeywordsObject
+ */
+static PyObject *
+_keywords(PyObject *self, PyObject *args)
+{
+    PyObject *keywords;
+    IppchKeywordsObject *kw;
+    int i, icase= 0;
+
+    if (!PyArg_ParseTuple(args, "O|i", &keywords, &icase))
+        return NULL;
+    kw= PyObject_New(IppchKeywordsObject, &IppchKeywordsObject_Type);
+    if (kw == NULL)
+        return NULL;
+    memset(&kw->ac, 0, sizeof(IppchAutomaton));
+    memset(&kw->trie, 0, sizeof(IppchTrie));
+    kw->icase= icase != 0;
+    kw->dirty= 1;
+    for (i= 0; i < 256; ++i)
+        kw->fold[i]= (Ipp8u)(kw->icase ? LATIN_LOWER(i) : i);
+    kw->lock= PyThread_allocate_lock();
+    kw->buildlock= PyThread_allocate_lock();
+    if (kw->lock == NULL || kw->buildlock == NULL \
+            || _trieGrow(&kw->trie, 0, 0) < 0) {
+        Py_DECREF(kw);
+        return PyErr_NoMemory();
+    }
+    if (_kwAdd(kw, keywords) < 0 || _kwEnsure(kw) < 0) {
+        Py_DECREF(kw);
+        return NULL;
+    }
+    return (PyObject *)kw;
+}
+
+/**
+ * \brief	job executed by the native worker pool
+ *
+ * run() is called on a worker thread without the GIL, done() is called
+ * afterwards on the same thread with the GIL held and frees the job.
+ */
+typedef struct _IppchJob {
+    struct _IppchJob *next;             /**< next queued job */
+    void (*run)(struct _IppchJob *);    /**< work, no Python API allowed */
+    void (*done)(struct _IppchJob *);   /**< completion, GIL held */
+} IppchJob;
+
+/**
+ * \brief	native worker pool shared by all state objects
+ */
+static struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t notempty;            /**< signaled when a job is queued */
+    pthread_t *threads;                 /**< running workers or NULL */
+    int numthreads;                     /**< configured workers, 0: cores */
+    int maxqueue;                       /**< queued jobs before submit fails */
+    int queued;                         /**< jobs waiting in the queue */
+    int running;                        /**< jobs being executed */
+    int started;                        /**< workers actually started */
+    int stop;                           /**< workers drain queue and exit */
+    IppchJob *head, *tail;
+} Pool= {
+    PTHREAD_MUTEX_INITIALIZER,
+    PTHREAD_COND_INITIALIZER,
+    NULL, 0, POOL_MAXQUEUE, 0, 0, 0, 0, NULL, NULL
+};
+
+/**
+ * \brief	worker thread main loop
+ */
+static void *
+_poolWorker(void *arg)
+{
+    IppchJob *job;
+    PyGILState_STATE gstate;
+
+    for (;;) {
+        pthread_mutex_lock(&Pool.mutex);
+        while (Pool.head == NULL && !Pool.stop)
+            pthread_cond_wait(&Pool.notempty, &Pool.mutex);
+        if (Pool.head == NULL) {
+            pthread_mutex_unlock(&Pool.mutex);
+            break;
+        }
+        job= Pool.head;
+        Pool.head= job->next;
+        if (Pool.head == NULL)
+            Pool.tail= NULL;
+        Pool.queued--;
+        Pool.running++;
+        pthread_mutex_unlock(&Pool.mutex);
+
+        job->run(job);
+        gstate= PyGILState_Ensure();
+        job->done(job);
+        PyGILState_Release(gstate);
+
+        pthread_mutex_lock(&Pool.mutex);
+        Pool.running--;
+        pthread_mutex_unlock(&Pool.mutex);
+    }
+    return NULL;
+}
+
+/**
+ * \brief	start the workers if they are not running, GIL held
+ * \return	0 on success, -1 with exception set
+ */
+static int
+_poolStart(void)
+{
+    int i, n;
+
+    if (Pool.threads != NULL)
+        return 0;
+    PyEval_InitThreads();
+    n= Pool.numthreads;
+    if (n <= 0)
+        n= ippGetNumCoresOnDie();
+    if (n <= 0)
+        n= 1;
+    Pool.threads= PyMem_Malloc(sizeof(pthread_t) * n);
+    if (Pool.threads == NULL) {
+        PyErr_NoMemory();
+        return -1;
+    }
+    Pool.stop= 0;
+    for (i= 0; i < n; ++i) {
+        if (pthread_create(&Pool.threads[i], NULL, _poolWorker, NULL) != 0)
+            break;
+    }
+    Pool.started= i;
+    if (i == 0) {
+        PyMem_Free(Pool.threads);
+        Pool.threads= NULL;
+        PyErr_SetString(IppchError, "could not start worker threads");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief	let the workers drain the queue and join them, GIL held
+ */
+static void
+_poolStop(void)
+{
+    int i;
+
+    if (Pool.threads == NULL)
+        return;
+    pthread_mutex_lock(&Pool.mutex);
+    Pool.stop= 1;
+    pthread_cond_broadcast(&Pool.notempty);
+    pthread_mutex_unlock(&Pool.mutex);
+    Py_BEGIN_ALLOW_THREADS
+    for (i= 0; i < Pool.started; ++i)
+        pthread_join(Pool.threads[i], NULL);
+    Py_END_ALLOW_THREADS
+    PyMem_Free(Pool.threads);
+    Pool.threads= NULL;
+    Pool.started= 0;
+    Pool.stop= 0;
+}
+
+/**
+ * \brief	forget the workers of the parent in a forked child
+ *
+ * Only the forking thread exists in the child, the pool is restarted
+ * on the next submit. Jobs queued in the parent are dropped.
+ */
+static void
+_poolAtForkChild(void)
+{
+    pthread_mutex_init(&Pool.mutex, NULL);
+    pthread_cond_init(&Pool.notempty, NULL);
+    Pool.threads= NULL;
+    Pool.started= 0;
+    Pool.queued= 0;
+    Pool.running= 0;
+    Pool.stop= 0;
+    Pool.head= Pool.tail= NULL;
+}
+
+/**
+ * \brief	queue a job, GIL held
+ * \return	0 on success, -1 with exception set
+ *
+ * Never waits, submitting usually happens on an event loop thread. A
+ * full queue raises IppchQueueFull and the caller owns the job again.
+ */
+static int
+_poolSubmit(IppchJob *job)
+{
+    if (_poolStart() < 0)
+        return -1;
+    job->next= NULL;
+    pthread_mutex_lock(&Pool.mutex);
+    if (Pool.queued >= Pool.maxqueue) {
+        pthread_mutex_unlock(&Pool.mutex);
+        PyErr_SetString(IppchQueueFull, "worker pool queue is full");
+        return -1;
+    }
+    if (Pool.tail)
+        Pool.tail->next= job;
+    else
+        Pool.head= job;
+    Pool.tail= job;
+    Pool.queued++;
+    pthread_cond_signal(&Pool.notempty);
+    pthread_mutex_unlock(&Pool.mutex);
+    return 0;
+}
+
+static PyObject *asyncio_module;        /**< asyncio or trollius */
+static PyObject *complete_future;       /**< _completeFuture callable */
+
+/**
+ * \brief	completes a future unless it is already done (cancelled)
+ *
+ * Scheduled on the event loop thread by loop.call_soon_threadsafe.
  */
 static PyObject *
-_create_IppRegExpMultiStateObject(PyObject *patterns, PyObject *flags)
+_completeFuture(PyObject *self, PyObject *args)
 {
-    char *pat, *p;
-	char opts[6]= "\0";
-    Py_ssize_t pat_len;
-    int ieos= 0, numCaptGroups= 0, i= 0, j= 0, statesize= 0, ss= 0;
-    int numpatterns;
-    IppStatus istatus;
-    PyObject *value, *tmpobj, *patternlist= NULL;
-	IppRegExpStateObject *ireso;
+    PyObject *future, *result, *exc, *r;
 
-    ireso= PyObject_New(IppRegExpStateObject, &IppRegExpStateObject_Type);
-    if (ireso == NULL)
-        goto error;
-    ireso->ires= NULL;
-    ireso->irems= NULL;
-    ireso->attr_dict= NULL;
-    if (!PyList_Check(patterns)) {
-        PyErr_SetString(PyExc_TypeError, "wrong argument type!");
-        goto error;
-    }
-    if (!PyInt_Check(flags)) {
-        PyErr_SetString(PyExc_TypeError, "wrong argument type!");
-        goto error;
+    if (!PyArg_ParseTuple(args, "OOO", &future, &result, &exc))
+        return NULL;
+    r= PyObject_CallMethod(future, "done", NULL);
+    if (r == NULL)
+        return NULL;
+    if (PyObject_IsTrue(r)) {
+        Py_DECREF(r);
+        Py_RETURN_NONE;
     }
-    numpatterns= PyList_Size(patterns);
-	istatus= ippsRegExpMultiInitAlloc(&(ireso->irems), (Ipp32u)numpatterns);
-	if (istatus != ippStsNoErr)
-		goto error;		/* mem ireso->irems ! */
-	ireso->attr_dict= PyDict_New(); /* mem attr_dict ! */
-	if (ireso->attr_dict == NULL) {
-		goto error;
-	}
-    patternlist= PyList_New(numpatterns);
-	if (patternlist == NULL)
-		goto error;
-	ippsRegExpMultiGetSize(numpatterns, &ss);
-	statesize+= ss;
-	_getIppOptString(flags, opts);
-	for (i= 0; i < numpatterns; ++i) {
-		tmpobj= PyList_GetItem(patterns, i);
-        Py_INCREF(tmpobj);
-		PyString_AsStringAndSize(tmpobj, &pat, &pat_len);
-		ippsRegExpGetSize(pat, &ss);
-		statesize+= ss;
-		istatus= ippsRegExpInitAlloc(pat, opts, &(ireso->ires), &ieos);
-		if (istatus != ippStsNoErr) {
-			value= Py_BuildValue("sisisi",
-					"ippstatus", istatus,
-					"idxerrpattern", i,
-					"eoffset", ieos);
-			PyErr_SetObject(IppchError, value);
-			goto free;
-		}
-		istatus= ippsRegExpMultiAdd(ireso->ires, (i+1), ireso->irems);
-        if (istatus != ippStsNoErr) {
-		    value= Py_BuildValue("si",
-                    "ippstatus", istatus);
-            PyErr_SetObject(IppchError, value);
-            goto free;
-        }
-    	p= pat;
-        numCaptGroups= 0;
-        j= 0;
-		while (j++ < pat_len && *p) {
-			if (*p == '(')
-			numCaptGroups++; p++;
-		}
-		value= PyDict_New();
-		PyDict_SetItemString(value, "pattern", tmpobj);
-		PyDict_SetItemString(value, "groups", \
-			Py_BuildValue("i", numCaptGroups));
-		PyList_SetItem(patternlist, i, value);
-	}
-	PyDict_SetItemString(ireso->attr_dict, "patterns", patternlist);
-	PyDict_SetItemString(ireso->attr_dict, "numpatterns", \
-            Py_BuildValue("i", numpatterns));
-	PyDict_SetItemString(ireso->attr_dict, "statesize", \
-			Py_BuildValue("i", statesize));
-	PyDict_SetItemString(ireso->attr_dict, "ippstatus", \
-			Py_BuildValue("i", istatus));
-
-	return (PyObject*)ireso;
-free:
-	Py_XDECREF(patternlist);
-error:
-	Py_XDECREF(ireso->attr_dict);
-    Py_XDECREF(ireso);
-    return NULL;
+    Py_DECREF(r);
+    if (exc != Py_None)
+        r= PyObject_CallMethod(future, "set_exception", "O", exc);
+    else
+        r= PyObject_CallMethod(future, "set_result", "O", result);
+    return r;
 }
 
+static PyMethodDef CompleteFuture_Def= {
+    "_completeFuture", _completeFuture, METH_VARARGS,
+    "Set result or exception of a future unless it is done"
+};
+
 /**
- * \brief	IppRegExpStateObject method returning state size
- * \return	size of the IppRegExpState! (not IppRegExpStateObject)
+ * \brief	scan job of search_async and searchMulti_async
  */
-static PyObject *
-get_state_size(PyObject *self, PyObject *args)
+typedef struct {
+    IppchJob job;
+    IppRegExpStateObject *o;            /**< strong reference */
+    PyObject *source;                   /**< strong reference */
+    PyObject *loop;                     /**< strong reference */
+    PyObject *future;                   /**< strong reference */
+    IppStatus istatus;
+    int numfind;
+    IppRegExpFind *find;
+    IppRegExpMultiFind *multifind;      /**< NULL for a single search */
+    Ipp64u t0;                          /**< profiler start at submit */
+} IppchScanJob;
+
+static void
+_scanJobRun(IppchJob *job)
 {
-	PyObject *_size;
-	IppRegExpStateObject *o= (IppRegExpStateObject*)self;
-	if (o->ires == NULL) {
-		return Py_BuildValue("i", 0);
-	}
-	_size= PyDict_GetItemString(o->attr_dict, "statesize");
-	if (_size == NULL)
-		return Py_BuildValue("i", 0);
-	/* XXX(haai): borrowed reference?!? */
-	return _size;
+    IppchScanJob *j= (IppchScanJob *)job;
+    const Ipp8u *src= (const Ipp8u *)PyString_AS_STRING(j->source);
+    int len= (int)PyString_GET_SIZE(j->source);
+
+    PyThread_acquire_lock(j->o->lock, 1);
+    if (j->multifind)
+        j->istatus= _multiFindUnlocked(j->o->irems, j->o->numpatterns, \
+                j->o->capacity, src, len, j->multifind);
+    else
+        j->istatus= _findUnlocked(j->o->ires, src, len, j->find, \
+                &j->numfind);
+    PyThread_release_lock(j->o->lock);
+    _profRecord(PROF_ASYNC, j->t0, len);
+}
+
+static void
+_scanJobDone(IppchJob *job)
+{
+    IppchScanJob *j= (IppchScanJob *)job;
+    PyObject *result= NULL, *exc= NULL, *type, *tb, *r;
+
+    if (j->istatus != ippStsNoErr)
+        exc= PyObject_CallFunction(IppchError, "si", \
+                "IppRegExpFind: Error Ipp Status", j->istatus);
+    else if (j->multifind)
+        result= _buildMultiResult(j->o, j->multifind);
+    else
+        result= _buildSearchResult(j->numfind);
+    if (result == NULL && exc == NULL) {
+        PyErr_Fetch(&type, &exc, &tb);
+        PyErr_NormalizeException(&type, &exc, &tb);
+        Py_XDECREF(type);
+        Py_XDECREF(tb);
+    }
+    r= PyObject_CallMethod(j->loop, "call_soon_threadsafe", "OOOO", \
+            complete_future, j->future, \
+            result ? result : Py_None, exc ? exc : Py_None);
+    if (r == NULL)
+        PyErr_WriteUnraisable(j->loop);
+    Py_XDECREF(r);
+    Py_XDECREF(result);
+    Py_XDECREF(exc);
+    Py_DECREF(j->o);
+    Py_DECREF(j->source);
+    Py_DECREF(j->loop);
+    Py_DECREF(j->future);
+    free(j->find);
+    free(j->multifind);
+    PyMem_Free(j);
 }
 
 /**
- * \brief	search string with given multi regexp database
- * \return	
+ * \brief	create a future on loop (default: the current event loop)
+ * \return	new reference to the future, loop is replaced by a new reference
  */
 static PyObject *
-searchMulti(PyObject *self, PyObject *args)
+_newFuture(PyObject **loop)
 {
-    PyObject *retval, *result, *source, *value, *tmp, *patterns, *pat;
-    char *src;
-    Py_ssize_t src_len;
-    int iNumFind= 1, numMultiFind, i;
-    IppStatus istatus= -1;
-	IppRegExpMultiFind *iMultiFind, *p_iremf;
-    IppRegExpStateObject *o;
-    
-    o= (IppRegExpStateObject*)self;
-    if  (o->irems == NULL) {
-        PyErr_SetString(IppchError, "No IppRegExpMultiState was created.");
-        goto error;
-    }
-    if (!PyArg_ParseTuple(args, "O", &source))
-        goto error;
-    if (!PyString_Check(source)) {
-        PyErr_SetString(PyExc_TypeError, "wrong argument type");
-        goto error;
-    }
-    PyString_AsStringAndSize(source, &src, &src_len);
-
-    tmp= PyDict_GetItemString(o->attr_dict, "numpatterns");
-    numMultiFind= PyInt_AsLong(tmp);
-    /*!!!*/
-	iMultiFind= PyMem_Malloc(sizeof(IppRegExpMultiFind) * numMultiFind);
-    if (iMultiFind == NULL) {
-        PyErr_SetString(PyExc_MemoryError, "No Mem could be allocated");
-        goto error;
-    }
-    patterns= PyDict_GetItemString(o->attr_dict, "patterns"); /*list*/
-    Py_INCREF(patterns);
-    for (i= 0; i < numMultiFind; ++i) {
-        p_iremf= iMultiFind + i;
-        pat= PyList_GetItem(patterns, i); /*dict*/
-        tmp= PyDict_GetItemString(pat, "groups");
-        iNumFind= PyLong_AsLong(tmp);
-        ++iNumFind; /* !important! though groups can be 0 !!! */
-        p_iremf->pFind= \
-            (IppRegExpFind*)PyMem_Malloc(sizeof(IppRegExpFind) * (iNumFind));
-        if (p_iremf->pFind == NULL) {
-            Py_DECREF(patterns);
-            goto free;
-        }
-        p_iremf->numMultiFind= iNumFind;
-    }
-    Py_DECREF(patterns);
-    istatus= ippsRegExpMultiFind_8u((const Ipp8u*)src, (int)src_len, \
-			iMultiFind, o->irems);
-    if (istatus != ippStsNoErr) {
-        value= Py_BuildValue("si", "IppRegExpMultiFind: Error Ipp Status", \
-                istatus);
-        PyErr_SetObject(IppchError, value);
-        goto cleanup;
-    }
-    retval= PyList_New(numMultiFind);
-    for (i= 0; i < numMultiFind; ++i) {
-        p_iremf= iMultiFind + i;
-        if (p_iremf->status == ippStsNoErr) {
-            /* No Error and something is found! */
-            if (p_iremf->numMultiFind > 0) {
-                result= PyDict_New();
-                PyDict_SetItemString(result, "numfind", \
-                        Py_BuildValue("i", p_iremf->numMultiFind));
-                PyList_SetItem(retval, i, \
-                        Py_BuildValue("{sisisisO}", \
-                        "patternid", p_iremf->regexpID, \
-                        "ippstatus", p_iremf->status, \
-                        "done", p_iremf->regexpDoneFlag, \
-                        "result", result));
-            }
-            /* No Error but nothing found! */
-            else {
-                PyList_SetItem(retval, i, \
-                        Py_BuildValue("{sisisisO}", \
-                        "patternid", p_iremf->regexpID, \
-                        "ippstatus", p_iremf->status, \
-                        "done", p_iremf->regexpDoneFlag, \
-                        "result", Py_None));
-            }
-        }
-        else {
-            /* Error occoured! */
-            PyList_SetItem(retval, i, \
-                    Py_BuildValue("{sisisi}", \
-                    "patternid", p_iremf->regexpID, \
-                    "ipperror", p_iremf->status, \
-                    "done", p_iremf->regexpDoneFlag));
+    if (asyncio_module == NULL) {
+        asyncio_module= PyImport_ImportModule("asyncio");
+        if (asyncio_module == NULL) {
+            PyErr_Clear();
+            asyncio_module= PyImport_ImportModule("trollius");
+            if (asyncio_module == NULL)
+                return NULL;
         }
     }
-	for (i= 0; i < numMultiFind; ++i) {
-		p_iremf= iMultiFind + i;
-		if (p_iremf->pFind) PyMem_Free(p_iremf->pFind);
-	}
-    PyMem_Free(iMultiFind);
-    return retval;
-cleanup:
-	for (i= 0; i < numMultiFind; ++i) {
-		p_iremf= iMultiFind + i;
-		if (p_iremf->pFind) PyMem_Free(p_iremf->pFind);
-	}
-free:
-    PyMem_Free(iMultiFind);
-error:
-    return NULL;
+    if (*loop == NULL || *loop == Py_None)
+        *loop= PyObject_CallMethod(asyncio_module, "get_event_loop", NULL);
+    else
+        Py_INCREF(*loop);
+    if (*loop == NULL)
+        return NULL;
+    if (PyObject_HasAttrString(*loop, "create_future"))
+        return PyObject_CallMethod(*loop, "create_future", NULL);
+    return PyObject_CallMethod(asyncio_module, "Future", "()");
 }
 
 /**
- * \brief	search string with given regexp
- * \return	
+ * \brief	submit a scan of source to the worker pool
+ * \return	future completed with the search/searchMulti result
  */
 static PyObject *
-search(PyObject *self, PyObject *args)
+_submitScan(IppRegExpStateObject *o, PyObject *args, PyObject *kwds, \
+        int multi)
 {
-    PyObject *retval, *source, *numFind, *value;
-    IppStatus istatus= -1;
-    char *src;
-    Py_ssize_t src_len;
-    int iNumFind= 1;
-    IppRegExpFind *iFind;
-    IppRegExpStateObject *o;
-    
-    o= (IppRegExpStateObject*)self;
-    if  (o->ires == NULL) {
-        PyErr_SetString(IppchError, "no IppRegExpState was created.");
-        goto error;
-    }
-    if (!PyArg_ParseTuple(args, "O", &source))
-        goto error;
+    static char *kwlist[]= {"source", "loop", NULL};
+    PyObject *source, *loop= NULL, *future;
+    IppchScanJob *j;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|O", kwlist, \
+                &source, &loop))
+        return NULL;
+    if (_ensureState(o, multi) < 0)
+        return NULL;
     if (!PyString_Check(source)) {
         PyErr_SetString(PyExc_TypeError, "wrong argument type");
-        goto error;
+        return NULL;
     }
-    PyString_AsStringAndSize(source, &src, &src_len);
-    numFind= PyDict_GetItemString(o->attr_dict, "groups");
-    if (numFind == NULL) {
-        PyErr_SetString(PyExc_KeyError, "key 'groups' not found");
-        goto error;
+    future= _newFuture(&loop);
+    if (future == NULL) {
+        Py_XDECREF(loop);
+        return NULL;
     }
-    iNumFind+= PyInt_AsLong(numFind);
-    if (iNumFind == -1) {
-        if (PyErr_Occurred()) {
-            goto error;
-        }
+    j= PyMem_Malloc(sizeof(IppchScanJob));
+    if (j == NULL)
+        goto nomem;
+    memset(j, 0, sizeof(IppchScanJob));
+    j->job.run= _scanJobRun;
+    j->job.done= _scanJobDone;
+    if (multi) {
+        j->multifind= _newMultiFind(o->numpatterns, o->capacity);
+        if (j->multifind == NULL)
+            goto nomem;
     }
-    iFind= (IppRegExpFind*)PyMem_Malloc(sizeof(IppRegExpFind) * iNumFind);
-    if (iFind == NULL) {
-        goto error;
+    else {
+        j->numfind= o->numgroups + 1;
+        j->find= malloc(sizeof(IppRegExpFind) * j->numfind);
+        if (j->find == NULL)
+            goto nomem;
     }
-    istatus= ippsRegExpFind_8u((const Ipp8u*)src, (int)src_len, \
-			o->ires, iFind, &iNumFind);
-    if (istatus != ippStsNoErr) {
-        value= Py_BuildValue("si", "IppRegExpFind: Error Ipp Status", istatus);
-        PyErr_SetObject(IppchError, value);
-        goto free;
+    Py_INCREF(o);
+    Py_INCREF(source);
+    Py_INCREF(future);
+    j->o= o;
+    j->source= source;
+    j->loop= loop;
+    j->future= future;
+    j->t0= _profStart();
+    if (_poolSubmit(&j->job) < 0) {
+        /* the job owns loop and one future reference */
+        Py_DECREF(o);
+        Py_DECREF(source);
+        Py_DECREF(future);
+        free(j->find);
+        free(j->multifind);
+        PyMem_Free(j);
+        goto error;
     }
-    PyMem_Free(iFind);
-    if (iNumFind > 0) {
-        retval= Py_BuildValue("{sisi}", \
-                "numfind", iNumFind, \
-                "ippstatus", istatus);
-        return retval;
+    return future;
+nomem:
+    if (j) {
+        free(j->find);
+        free(j->multifind);
+        PyMem_Free(j);
     }
-    Py_RETURN_NONE;
-    /*FIXME(haai): should return none again if no match (temp edited)
-    else {
-        retval= Py_BuildValue("{sisi}", \
-                "found", Py_False,
-                "ippstatus", istatus);
-        return retval;
-    }*/
-free:
-    PyMem_Free(iFind);
+    PyErr_NoMemory();
 error:
+    Py_DECREF(loop);
+    Py_DECREF(future);
     return NULL;
 }
 
+/**
+ * \brief	search on the worker pool
+ * \return	awaitable future resolving to the search() result
+ */
+static PyObject *
+search_async(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    return _submitScan((IppRegExpStateObject *)self, args, kwds, 0);
+}
+
+/**
+ * \brief	searchMulti on the worker pool
+ * \return	awaitable future resolving to the searchMulti() result
+ */
+static PyObject *
+searchMulti_async(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    return _submitScan((IppRegExpStateObject *)self, args, kwds, 1);
+}
+
 static PyObject *
 setMatchLimit(PyObject *self, PyObject *args)
 {
@@ -523,33 +5984,74 @@ setMatchLimit(PyObject *self, PyObject *args)
     if (!PyArg_ParseTuple(args, "I", &ilimit))
         goto error;
     o= (IppRegExpStateObject *)self;
-	if (o->ires == NULL) {
-		PyErr_SetString(IppchError, "No IppRegExpState compiled");
+	if (_ensureState(o, 0) < 0)
 		goto error;
-	}
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(o->lock, 1);
     istatus= ippsRegExpSetMatchLimit(ilimit, o->ires);
+    PyThread_release_lock(o->lock);
+    Py_END_ALLOW_THREADS
     if (istatus != ippStsNoErr) {
         value= Py_BuildValue("si",
                 "ippsRegExpSetMatchLimit: Error Ipp Status:", istatus);
         PyErr_SetObject(PyExc_SystemError, value);
+        Py_XDECREF(value);
     }
     return Py_BuildValue("i", (int)istatus);
 error:
     return NULL;
 }
 
+/**
+ * \brief	IppRegExpStateObject Getters, the rest lives in attr_dict
+ */
+static PyGetSetDef IppRegExpStateObject_GetSet[]= {
+    {"patterns", _getattr_patterns, NULL,
+        "entries of a compileMulti object", NULL},
+	{NULL} /* Sentinel */
+};
+
 /**
  * \brief	IppRegExpStateObject Methods
  */
 static PyMethodDef IppRegExpStateObject_Methods[]= {
 	{"getStateSize", get_state_size, METH_VARARGS,
 		"Get the actual IppRegExpState size"},
-    {"search", search, METH_VARARGS,
+    {"isCompiled", is_compiled, METH_NOARGS,
+        "False while a lazy object is not compiled yet"},
+    {"measureDedup", measure_dedup, METH_VARARGS,
+        "measureDedup(sample, repeat=5) time the scan with and without dedup"},
+    {"saveManifest", save_manifest, METH_VARARGS,
+        "saveManifest(path) write the analysed rule set for _loadManifest"},
+    {"search", search, METH_O,
         "Looks for occurences of the substring matching the specified regexp"},
-	{"searchMulti", searchMulti, METH_VARARGS,
+    {"match", match, METH_O,
+        "Match the regexp at the beginning of the string"},
+    {"fullmatch", fullmatch, METH_O,
+        "Match the regexp against the whole string"},
+    {"split", (PyCFunction)split, METH_VARARGS|METH_KEYWORDS,
+        "split(source, maxsplit=0, offsets=0) memoryview slices or (start, end) pairs"},
+    {"isplit", (PyCFunction)isplit, METH_VARARGS|METH_KEYWORDS,
+        "Iterator version of split()"},
+    {"extract", (PyCFunction)extract, METH_VARARGS|METH_KEYWORDS,
+        "extract(sources, spans=0) {group: column} over a list of strings"},
+    {"extractPacked", (PyCFunction)extractPacked, METH_VARARGS|METH_KEYWORDS,
+        "extractPacked(data, offsets, spans=0) {group: column} over packed sources"},
+	{"searchMulti", searchMulti, METH_O,
 		"Looks for occurences of the substrings matching the specified regexes"},
     {"setMatchLimit", setMatchLimit, METH_VARARGS,
         "Set the value of the Match Stack Limit"},
+    {"search_async", (PyCFunction)search_async, METH_VARARGS|METH_KEYWORDS,
+        "search() on the worker pool, returns an asyncio future"},
+    {"searchMulti_async", (PyCFunction)searchMulti_async,
+        METH_VARARGS|METH_KEYWORDS,
+        "searchMulti() on the worker pool, returns an asyncio future"},
+    {"searchMultiBatchInto", (PyCFunction)searchMultiBatchInto,
+        METH_VARARGS|METH_KEYWORDS,
+        "searchMulti() over a list into int32 id/start/end/input buffers"},
+    {"searchMultiPackedInto", (PyCFunction)searchMultiPackedInto,
+        METH_VARARGS|METH_KEYWORDS,
+        "searchMulti() over data+offsets into int32 id/start/end/input buffers"},
 	{NULL, NULL, 0, NULL} /* Sentinel */
 };
 
@@ -587,7 +6089,7 @@ static PyTypeObject IppRegExpStateObject_Type= {
     0,                              /**< tp_iternext */
     IppRegExpStateObject_Methods,   /**< tp_methods */
     0,                              /**< tp_members */
-    0,                              /**< tp_getset */
+    IppRegExpStateObject_GetSet,    /**< tp_getset */
     0,                              /**< tp_base */
     0,                              /**< tp_dict */
     0,                              /**< tp_descr_get */
@@ -616,10 +6118,13 @@ _compile(PyObject *self, PyObject *args)
 {
 	PyObject *pattern;
     PyObject *flags;
+    int shared= 0, lazy= 0, priority= 0;
 
-	if (!PyArg_ParseTuple(args, "OO", &pattern, &flags))
+	if (!PyArg_ParseTuple(args, "OO|iii", &pattern, &flags, &shared, &lazy, \
+                &priority))
 		goto error;
-    return _create_IppRegExpStateObject(pattern, flags);
+    return _create_IppRegExpStateObject(pattern, flags, shared, lazy, \
+            priority);
 error:
 	return NULL;
 }
@@ -633,10 +6138,13 @@ _compileMulti(PyObject *self, PyObject *args)
 {
 	PyObject *patterns;
     PyObject *flags;
+    int shared= 0, dedup= 1, lazy= 0, priority= 0;
 
-	if (!PyArg_ParseTuple(args, "OO", &patterns, &flags))
+	if (!PyArg_ParseTuple(args, "OO|iiii", &patterns, &flags, &shared, \
+                &dedup, &lazy, &priority))
 		goto error;
-    return _create_IppRegExpMultiStateObject(patterns, flags);
+    return _create_IppRegExpMultiStateObject(patterns, flags, shared, dedup, \
+            lazy, priority);
 error:
 	return NULL;
 }
@@ -651,14 +6159,23 @@ _setMatchLimit(PyObject *self, PyObject *args)
 
     if (!PyArg_ParseTuple(args, "OI", &o, &ilimit))
         goto error;
+    if (!PyObject_TypeCheck(o, &IppRegExpStateObject_Type)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type");
+        goto error;
+    }
     ireso= (IppRegExpStateObject *)o;
-	if (ireso->ires == NULL)
+	if (_ensureState(ireso, 0) < 0)
 		goto error;
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(ireso->lock, 1);
     istatus= ippsRegExpSetMatchLimit(ilimit, ireso->ires);
+    PyThread_release_lock(ireso->lock);
+    Py_END_ALLOW_THREADS
     if (istatus != ippStsNoErr) {
         value= Py_BuildValue("si",
                 "ippsRegExpSetMatchLimit: Error Ipp Status:", istatus);
         PyErr_SetObject(PyExc_SystemError, value);
+        Py_XDECREF(value);
     	goto error;
 	}
     return Py_BuildValue("i", (int)istatus);
@@ -666,6 +6183,294 @@ error:
 	return NULL;
 }
 
+/**
+ * \brief	configures the native worker pool
+ *
+ * Running workers finish the queued jobs and are restarted with the
+ * new size on the next submit.
+ */
+static PyObject *
+_setWorkerPool(PyObject *self, PyObject *args)
+{
+    int numthreads, maxqueue= POOL_MAXQUEUE;
+
+    if (!PyArg_ParseTuple(args, "i|i", &numthreads, &maxqueue))
+        goto error;
+    if (numthreads < 0 || maxqueue < 1) {
+        PyErr_SetString(PyExc_ValueError, "invalid worker pool size");
+        goto error;
+    }
+    _poolStop();
+    pthread_mutex_lock(&Pool.mutex);
+    Pool.numthreads= numthreads;
+    Pool.maxqueue= maxqueue;
+    pthread_mutex_unlock(&Pool.mutex);
+    Py_RETURN_NONE;
+error:
+    return NULL;
+}
+
+/**
+ * \brief	returns the worker pool configuration and load
+ */
+static PyObject *
+_getWorkerPool(PyObject *self, PyObject *args)
+{
+    PyObject *retval;
+
+    pthread_mutex_lock(&Pool.mutex);
+    retval= Py_BuildValue("{sisisisisi}",
+            "numthreads", Pool.numthreads,
+            "started", Pool.started,
+            "maxqueue", Pool.maxqueue,
+            "queued", Pool.queued,
+            "running", Pool.running);
+    pthread_mutex_unlock(&Pool.mutex);
+    return retval;
+}
+/**
+ * \brief	warmup job compiling lazy objects on the worker pool
+ */
+typedef struct {
+    IppchJob job;
+    Py_ssize_t n;
+    IppRegExpStateObject *objects[1];   /**< [n] strong references */
+} IppchWarmupJob;
+
+static void
+_warmupJobRun(IppchJob *job)
+{
+    IppchWarmupJob *j= (IppchWarmupJob *)job;
+    Py_ssize_t i;
+
+    for (i= 0; i < j->n; ++i) {
+        PyThread_acquire_lock(j->objects[i]->lock, 1);
+        _lazyBuild(j->objects[i]);
+        PyThread_release_lock(j->objects[i]->lock);
+    }
+}
+
+static void
+_warmupJobDone(IppchJob *job)
+{
+    IppchWarmupJob *j= (IppchWarmupJob *)job;
+    Py_ssize_t i;
+
+    for (i= 0; i < j->n; ++i)
+        Py_DECREF(j->objects[i]);
+    PyMem_Free(j);
+}
+
+/**
+ * \brief	queue pending lazy objects for compiling on the worker pool
+ * \return	number of objects queued
+ *
+ * The objects are dealt round robin into at most WARMUP_JOBS jobs, so
+ * a large rule set takes a few queue slots and the first objects of
+ * the sequence are compiled first on every worker. A job that does not
+ * fit into the queue is dropped, its objects are compiled on first
+ * use. Objects that are compiled or already failed are skipped, a
+ * failure is raised on the next use of the object.
+ */
+static PyObject *
+_warmup(PyObject *self, PyObject *objects)
+{
+    PyObject *seq, *item;
+    Py_ssize_t i, k, n, pending= 0, numjobs, queued= 0;
+    IppchWarmupJob **jobs= NULL;
+
+    seq= PySequence_Fast(objects, "warmup expects a sequence");
+    if (seq == NULL)
+        return NULL;
+    n= PySequence_Fast_GET_SIZE(seq);
+    for (i= 0; i < n; ++i) {
+        item= PySequence_Fast_GET_ITEM(seq, i);
+        if (!PyObject_TypeCheck(item, &IppRegExpStateObject_Type)) {
+            PyErr_SetString(PyExc_TypeError, "wrong argument type");
+            goto error;
+        }
+        if (__atomic_load_n(&((IppRegExpStateObject *)item)->lazy, \
+                    __ATOMIC_ACQUIRE) == LAZY_PENDING)
+            pending++;
+    }
+    numjobs= pending < WARMUP_JOBS ? pending : WARMUP_JOBS;
+    if (numjobs == 0)
+        goto done;
+    jobs= PyMem_New(IppchWarmupJob *, numjobs);
+    if (jobs == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    memset(jobs, 0, sizeof(IppchWarmupJob *) * numjobs);
+    for (k= 0; k < numjobs; ++k) {
+        jobs[k]= PyMem_Malloc(sizeof(IppchWarmupJob) + sizeof(PyObject *) \
+                * (pending / numjobs + 1));
+        if (jobs[k] == NULL) {
+            PyErr_NoMemory();
+            goto error;
+        }
+        jobs[k]->job.run= _warmupJobRun;
+        jobs[k]->job.done= _warmupJobDone;
+        jobs[k]->n= 0;
+    }
+    for (i= 0, k= 0; i < n; ++i) {
+        item= PySequence_Fast_GET_ITEM(seq, i);
+        if (__atomic_load_n(&((IppRegExpStateObject *)item)->lazy, \
+                    __ATOMIC_ACQUIRE) != LAZY_PENDING)
+            continue;
+        Py_INCREF(item);
+        jobs[k]->objects[jobs[k]->n++]= (IppRegExpStateObject *)item;
+        k= (k + 1) % numjobs;
+    }
+    for (k= 0; k < numjobs; ++k) {
+        i= jobs[k]->n;
+        if (_poolSubmit(&jobs[k]->job) < 0) {
+            if (!PyErr_ExceptionMatches(IppchQueueFull))
+                goto error;
+            PyErr_Clear();
+            continue;
+        }
+        jobs[k]= NULL;
+        queued+= i;
+    }
+    /* jobs left over did not fit into the queue */
+    for (k= 0; k < numjobs; ++k)
+        if (jobs[k])
+            _warmupJobDone(&jobs[k]->job);
+    PyMem_Free(jobs);
+done:
+    Py_DECREF(seq);
+    return PyInt_FromSsize_t(queued);
+error:
+    for (k= 0; jobs && k < numjobs; ++k)
+        if (jobs[k])
+            _warmupJobDone(&jobs[k]->job);
+    PyMem_Free(jobs);
+    Py_DECREF(seq);
+    return NULL;
+}
+
+/**
+ * \brief	waits for queued jobs and stops the worker pool
+ */
+static PyObject *
+_stopWorkerPool(PyObject *self, PyObject *args)
+{
+    _poolStop();
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	C API: borrow the states of an IppRegExpStateObject
+ * \return	0 on success, -1 with exception set
+ */
+static int
+capi_Borrow(PyObject *obj, PyIppch_StateView *view)
+{
+    IppRegExpStateObject *o;
+
+    if (!PyObject_TypeCheck(obj, &IppRegExpStateObject_Type)) {
+        PyErr_SetString(PyExc_TypeError, "wrong argument type");
+        return -1;
+    }
+    o= (IppRegExpStateObject *)obj;
+    if (o->lock == NULL) {
+        PyErr_SetString(IppchError, "No IppRegExpState compiled");
+        return -1;
+    }
+    if (_ensureState(o, o->entrystate != NULL) < 0)
+        return -1;
+    Py_INCREF(obj);
+    view->owner= obj;
+    view->ires= o->ires;
+    view->irems= o->irems;
+    view->numgroups= o->numgroups;
+    view->numpatterns= o->numpatterns;
+    view->capacity= o->capacity;
+    view->lock= o->lock;
+    view->numentries= o->numentries;
+    view->ownerstart= o->ownerstart;
+    view->ownerids= o->ownerids;
+    return 0;
+}
+
+/**
+ * \brief	C API: release a view filled by capi_Borrow
+ */
+static void
+capi_Release(PyIppch_StateView *view)
+{
+    Py_CLEAR(view->owner);
+    view->ires= NULL;
+    view->irems= NULL;
+    view->lock= NULL;
+    view->ownerstart= NULL;
+    view->ownerids= NULL;
+}
+
+/**
+ * \brief	C API: single find on a borrowed view
+ */
+static IppStatus
+capi_Find(PyIppch_StateView *view, const Ipp8u *src, int len, \
+        IppRegExpFind *find, int *numfind)
+{
+    IppStatus istatus;
+
+    PyThread_acquire_lock(view->lock, 1);
+    istatus= _findUnlocked(view->ires, src, len, find, numfind);
+    PyThread_release_lock(view->lock);
+    return istatus;
+}
+
+/**
+ * \brief	C API: multi find on a borrowed view
+ */
+static IppStatus
+capi_MultiFind(PyIppch_StateView *view, const Ipp8u *src, int len, \
+        IppRegExpMultiFind *multifind)
+{
+    IppStatus istatus;
+
+    PyThread_acquire_lock(view->lock, 1);
+    istatus= _multiFindUnlocked(view->irems, view->numpatterns, \
+            view->capacity, src, len, multifind);
+    PyThread_release_lock(view->lock);
+    return istatus;
+}
+
+/**
+ * \brief	C API: allocate multi find entries sized for a view
+ */
+static IppRegExpMultiFind *
+capi_MultiFindAlloc(PyIppch_StateView *view)
+{
+    return _newMultiFind(view->numpatterns, view->capacity);
+}
+
+/**
+ * \brief	C API: free multi find entries
+ */
+static void
+capi_MultiFindFree(IppRegExpMultiFind *multifind)
+{
+    free(multifind);
+}
+
+/**
+ * \brief	function table exported as PYIPP_IPPCH_CAPSULE_NAME
+ */
+static PyIppch_CAPI Ippch_CAPI= {
+    PYIPP_IPPCH_CAPI_VERSION,
+    sizeof(PyIppch_CAPI),
+    capi_Borrow,
+    capi_Release,
+    capi_Find,
+    capi_MultiFind,
+    capi_MultiFindAlloc,
+    capi_MultiFindFree,
+};
+
 /**
  * \brief	holds the methods for the module
  */
@@ -674,8 +6479,61 @@ static PyMethodDef Module_Methods[]= {
         "Compile a RegExp Pattern to internal Structure"},
 	{"_compileMulti", _compileMulti, METH_VARARGS,
 		"Compile a Multi RegExp Pattern Structure"},
+    {"_pipeline", _pipeline, METH_VARARGS,
+        "_pipeline(state, steps) fuse normalization steps with a compiled state"},
+    {"_keywords", _keywords, METH_VARARGS,
+        "_keywords(keywords, icase=0) Aho-Corasick index of literal keywords"},
+    {"_loadManifest", _loadManifest, METH_VARARGS,
+        "_loadManifest(path, patterns, flags, dedup=1, shared=0, lazy=0, priority=0) object or None"},
     {"_setMatchLimit", _setMatchLimit, METH_VARARGS,
         "Set the value of the Match Stack"},
+    {"_setWorkerPool", _setWorkerPool, METH_VARARGS,
+        "Set number of worker threads (0: cores) and queue bound"},
+    {"_getWorkerPool", _getWorkerPool, METH_NOARGS,
+        "Get the worker pool configuration and load"},
+    {"_stopWorkerPool", _stopWorkerPool, METH_NOARGS,
+        "Wait for queued jobs and stop the worker threads"},
+    {"_warmup", _warmup, METH_O,
+        "Compile pending lazy objects on the worker pool, in sequence order"},
+    {"_hashBatch", (PyCFunction)_hashBatch, METH_VARARGS|METH_KEYWORDS,
+        "_hashBatch(sources, kind='crc32c', seed=0, out=None) uint32 hash per string"},
+    {"_hashPacked", (PyCFunction)_hashPacked, METH_VARARGS|METH_KEYWORDS,
+        "_hashPacked(data, offsets, kind='crc32c', seed=0, out=None) uint32 hash per source"},
+    {"_strFind", (PyCFunction)_strFind, METH_VARARGS|METH_KEYWORDS,
+        "_strFind(src, sub, start=0, icase=0) index of sub or -1"},
+    {"_strRFind", _strRFind, METH_VARARGS,
+        "_strRFind(src, sub) index of the last sub or -1"},
+    {"_strFindAny", _strFindAny, METH_VARARGS,
+        "_strFindAny(src, chars, start=0) index of the first of chars or -1"},
+    {"_strCompare", (PyCFunction)_strCompare, METH_VARARGS|METH_KEYWORDS,
+        "_strCompare(a, b, icase=0) -1, 0 or 1"},
+    {"_strUpper", _strUpper, METH_VARARGS,
+        "_strUpper(src, dst=None) latin uppercase, in place if dst is src"},
+    {"_strLower", _strLower, METH_VARARGS,
+        "_strLower(src, dst=None) latin lowercase, in place if dst is src"},
+    {"_strReplaceC", _strReplaceC, METH_VARARGS,
+        "_strReplaceC(src, old, new, dst=None) replace a byte"},
+    {"_strTrim", _strTrim, METH_VARARGS,
+        "_strTrim(src, chars=whitespace) strip chars from both ends"},
+    {"_strFindBatch", (PyCFunction)_strFindBatch, METH_VARARGS|METH_KEYWORDS,
+        "_strFindBatch(sources, sub, icase=0, out=None) int32 index per string"},
+    {"_strFindPacked", (PyCFunction)_strFindPacked,
+        METH_VARARGS|METH_KEYWORDS,
+        "_strFindPacked(data, offsets, sub, icase=0, out=None) int32 index per source"},
+    {"_strCompareBatch", (PyCFunction)_strCompareBatch,
+        METH_VARARGS|METH_KEYWORDS,
+        "_strCompareBatch(sources, sub, icase=0, out=None) int32 -1/0/1 per string"},
+    {"_strComparePacked", (PyCFunction)_strComparePacked,
+        METH_VARARGS|METH_KEYWORDS,
+        "_strComparePacked(data, offsets, sub, icase=0, out=None) int32 -1/0/1 per source"},
+    {"_profEnable", _profEnable, METH_VARARGS,
+        "Enable/disable the native scan timers, optionally with a trace ring"},
+    {"_profReset", _profReset, METH_NOARGS,
+        "Clear the native scan timers and the trace ring"},
+    {"_profStats", _profStats, METH_NOARGS,
+        "Get count, mean, p50, p99, p999 and max in ns of the scan timers"},
+    {"_profDump", _profDump, METH_VARARGS,
+        "Write the trace ring to a file, returns the number of records"},
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
@@ -685,20 +6543,53 @@ static PyMethodDef Module_Methods[]= {
 PyMODINIT_FUNC
 init_ippch(void)
 {
-	PyObject *m;
+	PyObject *m, *capi;
     
     IppRegExpStateObject_Type.tp_new= PyType_GenericNew;
 	if (PyType_Ready(&IppRegExpStateObject_Type) < 0)
 		return;
+	if (PyType_Ready(&IppchSplitObject_Type) < 0)
+		return;
+	if (PyType_Ready(&IppchPipelineObject_Type) < 0)
+		return;
+	if (PyType_Ready(&IppchKeywordsObject_Type) < 0)
+		return;
 	m= Py_InitModule("_ippch", Module_Methods);
 	if (m == NULL)
 		return;
 	Py_INCREF(&IppRegExpStateObject_Type);
 	PyModule_AddObject(m, "IppRegExpStateObject", 
 			(PyObject*)&IppRegExpStateObject_Type);
+	s_numfind= PyString_InternFromString("numfind");
+	s_ippstatus= PyString_InternFromString("ippstatus");
+	s_ipperror= PyString_InternFromString("ipperror");
+	s_patternid= PyString_InternFromString("patternid");
+	s_done= PyString_InternFromString("done");
+	s_result= PyString_InternFromString("result");
+	s_numpatterns= PyString_InternFromString("numpatterns");
+	s_statesize= PyString_InternFromString("statesize");
+	s_shared= PyString_InternFromString("shared");
+	if (!s_numfind || !s_ippstatus || !s_ipperror || !s_patternid
+			|| !s_done || !s_result || !s_numpatterns || !s_statesize
+			|| !s_shared)
+		return;
 	IppchError= PyErr_NewException("_ippch.error", NULL, NULL);
 	Py_INCREF(IppchError);
 	PyModule_AddObject(m, "_IppchError", IppchError);
+	IppchQueueFull= PyErr_NewException("_ippch.queuefull", IppchError, NULL);
+	if (IppchQueueFull == NULL)
+		return;
+	Py_INCREF(IppchQueueFull);
+	PyModule_AddObject(m, "_IppchQueueFull", IppchQueueFull);
+	capi= PyCapsule_New(&Ippch_CAPI, PYIPP_IPPCH_CAPSULE_NAME, NULL);
+	if (capi == NULL)
+		return;
+	PyModule_AddObject(m, "_C_API", capi);
+	PyModule_AddIntConstant(m, "_C_API_VERSION", PYIPP_IPPCH_CAPI_VERSION);
+	complete_future= PyCFunction_New(&CompleteFuture_Def, NULL);
+	if (complete_future == NULL)
+		return;
+	pthread_atfork(NULL, NULL, _poolAtForkChild);
 
     ippInit();
 
@@ -8,12 +8,17 @@
  */
 #include <Python.h>
 #include <structmember.h>
+#include <pythread.h>
 #include <ipp.h>
 #include <string.h>
+#include <limits.h>
 #ifdef DEBUG_IPP
 #include <assert.h>
 #endif
 
+#define NOGIL_THRESHOLD 4096    /**< \def elements processed without GIL */
+#define DFT_CACHE_SIZE  16      /**< \def transforms kept by _dft */
+
 static PyObject *IppsError;
 /**
  * \brief	returns information about the active version of Intel IPP signal processing software
@@ -34,12 +39,1868 @@ _getLibVersion(PyObject *self, PyObject *args)
 			ilv->build);
 }
 
+/**
+ * \brief	element types of vectors
+ */
+enum {
+    T_16S= 0,                           /**< int16, format 'h' */
+    T_32F,                              /**< float32, format 'f' */
+    T_64F                               /**< float64, format 'd' */
+};
+
+/**
+ * \brief	contiguous vector obtained through the buffer protocol
+ */
+typedef struct {
+    Py_buffer view;
+    int type;                           /**< T_* */
+    int len;                            /**< number of elements */
+} IppsVector;
+
+/**
+ * \brief	get a contiguous int16/float32/float64 view on obj
+ * \return	0 on success, -1 with exception set
+ */
+static int
+_getVector(PyObject *obj, IppsVector *v, int writable)
+{
+    int flags= PyBUF_C_CONTIGUOUS|PyBUF_FORMAT;
+    const char *f;
+    Py_ssize_t n;
+
+    if (writable)
+        flags|= PyBUF_WRITABLE;
+    if (PyObject_GetBuffer(obj, &v->view, flags) < 0)
+        return -1;
+    f= v->view.format ? v->view.format : "B";
+    if (*f == '@' || *f == '=' || *f == '<')
+        f++;
+    if (*f == 'h' && v->view.itemsize == 2)
+        v->type= T_16S;
+    else if (*f == 'f' && v->view.itemsize == 4)
+        v->type= T_32F;
+    else if (*f == 'd' && v->view.itemsize == 8)
+        v->type= T_64F;
+    else {
+        PyBuffer_Release(&v->view);
+        PyErr_SetString(PyExc_TypeError, \
+                "int16, float32 or float64 buffer expected");
+        return -1;
+    }
+    n= v->view.len / v->view.itemsize;
+    if (n > INT_MAX) {
+        PyBuffer_Release(&v->view);
+        PyErr_SetString(PyExc_ValueError, "vector too long");
+        return -1;
+    }
+    v->len= (int)n;
+    return 0;
+}
+
+/**
+ * \brief	check that two vectors have the same type and length
+ * \return	0 if they match, -1 with exception set
+ */
+static int
+_checkVectors(const IppsVector *a, const IppsVector *b)
+{
+    if (a->type != b->type) {
+        PyErr_SetString(PyExc_TypeError, "vectors of different types");
+        return -1;
+    }
+    if (a->len != b->len) {
+        PyErr_SetString(PyExc_ValueError, "vectors of different lengths");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * \brief	raise IppsError for an ipp error status (warnings pass)
+ * \return	0 or -1 with exception set
+ */
+static int
+_checkStatus(const char *fn, IppStatus istatus)
+{
+    PyObject *value;
+
+    if (istatus >= ippStsNoErr)
+        return 0;
+    value= Py_BuildValue("sis", fn, istatus, ippGetStatusString(istatus));
+    PyErr_SetObject(IppsError, value);
+    Py_XDECREF(value);
+    return -1;
+}
+
+/**
+ * \def	NOGIL_BEGIN
+ * \brief	release the GIL for vectors of at least NOGIL_THRESHOLD elements
+ */
+#define NOGIL_BEGIN(len) { \
+    PyThreadState *_save= NULL; \
+    if ((len) >= NOGIL_THRESHOLD) _save= PyEval_SaveThread();
+#define NOGIL_END \
+    if (_save) PyEval_RestoreThread(_save); }
+
+enum { OP_ADD= 0, OP_SUB, OP_MUL };
+static const char *op_names[]= { "ippsAdd", "ippsSub", "ippsMul" };
+
+/**
+ * \brief	d= a op b
+ *
+ * Note that ippsSub computes pSrc2 - pSrc1, the operands are swapped here.
+ */
+static IppStatus
+_binary(int op, int type, const void *a, const void *b, void *d, int len)
+{
+    switch (op * 3 + type) {
+        case OP_ADD * 3 + T_16S: return ippsAdd_16s(a, b, d, len);
+        case OP_ADD * 3 + T_32F: return ippsAdd_32f(a, b, d, len);
+        case OP_ADD * 3 + T_64F: return ippsAdd_64f(a, b, d, len);
+        case OP_SUB * 3 + T_16S: return ippsSub_16s(b, a, d, len);
+        case OP_SUB * 3 + T_32F: return ippsSub_32f(b, a, d, len);
+        case OP_SUB * 3 + T_64F: return ippsSub_64f(b, a, d, len);
+        case OP_MUL * 3 + T_16S: return ippsMul_16s(a, b, d, len);
+        case OP_MUL * 3 + T_32F: return ippsMul_32f(a, b, d, len);
+        case OP_MUL * 3 + T_64F: return ippsMul_64f(a, b, d, len);
+    }
+    return ippStsNullPtrErr;
+}
+
+/**
+ * \brief	d= d op a
+ */
+static IppStatus
+_inplace(int op, int type, const void *a, void *d, int len)
+{
+    switch (op * 3 + type) {
+        case OP_ADD * 3 + T_16S: return ippsAdd_16s_I(a, d, len);
+        case OP_ADD * 3 + T_32F: return ippsAdd_32f_I(a, d, len);
+        case OP_ADD * 3 + T_64F: return ippsAdd_64f_I(a, d, len);
+        case OP_SUB * 3 + T_16S: return ippsSub_16s_I(a, d, len);
+        case OP_SUB * 3 + T_32F: return ippsSub_32f_I(a, d, len);
+        case OP_SUB * 3 + T_64F: return ippsSub_64f_I(a, d, len);
+        case OP_MUL * 3 + T_16S: return ippsMul_16s_I(a, d, len);
+        case OP_MUL * 3 + T_32F: return ippsMul_32f_I(a, d, len);
+        case OP_MUL * 3 + T_64F: return ippsMul_64f_I(a, d, len);
+    }
+    return ippStsNullPtrErr;
+}
+
+/**
+ * \brief	common part of _add, _sub and _mul
+ */
+static PyObject *
+_binaryOp(PyObject *args, int op)
+{
+    PyObject *a, *b, *d;
+    IppsVector va, vb, vd;
+    IppStatus istatus;
+
+    if (!PyArg_ParseTuple(args, "OOO", &a, &b, &d))
+        return NULL;
+    if (_getVector(a, &va, 0) < 0)
+        return NULL;
+    if (_getVector(b, &vb, 0) < 0)
+        goto release_a;
+    if (_getVector(d, &vd, 1) < 0)
+        goto release_b;
+    if (_checkVectors(&va, &vb) < 0 || _checkVectors(&va, &vd) < 0)
+        goto release_d;
+    NOGIL_BEGIN(va.len)
+    istatus= _binary(op, va.type, va.view.buf, vb.view.buf, vd.view.buf, \
+            va.len);
+    NOGIL_END
+    PyBuffer_Release(&vd.view);
+    PyBuffer_Release(&vb.view);
+    PyBuffer_Release(&va.view);
+    if (_checkStatus(op_names[op], istatus) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+release_d:
+    PyBuffer_Release(&vd.view);
+release_b:
+    PyBuffer_Release(&vb.view);
+release_a:
+    PyBuffer_Release(&va.view);
+    return NULL;
+}
+
+/**
+ * \brief	common part of _addI, _subI and _mulI
+ */
+static PyObject *
+_inplaceOp(PyObject *args, int op)
+{
+    PyObject *a, *d;
+    IppsVector va, vd;
+    IppStatus istatus;
+
+    if (!PyArg_ParseTuple(args, "OO", &a, &d))
+        return NULL;
+    if (_getVector(a, &va, 0) < 0)
+        return NULL;
+    if (_getVector(d, &vd, 1) < 0)
+        goto release_a;
+    if (_checkVectors(&va, &vd) < 0)
+        goto release_d;
+    NOGIL_BEGIN(va.len)
+    istatus= _inplace(op, va.type, va.view.buf, vd.view.buf, va.len);
+    NOGIL_END
+    PyBuffer_Release(&vd.view);
+    PyBuffer_Release(&va.view);
+    if (_checkStatus(op_names[op], istatus) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+release_d:
+    PyBuffer_Release(&vd.view);
+release_a:
+    PyBuffer_Release(&va.view);
+    return NULL;
+}
+
+/**
+ * \brief	dst= src1 + src2
+ */
+static PyObject *
+_add(PyObject *self, PyObject *args)
+{
+    return _binaryOp(args, OP_ADD);
+}
+
+/**
+ * \brief	dst= src1 - src2
+ */
+static PyObject *
+_sub(PyObject *self, PyObject *args)
+{
+    return _binaryOp(args, OP_SUB);
+}
+
+/**
+ * \brief	dst= src1 * src2
+ */
+static PyObject *
+_mul(PyObject *self, PyObject *args)
+{
+    return _binaryOp(args, OP_MUL);
+}
+
+/**
+ * \brief	srcdst+= src
+ */
+static PyObject *
+_addI(PyObject *self, PyObject *args)
+{
+    return _inplaceOp(args, OP_ADD);
+}
+
+/**
+ * \brief	srcdst-= src
+ */
+static PyObject *
+_subI(PyObject *self, PyObject *args)
+{
+    return _inplaceOp(args, OP_SUB);
+}
+
+/**
+ * \brief	srcdst*= src
+ */
+static PyObject *
+_mulI(PyObject *self, PyObject *args)
+{
+    return _inplaceOp(args, OP_MUL);
+}
+
+enum { RED_SUM= 0, RED_MEAN, RED_STDDEV, RED_L1, RED_L2, RED_INF };
+static const char *red_names[]= {
+    "ippsSum", "ippsMean", "ippsStdDev", "ippsNorm_L1", "ippsNorm_L2",
+    "ippsNorm_Inf"
+};
+
+/**
+ * \brief	reduction of a vector to a double
+ *
+ * int16 sums are accumulated in 32 bit, int16 mean and standard
+ * deviation are integers (scale factor 0) as computed by IPP.
+ */
+static IppStatus
+_reduce(int red, int type, const void *a, int len, double *r)
+{
+    IppStatus istatus= ippStsNullPtrErr;
+    Ipp16s s16= 0;
+    Ipp32s s32= 0;
+    Ipp32f f32= 0;
+    Ipp64f f64= 0;
+
+    switch (red * 3 + type) {
+        case RED_SUM * 3 + T_16S:
+            istatus= ippsSum_16s32s_Sfs(a, len, &s32, 0); f64= s32; break;
+        case RED_SUM * 3 + T_32F:
+            istatus= ippsSum_32f(a, len, &f32, ippAlgHintFast); f64= f32; break;
+        case RED_SUM * 3 + T_64F:
+            istatus= ippsSum_64f(a, len, &f64); break;
+        case RED_MEAN * 3 + T_16S:
+            istatus= ippsMean_16s_Sfs(a, len, &s16, 0); f64= s16; break;
+        case RED_MEAN * 3 + T_32F:
+            istatus= ippsMean_32f(a, len, &f32, ippAlgHintFast); f64= f32; break;
+        case RED_MEAN * 3 + T_64F:
+            istatus= ippsMean_64f(a, len, &f64); break;
+        case RED_STDDEV * 3 + T_16S:
+            istatus= ippsStdDev_16s_Sfs(a, len, &s16, 0); f64= s16; break;
+        case RED_STDDEV * 3 + T_32F:
+            istatus= ippsStdDev_32f(a, len, &f32, ippAlgHintFast); f64= f32; break;
+        case RED_STDDEV * 3 + T_64F:
+            istatus= ippsStdDev_64f(a, len, &f64); break;
+        case RED_L1 * 3 + T_16S:
+            istatus= ippsNorm_L1_16s32f(a, len, &f32); f64= f32; break;
+        case RED_L1 * 3 + T_32F:
+            istatus= ippsNorm_L1_32f(a, len, &f32); f64= f32; break;
+        case RED_L1 * 3 + T_64F:
+            istatus= ippsNorm_L1_64f(a, len, &f64); break;
+        case RED_L2 * 3 + T_16S:
+            istatus= ippsNorm_L2_16s32f(a, len, &f32); f64= f32; break;
+        case RED_L2 * 3 + T_32F:
+            istatus= ippsNorm_L2_32f(a, len, &f32); f64= f32; break;
+        case RED_L2 * 3 + T_64F:
+            istatus= ippsNorm_L2_64f(a, len, &f64); break;
+        case RED_INF * 3 + T_16S:
+            istatus= ippsNorm_Inf_16s32f(a, len, &f32); f64= f32; break;
+        case RED_INF * 3 + T_32F:
+            istatus= ippsNorm_Inf_32f(a, len, &f32); f64= f32; break;
+        case RED_INF * 3 + T_64F:
+            istatus= ippsNorm_Inf_64f(a, len, &f64); break;
+    }
+    *r= f64;
+    return istatus;
+}
+
+/**
+ * \brief	common part of the reductions
+ * \return	int for int16 sum/mean/stddev, float otherwise
+ */
+static PyObject *
+_reduceOp(PyObject *src, int red)
+{
+    IppsVector va;
+    IppStatus istatus;
+    double r;
+
+    if (_getVector(src, &va, 0) < 0)
+        return NULL;
+    NOGIL_BEGIN(va.len)
+    istatus= _reduce(red, va.type, va.view.buf, va.len, &r);
+    NOGIL_END
+    PyBuffer_Release(&va.view);
+    if (_checkStatus(red_names[red], istatus) < 0)
+        return NULL;
+    if (va.type == T_16S && red <= RED_STDDEV)
+        return PyInt_FromLong((long)r);
+    return PyFloat_FromDouble(r);
+}
+
+/**
+ * \brief	sum of the elements
+ */
+static PyObject *
+_sum(PyObject *self, PyObject *src)
+{
+    return _reduceOp(src, RED_SUM);
+}
+
+/**
+ * \brief	mean of the elements
+ */
+static PyObject *
+_mean(PyObject *self, PyObject *src)
+{
+    return _reduceOp(src, RED_MEAN);
+}
+
+/**
+ * \brief	standard deviation of the elements
+ */
+static PyObject *
+_stdDev(PyObject *self, PyObject *src)
+{
+    return _reduceOp(src, RED_STDDEV);
+}
+
+/**
+ * \brief	L1, L2 or Inf norm of the elements
+ */
+static PyObject *
+_norm(PyObject *self, PyObject *args)
+{
+    PyObject *src;
+    const char *kind= "L2";
+
+    if (!PyArg_ParseTuple(args, "O|s", &src, &kind))
+        return NULL;
+    if (strcmp(kind, "L1") == 0)
+        return _reduceOp(src, RED_L1);
+    if (strcmp(kind, "L2") == 0)
+        return _reduceOp(src, RED_L2);
+    if (strcmp(kind, "Inf") == 0)
+        return _reduceOp(src, RED_INF);
+    PyErr_SetString(PyExc_ValueError, "norm must be 'L1', 'L2' or 'Inf'");
+    return NULL;
+}
+
+/**
+ * \brief	dot product of two vectors (int16 accumulated in 64 bit)
+ */
+static PyObject *
+_dotProd(PyObject *self, PyObject *args)
+{
+    PyObject *a, *b, *retval= NULL;
+    IppsVector va, vb;
+    IppStatus istatus= ippStsNullPtrErr;
+    Ipp64s s64= 0;
+    Ipp32f f32= 0;
+    Ipp64f f64= 0;
+
+    if (!PyArg_ParseTuple(args, "OO", &a, &b))
+        return NULL;
+    if (_getVector(a, &va, 0) < 0)
+        return NULL;
+    if (_getVector(b, &vb, 0) < 0)
+        goto release_a;
+    if (_checkVectors(&va, &vb) < 0)
+        goto release_b;
+    NOGIL_BEGIN(va.len)
+    switch (va.type) {
+        case T_16S:
+            istatus= ippsDotProd_16s64s(va.view.buf, vb.view.buf, va.len, &s64);
+            break;
+        case T_32F:
+            istatus= ippsDotProd_32f(va.view.buf, vb.view.buf, va.len, &f32);
+            f64= f32;
+            break;
+        case T_64F:
+            istatus= ippsDotProd_64f(va.view.buf, vb.view.buf, va.len, &f64);
+            break;
+    }
+    NOGIL_END
+    if (_checkStatus("ippsDotProd", istatus) == 0)
+        retval= va.type == T_16S ? PyLong_FromLongLong(s64) \
+            : PyFloat_FromDouble(f64);
+release_b:
+    PyBuffer_Release(&vb.view);
+release_a:
+    PyBuffer_Release(&va.view);
+    return retval;
+}
+
+/**
+ * \brief	minimum and maximum of the elements
+ * \return	tuple (min, max)
+ */
+static PyObject *
+_minMax(PyObject *self, PyObject *src)
+{
+    IppsVector va;
+    IppStatus istatus= ippStsNullPtrErr;
+    Ipp16s mi16= 0, ma16= 0;
+    Ipp32f mi32= 0, ma32= 0;
+    Ipp64f mi64= 0, ma64= 0;
+
+    if (_getVector(src, &va, 0) < 0)
+        return NULL;
+    NOGIL_BEGIN(va.len)
+    switch (va.type) {
+        case T_16S:
+            istatus= ippsMinMax_16s(va.view.buf, va.len, &mi16, &ma16);
+            break;
+        case T_32F:
+            istatus= ippsMinMax_32f(va.view.buf, va.len, &mi32, &ma32);
+            mi64= mi32; ma64= ma32;
+            break;
+        case T_64F:
+            istatus= ippsMinMax_64f(va.view.buf, va.len, &mi64, &ma64);
+            break;
+    }
+    NOGIL_END
+    PyBuffer_Release(&va.view);
+    if (_checkStatus("ippsMinMax", istatus) < 0)
+        return NULL;
+    if (va.type == T_16S)
+        return Py_BuildValue("ii", mi16, ma16);
+    return Py_BuildValue("dd", mi64, ma64);
+}
+
+/**
+ * \brief	threshold of src (into dst or in place if dst is None)
+ *
+ * Elements compared with op (ippCmpLess, ippCmpGreater) against level
+ * are set to level.
+ */
+static PyObject *
+_threshold(PyObject *self, PyObject *args)
+{
+    PyObject *src, *dst= Py_None;
+    IppsVector va, vd;
+    IppStatus istatus= ippStsNullPtrErr;
+    double level;
+    int op, inplace;
+
+    if (!PyArg_ParseTuple(args, "OdiO", &src, &level, &op, &dst))
+        return NULL;
+    if (op != ippCmpLess && op != ippCmpGreater) {
+        PyErr_SetString(PyExc_ValueError, \
+                "op must be ippCmpLess or ippCmpGreater");
+        return NULL;
+    }
+    inplace= dst == Py_None;
+    if (_getVector(src, &va, inplace) < 0)
+        return NULL;
+    if (inplace)
+        vd= va;
+    else {
+        if (_getVector(dst, &vd, 1) < 0)
+            goto release_a;
+        if (_checkVectors(&va, &vd) < 0)
+            goto release_d;
+    }
+    NOGIL_BEGIN(va.len)
+    switch (va.type * 2 + inplace) {
+        case T_16S * 2:
+            istatus= ippsThreshold_16s(va.view.buf, vd.view.buf, va.len, \
+                    (Ipp16s)level, (IppCmpOp)op);
+            break;
+        case T_16S * 2 + 1:
+            istatus= ippsThreshold_16s_I(vd.view.buf, va.len, \
+                    (Ipp16s)level, (IppCmpOp)op);
+            break;
+        case T_32F * 2:
+            istatus= ippsThreshold_32f(va.view.buf, vd.view.buf, va.len, \
+                    (Ipp32f)level, (IppCmpOp)op);
+            break;
+        case T_32F * 2 + 1:
+            istatus= ippsThreshold_32f_I(vd.view.buf, va.len, \
+                    (Ipp32f)level, (IppCmpOp)op);
+            break;
+        case T_64F * 2:
+            istatus= ippsThreshold_64f(va.view.buf, vd.view.buf, va.len, \
+                    level, (IppCmpOp)op);
+            break;
+        case T_64F * 2 + 1:
+            istatus= ippsThreshold_64f_I(vd.view.buf, va.len, \
+                    level, (IppCmpOp)op);
+            break;
+    }
+    NOGIL_END
+    if (!inplace)
+        PyBuffer_Release(&vd.view);
+    PyBuffer_Release(&va.view);
+    if (_checkStatus("ippsThreshold", istatus) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+release_d:
+    PyBuffer_Release(&vd.view);
+release_a:
+    PyBuffer_Release(&va.view);
+    return NULL;
+}
+
+/**
+ * \brief	size classes of the aligned buffer pool
+ *
+ * Class c holds blocks of POOL_MINBLOCK << c bytes. Larger buffers are
+ * allocated with their exact size and are not recycled.
+ */
+#define POOL_MINBLOCK   64          /**< \def smallest block, one cache line */
+#define POOL_CLASSES    21          /**< \def 64 bytes up to 64 MB */
+#define POOL_MAXFREE    16          /**< \def default free blocks per class */
+
+/**
+ * \brief	free block of the pool, the link lives in the block itself
+ */
+typedef struct PoolBlock {
+    struct PoolBlock *next;
+} PoolBlock;
+
+/**
+ * \brief	size class pool of ippsMalloc_8u blocks, protected by the GIL
+ */
+static struct {
+    PoolBlock *free[POOL_CLASSES];      /**< free lists per class */
+    int numfree[POOL_CLASSES];          /**< blocks on the free lists */
+    int maxfree;                        /**< free blocks kept per class */
+    unsigned long hits;                 /**< allocations from a free list */
+    unsigned long misses;               /**< allocations from ippsMalloc_8u */
+    unsigned long recycled;             /**< blocks put on a free list */
+    unsigned long released;             /**< blocks given to ippsFree */
+    Py_ssize_t inuse;                   /**< bytes held by buffer objects */
+} Pool= { {NULL}, {0}, POOL_MAXFREE, 0, 0, 0, 0, 0 };
+
+/**
+ * \brief	size class of size bytes
+ * \return	class index or -1 if size is not pooled
+ */
+static int
+_poolClass(Py_ssize_t size)
+{
+    int c= 0;
+    Py_ssize_t block= POOL_MINBLOCK;
+
+    while (block < size) {
+        block<<= 1;
+        if (++c >= POOL_CLASSES)
+            return -1;
+    }
+    return c;
+}
+
+/**
+ * \brief	get a 64 byte aligned block of at least size bytes
+ * \return	block or NULL, *capacity is the usable size
+ */
+static Ipp8u *
+_poolAlloc(Py_ssize_t size, int *sizeclass, Py_ssize_t *capacity)
+{
+    int c= _poolClass(size);
+    Ipp8u *p;
+
+    *sizeclass= c;
+    if (c < 0) {
+        *capacity= size;
+        Pool.misses++;
+        return size > INT_MAX ? NULL : ippsMalloc_8u((int)size);
+    }
+    *capacity= (Py_ssize_t)POOL_MINBLOCK << c;
+    if (Pool.free[c]) {
+        p= (Ipp8u *)Pool.free[c];
+        Pool.free[c]= Pool.free[c]->next;
+        Pool.numfree[c]--;
+        Pool.hits++;
+        return p;
+    }
+    Pool.misses++;
+    return ippsMalloc_8u((int)*capacity);
+}
+
+/**
+ * \brief	put a block back on its free list or release it
+ */
+static void
+_poolFree(Ipp8u *p, int sizeclass)
+{
+    PoolBlock *b= (PoolBlock *)p;
+
+    if (sizeclass >= 0 && Pool.numfree[sizeclass] < Pool.maxfree) {
+        b->next= Pool.free[sizeclass];
+        Pool.free[sizeclass]= b;
+        Pool.numfree[sizeclass]++;
+        Pool.recycled++;
+        return;
+    }
+    Pool.released++;
+    ippsFree(p);
+}
+
+/**
+ * \brief	release free blocks until at most keep are left per class
+ */
+static void
+_poolTrim(int keep)
+{
+    int c;
+    PoolBlock *b;
+
+    for (c= 0; c < POOL_CLASSES; ++c)
+        while (Pool.numfree[c] > keep) {
+            b= Pool.free[c];
+            Pool.free[c]= b->next;
+            Pool.numfree[c]--;
+            Pool.released++;
+            ippsFree(b);
+        }
+}
+
+/**
+ * \brief	IppsBufferObject, aligned memory exposing the buffer protocol
+ */
+typedef struct {
+    PyObject_HEAD
+    Ipp8u *data;                    /**< 64 byte aligned block or NULL */
+    Py_ssize_t size;                /**< bytes visible to python */
+    Py_ssize_t capacity;            /**< bytes of the block */
+    int sizeclass;                  /**< pool class, -1 if unpooled */
+    int exports;                    /**< active Py_buffer views */
+    Py_ssize_t itemsize;            /**< size of one element */
+    Py_ssize_t shape;               /**< number of elements */
+    Py_ssize_t bytestride;          /**< 1, stride of views without format */
+    char format[2];                 /**< struct format of the elements */
+} IppsBufferObject;
+
+static PyTypeObject IppsBufferObject_Type;
+
+/**
+ * \brief	give the block of an IppsBufferObject back to the pool
+ */
+static void
+_releaseBlock(IppsBufferObject *o)
+{
+    if (o->data == NULL)
+        return;
+    _poolFree(o->data, o->sizeclass);
+    Pool.inuse-= o->capacity;
+    o->data= NULL;
+    o->size= 0;
+    o->shape= 0;
+}
+
+/**
+ * \brief	IppsBufferObject dealloc function
+ */
+static void
+_dealloc_IppsBufferObject(PyObject *self)
+{
+    _releaseBlock((IppsBufferObject *)self);
+    self->ob_type->tp_free(self);
+}
+
+/**
+ * \brief	new style buffer protocol, one dimensional and writable
+ */
+static int
+_getbuffer_IppsBufferObject(PyObject *self, Py_buffer *view, int flags)
+{
+    IppsBufferObject *o= (IppsBufferObject *)self;
+
+    if (o->data == NULL) {
+        PyErr_SetString(PyExc_ValueError, "buffer was released");
+        return -1;
+    }
+    if (PyBuffer_FillInfo(view, self, o->data, o->size, 0, flags) < 0)
+        return -1;
+    /* without a format the consumer sees unsigned bytes, shape and
+     * strides must describe the same items as itemsize */
+    if (flags & PyBUF_FORMAT) {
+        view->format= o->format;
+        view->itemsize= o->itemsize;
+        if (flags & PyBUF_ND)
+            view->shape= &o->shape;
+        if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES)
+            view->strides= &o->itemsize;
+    }
+    else {
+        if (flags & PyBUF_ND)
+            view->shape= &o->size;
+        if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES)
+            view->strides= &o->bytestride;
+    }
+    o->exports++;
+    return 0;
+}
+
+/**
+ * \brief	new style buffer protocol release
+ */
+static void
+_releasebuffer_IppsBufferObject(PyObject *self, Py_buffer *view)
+{
+    ((IppsBufferObject *)self)->exports--;
+}
+
+static PyBufferProcs IppsBufferObject_BufferProcs= {
+    0,                                              /**< bf_getreadbuffer */
+    0,                                              /**< bf_getwritebuffer */
+    0,                                              /**< bf_getsegcount */
+    0,                                              /**< bf_getcharbuffer */
+    (getbufferproc)_getbuffer_IppsBufferObject,     /**< bf_getbuffer */
+    (releasebufferproc)_releasebuffer_IppsBufferObject, /**< bf_releasebuffer */
+};
+
+/**
+ * \brief	return the block to the pool before the object goes away
+ *
+ * Only the new style buffer protocol is offered, so every consumer of
+ * the memory is counted in exports and release() refuses while one is
+ * active.
+ */
+static PyObject *
+_release_IppsBufferObject(PyObject *self, PyObject *unused)
+{
+    IppsBufferObject *o= (IppsBufferObject *)self;
+
+    if (o->exports > 0) {
+        PyErr_SetString(PyExc_BufferError, "buffer is still exported");
+        return NULL;
+    }
+    _releaseBlock(o);
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	address of the block, to check the alignment
+ */
+static PyObject *
+_getaddress_IppsBufferObject(PyObject *self, void *closure)
+{
+    return PyLong_FromVoidPtr(((IppsBufferObject *)self)->data);
+}
+
+/**
+ * \brief	element format of the buffer
+ */
+static PyObject *
+_getformat_IppsBufferObject(PyObject *self, void *closure)
+{
+    return PyString_FromString(((IppsBufferObject *)self)->format);
+}
+
+static PyMethodDef IppsBufferObject_Methods[]= {
+    {"release", _release_IppsBufferObject, METH_NOARGS,
+        "Return the memory to the pool, the object is unusable afterwards"},
+    {NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+static PyMemberDef IppsBufferObject_Members[]= {
+    {"size", T_PYSSIZET, offsetof(IppsBufferObject, size), READONLY,
+        "size in bytes"},
+    {"capacity", T_PYSSIZET, offsetof(IppsBufferObject, capacity), READONLY,
+        "size of the underlying block in bytes"},
+    {"itemsize", T_PYSSIZET, offsetof(IppsBufferObject, itemsize), READONLY,
+        "size of one element in bytes"},
+    {"nitems", T_PYSSIZET, offsetof(IppsBufferObject, shape), READONLY,
+        "number of elements"},
+    {NULL} /* Sentinel */
+};
+
+static PyGetSetDef IppsBufferObject_GetSet[]= {
+    {"address", _getaddress_IppsBufferObject, NULL,
+        "address of the memory", NULL},
+    {"format", _getformat_IppsBufferObject, NULL,
+        "struct format of the elements", NULL},
+    {NULL} /* Sentinel */
+};
+
+/**
+ * \brief	IppsBufferObject type definition
+ */
+static PyTypeObject IppsBufferObject_Type= {
+    PyObject_HEAD_INIT(NULL)
+    0,                              /**< ob_size */
+    "_ipps.IppsBufferObject",       /**< tp_name */
+    sizeof(IppsBufferObject),       /**< tp_basicsize */
+    0,                              /**< tp_itemsize */
+    (destructor)_dealloc_IppsBufferObject, /**< tp_dealloc */
+    0,                              /**< tp_print */
+    0,                              /**< tp_getattr */
+    0,                              /**< tp_setattr */
+    0,                              /**< tp_compare */
+    0,                              /**< tp_repr */
+    0,                              /**< tp_as_number */
+    0,                              /**< tp_as_sequence */
+    0,                              /**< tp_as_mapping */
+    0,                              /**< tp_hash */
+    0,                              /**< tp_call */
+    0,                              /**< tp_str */
+    0,                              /**< tp_getattro */
+    0,                              /**< tp_setattro */
+    &IppsBufferObject_BufferProcs,  /**< tp_as_buffer */
+    Py_TPFLAGS_DEFAULT|Py_TPFLAGS_HAVE_NEWBUFFER, /**< tp_flags */
+    "64 byte aligned memory allocated with ippsMalloc_8u", /**< tp_doc */
+    0,                              /**< tp_traverse */
+    0,                              /**< tp_clear */
+    0,                              /**< tp_richcompare */
+    0,                              /**< tp_weaklistoffset */
+    0,                              /**< tp_iter */
+    0,                              /**< tp_iternext */
+    IppsBufferObject_Methods,       /**< tp_methods */
+    IppsBufferObject_Members,       /**< tp_members */
+    IppsBufferObject_GetSet,        /**< tp_getset */
+};
+
+/**
+ * \brief	itemsize of a struct format accepted for aligned buffers
+ * \return	itemsize or 0 if the format is not supported
+ */
+static Py_ssize_t
+_formatSize(const char *format)
+{
+    if (format[0] == '\0' || format[1] != '\0')
+        return 0;
+    switch (format[0]) {
+        case 'b': case 'B': case 'c': return 1;
+        case 'h': case 'H': return 2;
+        case 'i': case 'I': case 'f': return 4;
+        case 'q': case 'Q': case 'd': return 8;
+    }
+    return 0;
+}
+
+/**
+ * \brief	allocate an aligned buffer of nitems elements from the pool
+ * \return	IppsBufferObject
+ *
+ * Recycled blocks are not cleared unless zero is set.
+ */
+static PyObject *
+_alignedBuffer(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"nitems", "format", "zero", NULL};
+    Py_ssize_t nitems, itemsize;
+    const char *format= "B";
+    int zero= 0;
+    IppsBufferObject *o;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "n|si", kwlist, \
+                &nitems, &format, &zero))
+        return NULL;
+    itemsize= _formatSize(format);
+    if (itemsize == 0) {
+        PyErr_SetString(PyExc_ValueError, "unsupported format");
+        return NULL;
+    }
+    if (nitems < 0 || nitems > INT_MAX / itemsize) {
+        PyErr_SetString(PyExc_ValueError, "nitems out of range");
+        return NULL;
+    }
+    o= PyObject_New(IppsBufferObject, &IppsBufferObject_Type);
+    if (o == NULL)
+        return NULL;
+    o->data= NULL;
+    o->bytestride= 1;
+    o->size= nitems * itemsize;
+    o->itemsize= itemsize;
+    o->shape= nitems;
+    o->exports= 0;
+    o->format[0]= format[0];
+    o->format[1]= '\0';
+    o->data= _poolAlloc(o->size ? o->size : 1, &o->sizeclass, &o->capacity);
+    if (o->data == NULL) {
+        Py_DECREF(o);
+        return PyErr_NoMemory();
+    }
+    Pool.inuse+= o->capacity;
+    if (zero)
+        ippsZero_8u(o->data, (int)o->size);
+    return (PyObject *)o;
+}
+
+/**
+ * \brief	statistics of the aligned buffer pool
+ * \return	dict
+ */
+static PyObject *
+_poolStats(PyObject *self, PyObject *unused)
+{
+    int c, numfree= 0;
+    Py_ssize_t freebytes= 0;
+
+    for (c= 0; c < POOL_CLASSES; ++c) {
+        numfree+= Pool.numfree[c];
+        freebytes+= (Py_ssize_t)Pool.numfree[c] * (POOL_MINBLOCK << c);
+    }
+    return Py_BuildValue("{s:k,s:k,s:k,s:k,s:i,s:n,s:n,s:i}",
+            "hits", Pool.hits,
+            "misses", Pool.misses,
+            "recycled", Pool.recycled,
+            "released", Pool.released,
+            "free", numfree,
+            "freebytes", freebytes,
+            "inuse", Pool.inuse,
+            "maxfree", Pool.maxfree);
+}
+
+/**
+ * \brief	set the free blocks kept per size class, trims the pool
+ */
+static PyObject *
+_setPoolLimit(PyObject *self, PyObject *args)
+{
+    int maxfree;
+
+    if (!PyArg_ParseTuple(args, "i", &maxfree))
+        return NULL;
+    if (maxfree < 0) {
+        PyErr_SetString(PyExc_ValueError, "maxfree must be >= 0");
+        return NULL;
+    }
+    Pool.maxfree= maxfree;
+    _poolTrim(maxfree);
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	release all free blocks and reset the statistics
+ */
+static PyObject *
+_poolReset(PyObject *self, PyObject *unused)
+{
+    _poolTrim(0);
+    Pool.hits= Pool.misses= Pool.recycled= Pool.released= 0;
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	IppsDFTObject, a planned transform of a fixed length
+ *
+ * Objects are cached by (length, complex, flag, hint) and shared, the
+ * lock serializes use of the work buffer.
+ */
+typedef struct {
+    PyObject_HEAD
+    int length;                     /**< transform length in points */
+    int cplx;                       /**< complex to complex transform */
+    int flag;                       /**< IPP_FFT_* normalization */
+    int hint;                       /**< IppHintAlgorithm */
+    Ipp8u *spec;                    /**< initialized IppsDFTSpec */
+    Ipp8u *work;                    /**< work buffer of the transforms */
+    PyThread_type_lock lock;        /**< serializes use of work */
+} IppsDFTObject;
+
+static PyTypeObject IppsDFTObject_Type;
+static PyObject *dft_cache;         /**< (length, cplx, flag, hint) -> dft */
+static PyObject *dft_lru;           /**< keys of dft_cache, oldest first */
+
+/**
+ * \brief	IppsDFTObject dealloc function
+ */
+static void
+_dealloc_IppsDFTObject(PyObject *self)
+{
+    IppsDFTObject *o= (IppsDFTObject *)self;
+
+    if (o->spec)
+        ippsFree(o->spec);
+    if (o->work)
+        ippsFree(o->work);
+    if (o->lock)
+        PyThread_free_lock(o->lock);
+    self->ob_type->tp_free(self);
+}
+
+/**
+ * \brief	create the spec and work buffer of a new transform
+ * \return	IppsDFTObject
+ */
+static PyObject *
+_create_IppsDFTObject(int length, int cplx, int flag, int hint)
+{
+    IppsDFTObject *o;
+    IppStatus istatus;
+    int specsize= 0, initsize= 0, worksize= 0;
+    Ipp8u *init= NULL;
+
+    o= PyObject_New(IppsDFTObject, &IppsDFTObject_Type);
+    if (o == NULL)
+        return NULL;
+    o->length= length;
+    o->cplx= cplx;
+    o->flag= flag;
+    o->hint= hint;
+    o->spec= NULL;
+    o->work= NULL;
+    o->lock= PyThread_allocate_lock();
+    if (o->lock == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    if (cplx)
+        istatus= ippsDFTGetSize_C_32fc(length, flag, (IppHintAlgorithm)hint, \
+                &specsize, &initsize, &worksize);
+    else
+        istatus= ippsDFTGetSize_R_32f(length, flag, (IppHintAlgorithm)hint, \
+                &specsize, &initsize, &worksize);
+    if (_checkStatus("ippsDFTGetSize", istatus) < 0)
+        goto error;
+    o->spec= ippsMalloc_8u(specsize);
+    o->work= ippsMalloc_8u(worksize > 0 ? worksize : 1);
+    init= ippsMalloc_8u(initsize > 0 ? initsize : 1);
+    if (o->spec == NULL || o->work == NULL || init == NULL) {
+        PyErr_NoMemory();
+        goto error;
+    }
+    if (cplx)
+        istatus= ippsDFTInit_C_32fc(length, flag, (IppHintAlgorithm)hint, \
+                (IppsDFTSpec_C_32fc *)o->spec, init);
+    else
+        istatus= ippsDFTInit_R_32f(length, flag, (IppHintAlgorithm)hint, \
+                (IppsDFTSpec_R_32f *)o->spec, init);
+    ippsFree(init);
+    init= NULL;
+    if (_checkStatus("ippsDFTInit", istatus) < 0)
+        goto error;
+    return (PyObject *)o;
+error:
+    if (init)
+        ippsFree(init);
+    Py_DECREF(o);
+    return NULL;
+}
+
+/**
+ * \brief	floats per frame on the time and frequency side
+ *
+ * Real transforms use the CCS format (length/2+1 complex points) in the
+ * frequency domain, the same layout as numpy.fft.rfft.
+ */
+static void
+_dftFrameSizes(const IppsDFTObject *o, Py_ssize_t *time, Py_ssize_t *freq)
+{
+    if (o->cplx) {
+        *time= 2 * (Py_ssize_t)o->length;
+        *freq= *time;
+    }
+    else {
+        *time= o->length;
+        *freq= 2 * ((Py_ssize_t)o->length / 2 + 1);
+    }
+}
+
+/**
+ * \brief	get a contiguous float32 or complex64 ('Zf') view
+ * \return	number of floats or -1 with exception set
+ */
+static Py_ssize_t
+_getFloats(PyObject *obj, Py_buffer *view, int writable)
+{
+    int flags= PyBUF_C_CONTIGUOUS|PyBUF_FORMAT;
+    const char *f;
+
+    if (writable)
+        flags|= PyBUF_WRITABLE;
+    if (PyObject_GetBuffer(obj, view, flags) < 0)
+        return -1;
+    f= view->format ? view->format : "B";
+    if (*f == '@' || *f == '=' || *f == '<')
+        f++;
+    if (!(strcmp(f, "f") == 0 && view->itemsize == 4) && \
+            !(strcmp(f, "Zf") == 0 && view->itemsize == 8)) {
+        PyBuffer_Release(view);
+        PyErr_SetString(PyExc_TypeError, \
+                "float32 or complex64 buffer expected");
+        return -1;
+    }
+    return view->len / 4;
+}
+
+/**
+ * \brief	transform nframes consecutive frames
+ */
+static IppStatus
+_dftRun(IppsDFTObject *o, int inverse, const Ipp32f *src, Ipp32f *dst, \
+        Py_ssize_t nframes)
+{
+    Py_ssize_t i, tn, fn, sn, dn;
+    IppStatus istatus= ippStsNoErr;
+
+    _dftFrameSizes(o, &tn, &fn);
+    sn= inverse ? fn : tn;
+    dn= inverse ? tn : fn;
+    for (i= 0; i < nframes && istatus >= ippStsNoErr; ++i) {
+        switch (o->cplx * 2 + inverse) {
+            case 0:
+                istatus= ippsDFTFwd_RToCCS_32f(src, dst, \
+                        (const IppsDFTSpec_R_32f *)o->spec, o->work);
+                break;
+            case 1:
+                istatus= ippsDFTInv_CCSToR_32f(src, dst, \
+                        (const IppsDFTSpec_R_32f *)o->spec, o->work);
+                break;
+            case 2:
+                istatus= ippsDFTFwd_CToC_32fc((const Ipp32fc *)src, \
+                        (Ipp32fc *)dst, \
+                        (const IppsDFTSpec_C_32fc *)o->spec, o->work);
+                break;
+            case 3:
+                istatus= ippsDFTInv_CToC_32fc((const Ipp32fc *)src, \
+                        (Ipp32fc *)dst, \
+                        (const IppsDFTSpec_C_32fc *)o->spec, o->work);
+                break;
+        }
+        src+= sn;
+        dst+= dn;
+    }
+    return istatus;
+}
+
+/**
+ * \brief	common part of forward/inverse and their batch variants
+ *
+ * Without batch src and dst must hold exactly one frame, with batch a
+ * whole number of frames each.
+ */
+static PyObject *
+_dftApply(IppsDFTObject *o, PyObject *args, int inverse, int batch)
+{
+    PyObject *src, *dst;
+    Py_buffer vs, vd;
+    Py_ssize_t ns, nd, tn, fn, sn, dn, nframes;
+    IppStatus istatus;
+
+    if (!PyArg_ParseTuple(args, "OO", &src, &dst))
+        return NULL;
+    if ((ns= _getFloats(src, &vs, 0)) < 0)
+        return NULL;
+    if ((nd= _getFloats(dst, &vd, 1)) < 0) {
+        PyBuffer_Release(&vs);
+        return NULL;
+    }
+    _dftFrameSizes(o, &tn, &fn);
+    sn= inverse ? fn : tn;
+    dn= inverse ? tn : fn;
+    nframes= ns / sn;
+    if (ns % sn || nd != nframes * dn || (!batch && nframes != 1)) {
+        PyBuffer_Release(&vd);
+        PyBuffer_Release(&vs);
+        PyErr_Format(PyExc_ValueError, batch ? \
+                "buffers must hold frames of %zd and %zd floats" : \
+                "buffers must hold %zd and %zd floats", sn, dn);
+        return NULL;
+    }
+    if (ns < NOGIL_THRESHOLD && PyThread_acquire_lock(o->lock, 0)) {
+        istatus= _dftRun(o, inverse, vs.buf, vd.buf, nframes);
+        PyThread_release_lock(o->lock);
+    }
+    else {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(o->lock, 1);
+        istatus= _dftRun(o, inverse, vs.buf, vd.buf, nframes);
+        PyThread_release_lock(o->lock);
+        Py_END_ALLOW_THREADS
+    }
+    PyBuffer_Release(&vd);
+    PyBuffer_Release(&vs);
+    if (_checkStatus(inverse ? "ippsDFTInv" : "ippsDFTFwd", istatus) < 0)
+        return NULL;
+    return PyInt_FromSsize_t(nframes);
+}
+
+/**
+ * \brief	forward transform of one frame
+ */
+static PyObject *
+_forward_IppsDFTObject(PyObject *self, PyObject *args)
+{
+    return _dftApply((IppsDFTObject *)self, args, 0, 0);
+}
+
+/**
+ * \brief	inverse transform of one frame
+ */
+static PyObject *
+_inverse_IppsDFTObject(PyObject *self, PyObject *args)
+{
+    return _dftApply((IppsDFTObject *)self, args, 1, 0);
+}
+
+/**
+ * \brief	forward transform of consecutive frames
+ */
+static PyObject *
+_forwardBatch_IppsDFTObject(PyObject *self, PyObject *args)
+{
+    return _dftApply((IppsDFTObject *)self, args, 0, 1);
+}
+
+/**
+ * \brief	inverse transform of consecutive frames
+ */
+static PyObject *
+_inverseBatch_IppsDFTObject(PyObject *self, PyObject *args)
+{
+    return _dftApply((IppsDFTObject *)self, args, 1, 1);
+}
+
+static PyMethodDef IppsDFTObject_Methods[]= {
+    {"forward", _forward_IppsDFTObject, METH_VARARGS,
+        "forward(src, dst) transform of one frame"},
+    {"inverse", _inverse_IppsDFTObject, METH_VARARGS,
+        "inverse(src, dst) transform of one frame"},
+    {"forwardBatch", _forwardBatch_IppsDFTObject, METH_VARARGS,
+        "forwardBatch(src, dst) transform of consecutive frames, returns their number"},
+    {"inverseBatch", _inverseBatch_IppsDFTObject, METH_VARARGS,
+        "inverseBatch(src, dst) transform of consecutive frames, returns their number"},
+    {NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+static PyMemberDef IppsDFTObject_Members[]= {
+    {"length", T_INT, offsetof(IppsDFTObject, length), READONLY,
+        "transform length in points"},
+    {"complex", T_INT, offsetof(IppsDFTObject, cplx), READONLY,
+        "complex to complex transform"},
+    {"flag", T_INT, offsetof(IppsDFTObject, flag), READONLY,
+        "IPP_FFT_* normalization flag"},
+    {"hint", T_INT, offsetof(IppsDFTObject, hint), READONLY,
+        "IppHintAlgorithm of the plan"},
+    {NULL} /* Sentinel */
+};
+
+/**
+ * \brief	IppsDFTObject type definition
+ */
+static PyTypeObject IppsDFTObject_Type= {
+    PyObject_HEAD_INIT(NULL)
+    0,                              /**< ob_size */
+    "_ipps.IppsDFTObject",          /**< tp_name */
+    sizeof(IppsDFTObject),          /**< tp_basicsize */
+    0,                              /**< tp_itemsize */
+    (destructor)_dealloc_IppsDFTObject, /**< tp_dealloc */
+    0,                              /**< tp_print */
+    0,                              /**< tp_getattr */
+    0,                              /**< tp_setattr */
+    0,                              /**< tp_compare */
+    0,                              /**< tp_repr */
+    0,                              /**< tp_as_number */
+    0,                              /**< tp_as_sequence */
+    0,                              /**< tp_as_mapping */
+    0,                              /**< tp_hash */
+    0,                              /**< tp_call */
+    0,                              /**< tp_str */
+    0,                              /**< tp_getattro */
+    0,                              /**< tp_setattro */
+    0,                              /**< tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,             /**< tp_flags */
+    "planned float32 DFT of a fixed length", /**< tp_doc */
+    0,                              /**< tp_traverse */
+    0,                              /**< tp_clear */
+    0,                              /**< tp_richcompare */
+    0,                              /**< tp_weaklistoffset */
+    0,                              /**< tp_iter */
+    0,                              /**< tp_iternext */
+    IppsDFTObject_Methods,          /**< tp_methods */
+    IppsDFTObject_Members,          /**< tp_members */
+};
+
+/**
+ * \brief	move key to the most recently used end of dft_lru
+ * \return	0 on success, -1 with exception set
+ */
+static int
+_dftTouch(PyObject *key)
+{
+    Py_ssize_t i;
+    int r;
+
+    for (i= 0; i < PyList_GET_SIZE(dft_lru); ++i) {
+        r= PyObject_RichCompareBool(PyList_GET_ITEM(dft_lru, i), key, Py_EQ);
+        if (r < 0)
+            return -1;
+        if (r) {
+            if (PySequence_DelItem(dft_lru, i) < 0)
+                return -1;
+            break;
+        }
+    }
+    return PyList_Append(dft_lru, key);
+}
+
+/**
+ * \brief	cached transform of length points
+ * \return	IppsDFTObject, created on first use of its key
+ *
+ * At most DFT_CACHE_SIZE transforms are kept, the least recently used
+ * one is dropped first. Callers still holding it keep it alive.
+ */
+static PyObject *
+_dft(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"length", "complex", "flag", "hint", NULL};
+    int length, cplx= 0, flag= IPP_FFT_DIV_INV_BY_N, hint= ippAlgHintNone;
+    PyObject *key, *o;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "i|iii", kwlist, \
+                &length, &cplx, &flag, &hint))
+        return NULL;
+    if (length <= 0) {
+        PyErr_SetString(PyExc_ValueError, "length must be > 0");
+        return NULL;
+    }
+    cplx= cplx != 0;
+    key= Py_BuildValue("(iiii)", length, cplx, flag, hint);
+    if (key == NULL)
+        return NULL;
+    o= PyDict_GetItem(dft_cache, key);
+    if (o) {
+        Py_INCREF(o);
+        if (_dftTouch(key) < 0)
+            Py_CLEAR(o);
+        Py_DECREF(key);
+        return o;
+    }
+    o= _create_IppsDFTObject(length, cplx, flag, hint);
+    while (o && PyList_GET_SIZE(dft_lru) >= DFT_CACHE_SIZE) {
+        if (PyDict_DelItem(dft_cache, PyList_GET_ITEM(dft_lru, 0)) < 0 \
+                || PySequence_DelItem(dft_lru, 0) < 0)
+            Py_CLEAR(o);
+    }
+    if (o && (PyDict_SetItem(dft_cache, key, o) < 0 \
+                || PyList_Append(dft_lru, key) < 0))
+        Py_CLEAR(o);
+    Py_DECREF(key);
+    return o;
+}
+
+/**
+ * \brief	drop all cached transforms
+ */
+static PyObject *
+_dftCacheClear(PyObject *self, PyObject *unused)
+{
+    PyDict_Clear(dft_cache);
+    if (PyList_SetSlice(dft_lru, 0, PyList_GET_SIZE(dft_lru), NULL) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+/**
+ * \brief	keys of the cached transforms
+ * \return	list of (length, complex, flag, hint), least recently used
+ *		first
+ */
+static PyObject *
+_dftCacheInfo(PyObject *self, PyObject *unused)
+{
+    return PyList_GetSlice(dft_lru, 0, PyList_GET_SIZE(dft_lru));
+}
+
+/**
+ * \brief	kinds of streaming filters
+ */
+enum {
+    FLT_FIR= 0,                     /**< single rate FIR */
+    FLT_FIRMR,                      /**< multirate FIR */
+    FLT_IIR,                        /**< IIR of arbitrary order */
+    FLT_BIQUAD                      /**< cascade of biquad IIR sections */
+};
+
+/**
+ * \brief	IppsFilterObject, FIR/IIR state keeping its delay line
+ *
+ * The delay line carries over from one process() call to the next, so
+ * a stream can be filtered chunk by chunk without overlap.
+ */
+typedef struct {
+    PyObject_HEAD
+    int kind;                       /**< FLT_* */
+    void *state;                    /**< IppsFIRState_32f/IppsIIRState_32f */
+    int tapslen;                    /**< number of taps */
+    int dlylen;                     /**< length of the delay line */
+    int up;                         /**< FLT_FIRMR upsampling factor */
+    int down;                       /**< FLT_FIRMR downsampling factor */
+    PyThread_type_lock lock;        /**< serializes use of state */
+} IppsFilterObject;
+
+static PyTypeObject IppsFilterObject_Type;
+
+/**
+ * \brief	IppsFilterObject dealloc function
+ */
+static void
+_dealloc_IppsFilterObject(PyObject *self)
+{
+    IppsFilterObject *o= (IppsFilterObject *)self;
+
+    if (o->state) {
+        if (o->kind == FLT_FIR || o->kind == FLT_FIRMR)
+            ippsFIRFree_32f(o->state);
+        else
+            ippsIIRFree_32f(o->state);
+    }
+    if (o->lock)
+        PyThread_free_lock(o->lock);
+    self->ob_type->tp_free(self);
+}
+
+/**
+ * \brief	copy a sequence of numbers into a new float32 array
+ * \return	PyMem allocated array or NULL with exception set
+ */
+static Ipp32f *
+_getTaps(PyObject *seq, int *len)
+{
+    PyObject *fast;
+    Ipp32f *taps;
+    Py_ssize_t i, n;
+
+    fast= PySequence_Fast(seq, "taps must be a sequence of numbers");
+    if (fast == NULL)
+        return NULL;
+    n= PySequence_Fast_GET_SIZE(fast);
+    if (n == 0 || n > INT_MAX) {
+        Py_DECREF(fast);
+        PyErr_SetString(PyExc_ValueError, "invalid number of taps");
+        return NULL;
+    }
+    taps= PyMem_New(Ipp32f, n);
+    if (taps == NULL) {
+        Py_DECREF(fast);
+        return (Ipp32f *)PyErr_NoMemory();
+    }
+    for (i= 0; i < n; ++i) {
+        taps[i]= (Ipp32f)PyFloat_AsDouble(PySequence_Fast_GET_ITEM(fast, i));
+        if (PyErr_Occurred()) {
+            PyMem_Free(taps);
+            Py_DECREF(fast);
+            return NULL;
+        }
+    }
+    Py_DECREF(fast);
+    *len= (int)n;
+    return taps;
+}
+
+/**
+ * \brief	new IppsFilterObject without state
+ * \return	IppsFilterObject or NULL
+ */
+static IppsFilterObject *
+_newFilter(int kind)
+{
+    IppsFilterObject *o;
+
+    o= PyObject_New(IppsFilterObject, &IppsFilterObject_Type);
+    if (o == NULL)
+        return NULL;
+    o->kind= kind;
+    o->state= NULL;
+    o->tapslen= 0;
+    o->dlylen= 0;
+    o->up= 1;
+    o->down= 1;
+    o->lock= PyThread_allocate_lock();
+    if (o->lock == NULL) {
+        Py_DECREF(o);
+        return (IppsFilterObject *)PyErr_NoMemory();
+    }
+    return o;
+}
+
+/**
+ * \brief	FIR filter, multirate if up or down differ from 1
+ * \return	IppsFilterObject
+ */
+static PyObject *
+_firFilter(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"taps", "up", "down", NULL};
+    PyObject *seq;
+    IppsFilterObject *o;
+    IppStatus istatus;
+    Ipp32f *taps;
+    int len, up= 1, down= 1;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|ii", kwlist, \
+                &seq, &up, &down))
+        return NULL;
+    if (up < 1 || down < 1) {
+        PyErr_SetString(PyExc_ValueError, "up and down must be >= 1");
+        return NULL;
+    }
+    if ((taps= _getTaps(seq, &len)) == NULL)
+        return NULL;
+    o= _newFilter(up == 1 && down == 1 ? FLT_FIR : FLT_FIRMR);
+    if (o == NULL) {
+        PyMem_Free(taps);
+        return NULL;
+    }
+    o->tapslen= len;
+    o->up= up;
+    o->down= down;
+    if (o->kind == FLT_FIR) {
+        o->dlylen= len;
+        istatus= ippsFIRInitAlloc_32f((IppsFIRState_32f **)&o->state, \
+                taps, len, NULL);
+    }
+    else {
+        o->dlylen= (len + up - 1) / up;
+        istatus= ippsFIRMRInitAlloc_32f((IppsFIRState_32f **)&o->state, \
+                taps, len, up, 0, down, 0, NULL);
+    }
+    PyMem_Free(taps);
+    if (_checkStatus("ippsFIRInitAlloc", istatus) < 0) {
+        o->state= NULL;
+        Py_DECREF(o);
+        return NULL;
+    }
+    return (PyObject *)o;
+}
+
+/**
+ * \brief	IIR filter from 2*(order+1) taps (b0..bN, a0..aN) or, with
+ *		biquad, from 6 taps per section
+ * \return	IppsFilterObject
+ */
+static PyObject *
+_iirFilter(PyObject *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[]= {"taps", "biquad", NULL};
+    PyObject *seq;
+    IppsFilterObject *o;
+    IppStatus istatus;
+    Ipp32f *taps;
+    int len, biquad= 0;
+
+    if (!PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist, \
+                &seq, &biquad))
+        return NULL;
+    if ((taps= _getTaps(seq, &len)) == NULL)
+        return NULL;
+    if (biquad ? len % 6 : (len % 2 || len < 4)) {
+        PyMem_Free(taps);
+        PyErr_SetString(PyExc_ValueError, biquad ? \
+                "biquad taps must be 6 per section" : \
+                "taps must be 2*(order+1) with order >= 1");
+        return NULL;
+    }
+    o= _newFilter(biquad ? FLT_BIQUAD : FLT_IIR);
+    if (o == NULL) {
+        PyMem_Free(taps);
+        return NULL;
+    }
+    o->tapslen= len;
+    if (biquad) {
+        o->dlylen= len / 3;
+        istatus= ippsIIRInitAlloc_BiQuad_32f((IppsIIRState_32f **)&o->state, \
+                taps, len / 6, NULL);
+    }
+    else {
+        o->dlylen= len / 2 - 1;
+        istatus= ippsIIRInitAlloc_32f((IppsIIRState_32f **)&o->state, \
+                taps, len / 2 - 1, NULL);
+    }
+    PyMem_Free(taps);
+    if (_checkStatus("ippsIIRInitAlloc", istatus) < 0) {
+        o->state= NULL;
+        Py_DECREF(o);
+        return NULL;
+    }
+    return (PyObject *)o;
+}
+
+/**
+ * \brief	run the filter over len input samples
+ *
+ * For FLT_FIRMR len is a multiple of down and dst receives
+ * len / down * up samples. src == dst filters in place.
+ */
+static IppStatus
+_filterRun(IppsFilterObject *o, const Ipp32f *src, Ipp32f *dst, int len)
+{
+    switch (o->kind) {
+        case FLT_FIR:
+            if (src == dst)
+                return ippsFIR_32f_I(dst, len, o->state);
+            return ippsFIR_32f(src, dst, len, o->state);
+        case FLT_FIRMR:
+            return ippsFIR_32f(src, dst, len / o->down, o->state);
+        default:
+            if (src == dst)
+                return ippsIIR_32f_I(dst, len, o->state);
+            return ippsIIR_32f(src, dst, len, o->state);
+    }
+}
+
+/**
+ * \brief	filter a chunk of float32 samples into dst or in place
+ * \return	number of samples written
+ */
+static PyObject *
+_process_IppsFilterObject(PyObject *self, PyObject *args)
+{
+    IppsFilterObject *o= (IppsFilterObject *)self;
+    PyObject *src, *dst= Py_None;
+    IppsVector vs, vd;
+    Py_ssize_t outlen;
+    IppStatus istatus;
+    int inplace;
+
+    if (!PyArg_ParseTuple(args, "O|O", &src, &dst))
+        return NULL;
+    inplace= dst == Py_None;
+    if (inplace && o->kind == FLT_FIRMR) {
+        PyErr_SetString(PyExc_ValueError, "multirate filters need dst");
+        return NULL;
+    }
+    if (_getVector(src, &vs, inplace) < 0)
+        return NULL;
+    if (vs.type != T_32F) {
+        PyErr_SetString(PyExc_TypeError, "float32 buffer expected");
+        goto release_s;
+    }
+    outlen= vs.len;
+    if (o->kind == FLT_FIRMR) {
+        if (vs.len % o->down) {
+            PyErr_Format(PyExc_ValueError, \
+                    "chunk length must be a multiple of %d", o->down);
+            goto release_s;
+        }
+        outlen= (Py_ssize_t)(vs.len / o->down) * o->up;
+    }
+    if (inplace)
+        vd= vs;
+    else {
+        if (_getVector(dst, &vd, 1) < 0)
+            goto release_s;
+        if (vd.type != T_32F || vd.len < outlen) {
+            PyErr_Format(PyExc_ValueError, \
+                    "dst must be a float32 buffer of %zd samples", outlen);
+            PyBuffer_Release(&vd.view);
+            goto release_s;
+        }
+    }
+    if (vs.len < NOGIL_THRESHOLD && PyThread_acquire_lock(o->lock, 0)) {
+        istatus= _filterRun(o, vs.view.buf, vd.view.buf, vs.len);
+        PyThread_release_lock(o->lock);
+    }
+    else {
+        Py_BEGIN_ALLOW_THREADS
+        PyThread_acquire_lock(o->lock, 1);
+        istatus= _filterRun(o, vs.view.buf, vd.view.buf, vs.len);
+        PyThread_release_lock(o->lock);
+        Py_END_ALLOW_THREADS
+    }
+    if (!inplace)
+        PyBuffer_Release(&vd.view);
+    PyBuffer_Release(&vs.view);
+    if (_checkStatus(o->kind <= FLT_FIRMR ? "ippsFIR" : "ippsIIR", \
+                istatus) < 0)
+        return NULL;
+    return PyInt_FromSsize_t(outlen);
+release_s:
+    PyBuffer_Release(&vs.view);
+    return NULL;
+}
+
+/**
+ * \brief	clear the delay line to start a new stream
+ */
+static PyObject *
+_reset_IppsFilterObject(PyObject *self, PyObject *unused)
+{
+    IppsFilterObject *o= (IppsFilterObject *)self;
+    IppStatus istatus;
+    Ipp32f *zero;
+
+    zero= PyMem_New(Ipp32f, o->dlylen);
+    if (zero == NULL)
+        return PyErr_NoMemory();
+    ippsZero_32f(zero, o->dlylen);
+    Py_BEGIN_ALLOW_THREADS
+    PyThread_acquire_lock(o->lock, 1);
+    if (o->kind <= FLT_FIRMR)
+        istatus= ippsFIRSetDlyLine_32f(o->state, zero);
+    else
+        istatus= ippsIIRSetDlyLine_32f(o->state, zero);
+    PyThread_release_lock(o->lock);
+    Py_END_ALLOW_THREADS
+    PyMem_Free(zero);
+    if (_checkStatus("ippsSetDlyLine", istatus) < 0)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef IppsFilterObject_Methods[]= {
+    {"process", _process_IppsFilterObject, METH_VARARGS,
+        "process(src, dst=None) filter a float32 chunk, returns samples written"},
+    {"reset", _reset_IppsFilterObject, METH_NOARGS,
+        "Clear the delay line"},
+    {NULL, NULL, 0, NULL} /* Sentinel */
+};
+
+static PyMemberDef IppsFilterObject_Members[]= {
+    {"tapslen", T_INT, offsetof(IppsFilterObject, tapslen), READONLY,
+        "number of taps"},
+    {"up", T_INT, offsetof(IppsFilterObject, up), READONLY,
+        "upsampling factor"},
+    {"down", T_INT, offsetof(IppsFilterObject, down), READONLY,
+        "downsampling factor"},
+    {NULL} /* Sentinel */
+};
+
+/**
+ * \brief	IppsFilterObject type definition
+ */
+static PyTypeObject IppsFilterObject_Type= {
+    PyObject_HEAD_INIT(NULL)
+    0,                              /**< ob_size */
+    "_ipps.IppsFilterObject",       /**< tp_name */
+    sizeof(IppsFilterObject),       /**< tp_basicsize */
+    0,                              /**< tp_itemsize */
+    (destructor)_dealloc_IppsFilterObject, /**< tp_dealloc */
+    0,                              /**< tp_print */
+    0,                              /**< tp_getattr */
+    0,                              /**< tp_setattr */
+    0,                              /**< tp_compare */
+    0,                              /**< tp_repr */
+    0,                              /**< tp_as_number */
+    0,                              /**< tp_as_sequence */
+    0,                              /**< tp_as_mapping */
+    0,                              /**< tp_hash */
+    0,                              /**< tp_call */
+    0,                              /**< tp_str */
+    0,                              /**< tp_getattro */
+    0,                              /**< tp_setattro */
+    0,                              /**< tp_as_buffer */
+    Py_TPFLAGS_DEFAULT,             /**< tp_flags */
+    "streaming float32 FIR/IIR filter", /**< tp_doc */
+    0,                              /**< tp_traverse */
+    0,                              /**< tp_clear */
+    0,                              /**< tp_richcompare */
+    0,                              /**< tp_weaklistoffset */
+    0,                              /**< tp_iter */
+    0,                              /**< tp_iternext */
+    IppsFilterObject_Methods,       /**< tp_methods */
+    IppsFilterObject_Members,       /**< tp_members */
+};
+
 /**
  * \brief	holds the methods for the module
  */
 static PyMethodDef Module_Methods[]= {
 	{"_getLibVersion", _getLibVersion, METH_VARARGS,
 		"Returns information aout the active version of Intell IPP signal processing software"},
+    {"_add", _add, METH_VARARGS,
+        "dst= src1 + src2 on int16/float32/float64 buffers"},
+    {"_sub", _sub, METH_VARARGS,
+        "dst= src1 - src2 on int16/float32/float64 buffers"},
+    {"_mul", _mul, METH_VARARGS,
+        "dst= src1 * src2 on int16/float32/float64 buffers"},
+    {"_addI", _addI, METH_VARARGS,
+        "srcdst+= src on int16/float32/float64 buffers"},
+    {"_subI", _subI, METH_VARARGS,
+        "srcdst-= src on int16/float32/float64 buffers"},
+    {"_mulI", _mulI, METH_VARARGS,
+        "srcdst*= src on int16/float32/float64 buffers"},
+    {"_sum", _sum, METH_O,
+        "Sum of the elements of a buffer"},
+    {"_mean", _mean, METH_O,
+        "Mean of the elements of a buffer"},
+    {"_stdDev", _stdDev, METH_O,
+        "Standard deviation of the elements of a buffer"},
+    {"_norm", _norm, METH_VARARGS,
+        "L1, L2 (default) or Inf norm of the elements of a buffer"},
+    {"_dotProd", _dotProd, METH_VARARGS,
+        "Dot product of two buffers"},
+    {"_minMax", _minMax, METH_O,
+        "Tuple (min, max) of the elements of a buffer"},
+    {"_threshold", _threshold, METH_VARARGS,
+        "Clamp src at level (op ippCmpLess/ippCmpGreater) into dst or in place"},
+    {"_alignedBuffer", (PyCFunction)_alignedBuffer,
+        METH_VARARGS|METH_KEYWORDS,
+        "_alignedBuffer(nitems, format='B', zero=0) 64 byte aligned pooled buffer"},
+    {"_poolStats", _poolStats, METH_NOARGS,
+        "Hit/miss statistics of the aligned buffer pool"},
+    {"_setPoolLimit", _setPoolLimit, METH_VARARGS,
+        "Set the number of free blocks kept per size class"},
+    {"_poolReset", _poolReset, METH_NOARGS,
+        "Release the free blocks of the pool and reset its statistics"},
+    {"_dft", (PyCFunction)_dft, METH_VARARGS|METH_KEYWORDS,
+        "_dft(length, complex=0, flag=IPP_FFT_DIV_INV_BY_N, hint=0) cached float32 transform"},
+    {"_dftCacheClear", _dftCacheClear, METH_NOARGS,
+        "Drop all cached transforms"},
+    {"_dftCacheInfo", _dftCacheInfo, METH_NOARGS,
+        "List of (length, complex, flag, hint) of the cached transforms, LRU first"},
+    {"_firFilter", (PyCFunction)_firFilter, METH_VARARGS|METH_KEYWORDS,
+        "_firFilter(taps, up=1, down=1) streaming float32 FIR filter"},
+    {"_iirFilter", (PyCFunction)_iirFilter, METH_VARARGS|METH_KEYWORDS,
+        "_iirFilter(taps, biquad=0) streaming float32 IIR filter"},
     {NULL, NULL, 0, NULL} /* Sentinel */
 };
 
@@ -51,12 +1912,39 @@ init_ipps(void)
 {
 	PyObject *m;
     
+	if (PyType_Ready(&IppsBufferObject_Type) < 0)
+		return;
+	if (PyType_Ready(&IppsDFTObject_Type) < 0)
+		return;
+	if (PyType_Ready(&IppsFilterObject_Type) < 0)
+		return;
+	dft_cache= PyDict_New();
+	dft_lru= PyList_New(0);
+	if (dft_cache == NULL || dft_lru == NULL)
+		return;
 	m= Py_InitModule("_ipps", Module_Methods);
 	if (m == NULL)
 		return;
+	Py_INCREF(&IppsBufferObject_Type);
+	PyModule_AddObject(m, "IppsBufferObject", \
+			(PyObject*)&IppsBufferObject_Type);
+	Py_INCREF(&IppsDFTObject_Type);
+	PyModule_AddObject(m, "IppsDFTObject", (PyObject*)&IppsDFTObject_Type);
+	Py_INCREF(&IppsFilterObject_Type);
+	PyModule_AddObject(m, "IppsFilterObject", \
+			(PyObject*)&IppsFilterObject_Type);
 	IppsError= PyErr_NewException("_ipps.error", NULL, NULL);
 	Py_INCREF(IppsError);
 	PyModule_AddObject(m, "_ippsError", IppsError);
+	PyModule_AddIntConstant(m, "ippCmpLess", ippCmpLess);
+	PyModule_AddIntConstant(m, "ippCmpGreater", ippCmpGreater);
+	PyModule_AddIntConstant(m, "IPP_FFT_DIV_FWD_BY_N", IPP_FFT_DIV_FWD_BY_N);
+	PyModule_AddIntConstant(m, "IPP_FFT_DIV_INV_BY_N", IPP_FFT_DIV_INV_BY_N);
+	PyModule_AddIntConstant(m, "IPP_FFT_DIV_BY_SQRTN", IPP_FFT_DIV_BY_SQRTN);
+	PyModule_AddIntConstant(m, "IPP_FFT_NODIV_BY_ANY", IPP_FFT_NODIV_BY_ANY);
+	PyModule_AddIntConstant(m, "ippAlgHintNone", ippAlgHintNone);
+	PyModule_AddIntConstant(m, "ippAlgHintFast", ippAlgHintFast);
+	PyModule_AddIntConstant(m, "ippAlgHintAccurate", ippAlgHintAccurate);
 
     ippInit();
 
@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+
+# pyipp - selection of the dispatched IPP code paths
+#
+# Copyright (c) 2012-2013, Christian Staffa <www.haai.de>
+
+from pyipp.ipp import _ipp
+
+# dispatch levels from oldest to newest:
+# (name, ipp cpu type, cpuid bits the processor needs for it)
+LEVELS= [
+    ('SSE2', _ipp.ippCpuSSE2, _ipp.ippCPUID_SSE2),
+    ('SSE3', _ipp.ippCpuSSE3, _ipp.ippCPUID_SSE3),
+    ('SSSE3', _ipp.ippCpuSSSE3, _ipp.ippCPUID_SSSE3),
+    ('SSE41', _ipp.ippCpuSSE41, _ipp.ippCPUID_SSE41),
+    ('SSE42', _ipp.ippCpuSSE42, _ipp.ippCPUID_SSE42),
+    ('AVX', _ipp.ippCpuAVX, _ipp.ippCPUID_AVX|_ipp.ippAVX_ENABLEDBYOS),
+    ]
+if hasattr(_ipp, 'ippCpuAVX2') and hasattr(_ipp, 'ippCPUID_AVX2'):
+    LEVELS.append(('AVX2', _ipp.ippCpuAVX2,
+        _ipp.ippCPUID_AVX2|_ipp.ippAVX_ENABLEDBYOS))
+# levels using the YMM registers, the os has to save them (OSXSAVE/XCR0)
+_YMM_LEVELS= ('AVX', 'AVX2')
+
+def _loadExtensions():
+    """Every pyipp extension calls ippInit() when it is imported, which
+    would undo a pinned level. Import them all before pinning."""
+    from pyipp.ipps import _ipps, _ippch
+
+def available():
+    """Return the names of the levels this processor can run."""
+    fm, s= _ipp._getCpuFeatures()
+    ymm= _ipp._getOsAvxEnabled()
+    return [name for name, ct, bits in LEVELS if fm & bits == bits
+            and (ymm or name not in _YMM_LEVELS)]
+
+def pin(name):
+    """Dispatch the IPP code paths of level <name> (i.e. 'SSE42')."""
+    for n, ct, bits in LEVELS:
+        if n == name:
+            if name not in available():
+                raise ValueError("cpu does not support %s" % (name,))
+            _loadExtensions()
+            return _ipp._initCpu(ct)
+    raise ValueError("unknown dispatch level %s" % (name,))
+
+def reset():
+    """Dispatch the code paths for the best supported level again."""
+    _loadExtensions()
+    return _ipp._init()
+
+def enabled():
+    """Return (mask, string) of the currently enabled cpu features."""
+    return _ipp._getEnabledCpuFeatures()
+
+class pinned(object):
+    """Context manager running a block with level <name> dispatched:
+        with pinned('SSE42'):
+            run_workload()
+    """
+    def __init__(self, name):
+        self.name= name
+    def __enter__(self):
+        pin(self.name)
+        return self
+    def __exit__(self, *exc):
+        reset()
+        return False
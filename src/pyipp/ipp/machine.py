@@ -0,0 +1,61 @@
+#!/usr/bin/env python
+
+# pyipp - cached machine profile for tuning decisions
+#
+# Copyright (c) 2012-2013, Christian Staffa <www.haai.de>
+
+from pyipp.ipp import _ipp
+
+class MachineProfile(object):
+    """Snapshot of the machine taken with a single _getMachineProfile()
+    call:
+    cputype     ipp cpu type (_ipp.ippCpu*)
+    features    cpuid feature bitmask (_ipp.ippCPUID_*)
+    flags       frozenset of the feature names (i.e. 'SSE42', 'AVX')
+    enabled     bitmask of the features the dispatched code uses
+    cachesize   maximum L2/L3 cache size in bytes (0 if unknown)
+    cores       cores on die
+    mhz         calibrated tsc frequency in MHz (0 if unknown)
+    """
+    def __init__(self, d):
+        self.cputype= d['cputype']
+        self.features= d['features']
+        self.flags= frozenset(d['flags'])
+        self.enabled= d['enabled']
+        self.enabledflags= frozenset(d['enabledflags'])
+        self.cachesize= d['cachesize']
+        self.cores= max(1, d['cores'])
+        self.mhz= d['mhz']
+
+    def has(self, flag):
+        """True if the cpu supports feature <flag> (i.e. 'AVX')."""
+        return flag in self.flags
+
+    def chunkSize(self, numthreads=None):
+        """Bytes each of <numthreads> threads (default: cores) can work
+        on while staying in its share of the cache."""
+        if numthreads is None:
+            numthreads= self.cores
+        return max(4096, self.cachesize // max(1, numthreads))
+
+    def __repr__(self):
+        return '<MachineProfile %s cores=%i cache=%i mhz=%i>' % (
+                ' '.join(sorted(self.flags)), self.cores, self.cachesize,
+                self.mhz)
+
+_profile= None
+
+def refresh():
+    """Query the machine again and return the new profile."""
+    global _profile
+    _profile= MachineProfile(_ipp._getMachineProfile())
+    return _profile
+
+def profile():
+    """Return the cached machine profile."""
+    if _profile is None:
+        return refresh()
+    return _profile
+
+# computed once at import
+refresh()
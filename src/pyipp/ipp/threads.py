@@ -0,0 +1,85 @@
+#!/usr/bin/env python
+
+# pyipp - scoped control of the IPP internal threading
+#
+# Copyright (c) 2012-2013, Christian Staffa <www.haai.de>
+
+import threading
+from pyipp.ipp import _ipp
+from pyipp.ipp import machine
+
+_lock= threading.Lock()
+_scopes= []         # active scopes, the last one is in effect
+_initial= None      # ipp thread count before the first scope
+
+def topology():
+    """Return cores on die and the maximum L2/L3 cache size in bytes."""
+    p= machine.profile()
+    return {'cores': p.cores, 'cachesize': p.cachesize}
+
+def threadsPerWorker(numworkers):
+    """IPP threads per python worker so that <numworkers> workers
+    together do not use more threads than there are cores."""
+    return max(1, topology()['cores'] // max(1, numworkers))
+
+def chunkSize(numthreads=None):
+    """Bytes each IPP thread can work on while staying in its share of
+    the cache."""
+    return machine.profile().chunkSize(numthreads)
+
+def _apply(numthreads, affinity, offset):
+    _ipp._setNumThreads(numthreads)
+    if affinity is not None:
+        _ipp._setAffinity(affinity, offset)
+
+class scope(object):
+    """Context manager setting the IPP thread count (and optionally the
+    affinity) for a region, restoring the previous setting afterwards:
+
+        with scope(workers=8):          # one share of the cores per worker
+            ...
+        with scope(numthreads=1):       # no IPP threads inside python workers
+            ...
+
+    Without arguments the thread count defaults to the cores on die.
+    Scopes may nest and overlap between threads; the most recently
+    entered active scope is in effect. The IPP setting is process wide."""
+    def __init__(self, numthreads=None, workers=None, affinity=None,
+            offset=0):
+        if numthreads is None:
+            if workers is not None:
+                numthreads= threadsPerWorker(workers)
+            else:
+                numthreads= topology()['cores']
+        self.numthreads= numthreads
+        self.affinity= affinity
+        self.offset= offset
+    def __enter__(self):
+        global _initial
+        _lock.acquire()
+        try:
+            if not _scopes:
+                _initial= _ipp._getNumThreads()
+            _scopes.append(self)
+            _apply(self.numthreads, self.affinity, self.offset)
+        finally:
+            _lock.release()
+        return self
+    def __exit__(self, *exc):
+        _lock.acquire()
+        try:
+            _scopes.remove(self)
+            if self.affinity is not None:
+                _ipp._setAffinity(_ipp.ippAffinityRestore, 0)
+            if _scopes:
+                top= _scopes[-1]
+                _apply(top.numthreads, top.affinity, top.offset)
+            else:
+                _ipp._setNumThreads(_initial)
+        finally:
+            _lock.release()
+        return False
+
+def perWorker(numworkers):
+    """Scope for the body of one of <numworkers> python workers."""
+    return scope(workers=numworkers)
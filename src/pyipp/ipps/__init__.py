@@ -1,4 +1,4 @@
 # pyipp.ipps initialization file
 
-__all__= ['ippch']
+__all__= ['ippch', 'scanpool']
 
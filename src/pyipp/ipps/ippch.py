@@ -5,6 +5,8 @@
 # Copyright (c) 2012-2013, Christian Staffa <www.haai.de>
 # Copyright (c) 2012, Riverbed Technology, Inc. <www.riverbed.com>
 
+import atexit, warnings
+from pyipp.ipp import machine
 from pyipp.ipps import _ippch
 
 # flags
@@ -14,7 +16,10 @@ I= IGNORECASE= 4
 X= VERBOSE= 8
 G= GLOBAL= 16
 
-def compile(pattern, flags=0):
+# raised by search_async() and searchMulti_async() on a full pool queue
+QueueFull= _ippch._IppchQueueFull
+
+def compile(pattern, flags=0, shared=False, lazy=False, priority=0):
     """
     Compile a RE pattern string into a regexp object. Flags may be
     concatenated with | (i.e. M|S|X)
@@ -24,10 +29,18 @@ def compile(pattern, flags=0):
     I   Do case-insensitive pattern matching
     X   Extend patterns legibility by permitting whitespace and comments
     G   Global matching
+    With <shared> the object is prepared for compiling once in a parent
+    and scanning in forked worker processes, which saves the compile in
+    every worker but not the memory of the state (see compileMulti).
+    With <lazy> the pattern is only checked for obvious syntax errors
+    (unbalanced groups and classes, quantifiers without operand) and the
+    IPP state is compiled on first use or by warmup(). Other pattern
+    errors are raised on first use. <priority> orders warmup().
     """
-    return _ippch._compile(pattern, flags)
+    return _ippch._compile(pattern, flags, int(shared), int(lazy), priority)
 
-def compileMulti(patternlist, flags=0):
+def compileMulti(patternlist, flags=0, shared=False, dedup=True, lazy=False,
+        priority=0, manifest=None):
     """
     Compile a RE pattern list in regexp object. Flags may be
     concatenated with | (i.e. M|S|X)
@@ -37,29 +50,193 @@ def compileMulti(patternlist, flags=0):
     I   Do case-insensitive pattern matching
     X   Extend patterns legibility by permitting whitespace and comments
     G   Global matching
+    Entries of <patternlist> are pattern strings or (pattern, flags, id)
+    tuples; flags and id may be left out or None and default to <flags>
+    and the position in the list + 1. Results report the id as
+    'patternid', so one object can hold rules with different flags.
+    With <shared> the IPP states are packed into one mapping apart from
+    the python heap and the metadata is hidden from the cyclic gc, so
+    workers forked after compiling do not compile again. This saves
+    compile time, not memory: IPP writes into a state while scanning,
+    so every worker's first scan of a state copies its pages and the
+    resident size of the scanned states still grows with the number of
+    workers.
+    With <dedup> entries with the same pattern text and flags are
+    compiled once and scanned once; every entry still gets its own
+    result. The 'report' attribute tells how many states and bytes were
+    saved, measureDedup(sample) adds the scan time saved on <sample>.
+    <lazy> and <priority> work as in compile(). Shared objects should be
+    warmed up before forking, else every worker compiles its own copy.
+    With <manifest> the analysed rule set is loaded from that file if it
+    was written for the same patterns, flags, dedup and IPP libraries;
+    otherwise it is compiled and the manifest is (re)written, a failed
+    write only warns. A loaded rule set only needs the IPP states
+    initialized.
+    """
+    if manifest:
+        o= _ippch._loadManifest(manifest, patternlist, flags, int(dedup),
+                int(shared), int(lazy), priority)
+        if o is not None:
+            return o
+    o= _ippch._compileMulti(patternlist, flags, int(shared), int(dedup),
+            int(lazy), priority)
+    if manifest:
+        # the manifest only speeds up the next start, keep the rule set
+        try:
+            o.saveManifest(manifest)
+        except (IOError, OSError), e:
+            warnings.warn('could not write manifest %s: %s' % (manifest, e),
+                    RuntimeWarning)
+    return o
+
+def warmup(objects):
+    """Compile lazy objects in the background on the native worker pool,
+    highest priority first. Objects used before their turn are compiled
+    by the using thread. The objects take at most 64 queue slots and
+    the call never waits for the queue; objects that do not fit are
+    compiled on first use. Returns the number of objects queued."""
+    objects= sorted(objects, key=lambda o: -o.priority)
+    return _ippch._warmup(objects)
+
+def pipeline(state, steps):
+    """
+    Fuse normalization <steps> with a compiled <state>. Steps are
+    'urldecode' (%xx and +), 'strip' (control bytes but whitespace),
+    'collapse' (whitespace runs to one space) and 'lower'; they are
+    applied in this order in a single pass into a reused scratch buffer
+    before the scan. search() and searchMulti() of the pipeline report
+    spans as offsets into the original, not the normalized, string.
+    """
+    return _ippch._pipeline(state, steps)
+
+def keywords(keywords, icase=False):
     """
-    return _ippch._compileMulti(patternlist, flags)
+    Build an Aho-Corasick index of literal <keywords>, strings or
+    (keyword, id) tuples; ids default to the position + 1. With <icase>
+    ASCII letters match case insensitive. The index scans with the same
+    search(), searchBatchInto() and searchPackedInto() buffers as
+    compileMulti() objects and reports every occurrence. add() inserts
+    keywords, the automaton is packed once on the next scan without
+    holding the GIL.
+    """
+    return _ippch._keywords(keywords, int(icase))
+
+def setWorkerPool(numthreads=None, maxqueue=1024):
+    """Configure the native worker pool running search_async() and
+    searchMulti_async() of compiled objects. By default one thread per
+    core of the machine profile is started. Submitting never blocks the
+    event loop, it raises QueueFull while <maxqueue> scans are queued."""
+    if numthreads is None:
+        numthreads= machine.profile().cores
+    _ippch._setWorkerPool(numthreads, maxqueue)
+
+def getWorkerPool():
+    """Return a dict with the worker pool configuration and load."""
+    return _ippch._getWorkerPool()
+
+def profile(enable=True, tracesize=0):
+    """Enable or disable the native scan timers (find, multifind, batch,
+    async). With <tracesize> the last <tracesize> scans are also kept in
+    a trace ring, see profileDump()."""
+    _ippch._profEnable(int(enable), tracesize)
+
+def profileStats():
+    """Return {timer: {count, mean, p50, p99, p999, max}}, times in ns."""
+    return _ippch._profStats()
+
+def profileReset():
+    """Clear the scan timers and the trace ring."""
+    _ippch._profReset()
+
+def profileDump(path):
+    """Write the trace ring to <path>, one 'tsc timer cycles ns bytes'
+    line per scan. Returns the number of records written."""
+    return _ippch._profDump(path)
+
+def hashBatch(sources, kind='crc32c', seed=0, out=None):
+    """Hash every string of <sources> in one call. <kind> is 'crc32'
+    (zlib compatible), 'crc32c' or 'hash' (IPP string hash), <seed> is
+    the initial crc value. The uint32 hashes are written into the int32
+    buffer <out> or returned as a bytearray, use
+    numpy.frombuffer(r, numpy.uint32) to get an array without a copy."""
+    return _ippch._hashBatch(sources, kind, seed, out)
+
+def hashPacked(data, offsets, kind='crc32c', seed=0, out=None):
+    """Same as hashBatch() for packed sources, source i is
+    data[offsets[i]:offsets[i+1]] with <offsets> an int32 buffer."""
+    return _ippch._hashPacked(data, offsets, kind, seed, out)
+
+def strFind(src, sub, start=0, icase=False):
+    """Return the index of <sub> in the buffer <src> from <start>, or -1.
+    With <icase> latin case is ignored without lowercased copies, a
+    replacement for src.lower().find(sub.lower())."""
+    return _ippch._strFind(src, sub, start, int(icase))
+
+def strFindBatch(sources, sub, icase=False, out=None):
+    """strFind() over every string of <sources> in one call, the int32
+    indexes are written into <out> or returned as a bytearray."""
+    return _ippch._strFindBatch(sources, sub, int(icase), out)
+
+def strFindAny(src, chars, start=0):
+    """Return the index of the first byte of <src> from <start> that is
+    one of <chars>, or -1."""
+    return _ippch._strFindAny(src, chars, start)
+
+def strCompare(a, b, icase=False):
+    """Compare the buffers <a> and <b>, return -1, 0 or 1. With <icase>
+    latin case is ignored, a replacement for cmp(a.lower(), b.lower())."""
+    return _ippch._strCompare(a, b, int(icase))
+
+def strCompareBatch(sources, sub, icase=False, out=None):
+    """strCompare() of every string of <sources> with <sub> in one call,
+    the int32 results are written into <out> or returned as a
+    bytearray."""
+    return _ippch._strCompareBatch(sources, sub, int(icase), out)
+
+def strTrim(src, chars=None):
+    """Strip any of <chars> from both ends of <src>, whitespace if
+    <chars> is None, like src.strip(chars)."""
+    if chars is None:
+        return _ippch._strTrim(src)
+    return _ippch._strTrim(src, chars)
+
+# size the pool from the machine profile instead of querying cpuid again
+setWorkerPool()
+# queued scans hold references, let them finish before the interpreter
+atexit.register(_ippch._stopWorkerPool)
 
 def escape(string):
     """Return (a copy of) string with all non-alphanumerics backslashed."""
     pass
 
-def match(string):
+def match(pattern, string, flags=0):
     """Return a corresponding match object instance, if 0 or more chars
     at beginning of <string> match the regex pattern string, or None
     if no match."""
-    pass
+    return _ippch._compile(pattern, flags).match(string)
+
+def fullmatch(pattern, string, flags=0):
+    """Like match(), but the whole <string> has to match <pattern>."""
+    return _ippch._compile(pattern, flags).fullmatch(string)
 
 def search(pattern, string, flags=0):
     """Scan through <string> for a location matching <pattern>,
     return a corresponding match object instance, or None if no match."""
-    return _ippch._compile(pattern, flags)._search(string)
+    return _ippch._compile(pattern, flags).search(string)
 
-def split(pattern, string, maxsplit):
+def split(pattern, string, maxsplit=0, flags=0, offsets=False):
     """Split <string> by occurences of <pattern>. If capturing () are
     used in pattern, then occurences of patterns or subpatterns are also
-    returned."""
-    pass
+    returned. The pieces are memoryview slices of <string>, or
+    (start, end) pairs with <offsets>; nothing is copied. ^, \\b and \\B
+    see the byte before each scan, lookbehind is not supported."""
+    return _ippch._compile(pattern, flags).split(string, maxsplit,
+            int(offsets))
+
+def isplit(pattern, string, maxsplit=0, flags=0, offsets=False):
+    """Iterator version of split(), scans lazily piece by piece."""
+    return _ippch._compile(pattern, flags).isplit(string, maxsplit,
+            int(offsets))
 
 def findall(pattern, string):
     """Return a list of non-overlapping matches in <pattern>, either a 
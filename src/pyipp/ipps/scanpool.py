@@ -0,0 +1,206 @@
+#!/usr/bin/env python
+
+# pyipp - multi process scanning over shared memory batches
+#
+# Copyright (c) 2012-2013, Christian Staffa <www.haai.de>
+
+import array, ctypes, multiprocessing
+from pyipp.ipp import machine
+from pyipp.ipps import _ippch
+
+# slot header fields (int32)
+H_NSRC= 0           # sources in the slot
+H_DATALEN= 1        # bytes of packed source data
+H_SIZE= 4           # header entries
+
+class _Layout(object):
+    """Offsets of the areas of one ring slot. A slot holds a header,
+    offsets[maxinputs+1], ids/starts/ends/inputs[maxrecords] and the
+    packed data, all in int32 units except the data."""
+    def __init__(self, slotsize, maxinputs, maxrecords):
+        self.maxinputs= maxinputs
+        self.maxrecords= maxrecords
+        self.datasize= slotsize
+        self.header= 0
+        self.offsets= 4 * H_SIZE
+        self.columns= self.offsets + 4 * (maxinputs + 1)
+        self.data= self.columns + 16 * maxrecords
+        self.slotbytes= (self.data + slotsize + 63) & ~63
+
+class _Slot(object):
+    """ctypes views of one slot of the shared ring, valid in every
+    process forked after the ring was created."""
+    def __init__(self, ring, layout, index):
+        base= index * layout.slotbytes
+        self.ring= ring
+        self.layout= layout
+        self.base= base
+        self.header= (ctypes.c_int32 * H_SIZE).from_buffer(ring,
+                base + layout.header)
+        n= layout.maxrecords
+        col= base + layout.columns
+        self.ids= (ctypes.c_int32 * n).from_buffer(ring, col)
+        self.starts= (ctypes.c_int32 * n).from_buffer(ring, col + 4 * n)
+        self.ends= (ctypes.c_int32 * n).from_buffer(ring, col + 8 * n)
+        self.inputs= (ctypes.c_int32 * n).from_buffer(ring, col + 12 * n)
+        self.data= (ctypes.c_char * layout.datasize).from_buffer(ring,
+                base + layout.data)
+        self.address= ctypes.addressof(self.data)
+    def offsets(self, n):
+        """offsets[n+1] of a batch of <n> sources"""
+        return (ctypes.c_int32 * (n + 1)).from_buffer(self.ring,
+                self.base + self.layout.offsets)
+    def column(self, col, n):
+        """first <n> records of a result column as array('i')"""
+        a= array.array('i')
+        a.fromstring(ctypes.string_at(ctypes.addressof(col), 4 * n))
+        return a
+
+def _worker(ruleset, slots, tasks, done):
+    """worker process: scan slots in place until None is received"""
+    while True:
+        msg= tasks.get()
+        if msg is None:
+            break
+        index, first= msg
+        slot= slots[index]
+        nsrc= slot.header[H_NSRC]
+        try:
+            n, nxt= ruleset.searchMultiPackedInto(slot.data,
+                    slot.offsets(nsrc), slot.ids, slot.starts, slot.ends,
+                    slot.inputs, first)
+            done.put((index, n, nxt, None))
+        except Exception, e:
+            done.put((index, 0, first, '%s: %s' % (type(e).__name__, e)))
+
+class _Batch(object):
+    """parent side state of a submitted batch"""
+    def __init__(self, ticket, nsrc):
+        self.ticket= ticket
+        self.nsrc= nsrc
+        self.ids, self.starts, self.ends, self.inputs= [array.array('i')
+                for i in range(4)]
+        self.complete= False
+        self.error= None
+
+class ScanPool(object):
+    """Scan batches of strings with a compiled multi rule set in worker
+    processes. Sources are packed once into a shared memory ring of
+    <slots> slots, the workers scan them in place and write the
+    id/start/end/input records back into the same slot. Per batch only
+    a slot index and a record count cross the process boundary.
+
+        rules= ippch.compileMulti(patterns, shared=True)
+        with ScanPool(rules, numprocs=4) as pool:
+            for ids, starts, ends, inputs in pool.imap(batches):
+                ...
+
+    The rule set is inherited by forking, compile it (shared=True) before
+    creating the pool. A batch must fit into <slotsize> bytes and
+    <maxinputs> sources. When a batch has more than <maxrecords> matches
+    the slot is scanned again from the first source that did not fit."""
+    def __init__(self, ruleset, numprocs=None, slots=None, slotsize=1 << 20,
+            maxinputs=4096, maxrecords=16384):
+        if numprocs is None:
+            numprocs= machine.profile().cores
+        if slots is None:
+            slots= 2 * numprocs
+        self.layout= _Layout(slotsize, maxinputs, maxrecords)
+        self.ring= multiprocessing.RawArray(ctypes.c_char,
+                slots * self.layout.slotbytes)
+        self.slots= [_Slot(self.ring, self.layout, i) for i in range(slots)]
+        self.tasks= multiprocessing.Queue()
+        self.done= multiprocessing.Queue()
+        self.free= range(slots)
+        self.busy= {}           # slot index -> _Batch
+        self.batches= {}        # ticket -> _Batch
+        self.ticket= 0
+        self.procs= []
+        for i in range(numprocs):
+            p= multiprocessing.Process(target=_worker,
+                    args=(ruleset, self.slots, self.tasks, self.done))
+            p.daemon= True
+            p.start()
+            self.procs.append(p)
+    def __enter__(self):
+        return self
+    def __exit__(self, *exc):
+        self.close()
+    def _wait(self):
+        """handle one completion message of a worker"""
+        index, n, nxt, error= self.done.get()
+        slot= self.slots[index]
+        b= self.busy[index]
+        if error is not None:
+            b.error= error
+        elif n > 0:
+            b.ids.extend(slot.column(slot.ids, n))
+            b.starts.extend(slot.column(slot.starts, n))
+            b.ends.extend(slot.column(slot.ends, n))
+            b.inputs.extend(slot.column(slot.inputs, n))
+        if error is None and nxt < b.nsrc:
+            if n == 0:
+                b.error= 'source %i has more than %i matches' % \
+                        (nxt, self.layout.maxrecords)
+            else:
+                self.tasks.put((index, nxt))
+                return
+        b.complete= True
+        del self.busy[index]
+        self.free.append(index)
+    def submit(self, sources):
+        """Pack the strings of <sources> into a free slot and queue it,
+        waiting for a slot to become free. Returns a ticket for
+        collect()."""
+        n= len(sources)
+        if n > self.layout.maxinputs:
+            raise ValueError('batch has more than %i sources' %
+                    self.layout.maxinputs)
+        if sum(map(len, sources)) > self.layout.datasize:
+            raise ValueError('batch larger than %i bytes' %
+                    self.layout.datasize)
+        while not self.free:
+            self._wait()
+        index= self.free.pop()
+        slot= self.slots[index]
+        offsets= slot.offsets(n)
+        pos= 0
+        for i, s in enumerate(sources):
+            offsets[i]= pos
+            ctypes.memmove(slot.address + pos, s, len(s))
+            pos+= len(s)
+        offsets[n]= pos
+        slot.header[H_NSRC]= n
+        slot.header[H_DATALEN]= pos
+        self.ticket+= 1
+        b= _Batch(self.ticket, n)
+        self.busy[index]= b
+        self.batches[b.ticket]= b
+        self.tasks.put((index, 0))
+        return b.ticket
+    def collect(self, ticket):
+        """Wait for the batch of <ticket>, return (ids, starts, ends,
+        inputs) as int32 arrays; inputs index the sources of the batch."""
+        b= self.batches.pop(ticket)
+        while not b.complete:
+            self._wait()
+        if b.error is not None:
+            raise _ippch._IppchError(b.error)
+        return b.ids, b.starts, b.ends, b.inputs
+    def imap(self, batches):
+        """Scan an iterable of source lists, yielding the collect()
+        result of every batch in order while keeping the ring full."""
+        pending= []
+        for sources in batches:
+            if len(pending) >= len(self.slots):
+                yield self.collect(pending.pop(0))
+            pending.append(self.submit(sources))
+        while pending:
+            yield self.collect(pending.pop(0))
+    def close(self):
+        """Stop the workers after the queued batches."""
+        for p in self.procs:
+            self.tasks.put(None)
+        for p in self.procs:
+            p.join()
+        self.procs= []
@@ -0,0 +1,51 @@
+#!/usr/bin/env python
+# pyipp benchmark: event loop latency while large documents are scanned
+#
+# needs asyncio (python3) or trollius, run from the repository root:
+# $ python test/bench/bench_async.py [documents] [document size]
+import sys, time
+try:
+    import asyncio
+except ImportError:
+    import trollius as asyncio
+from pyipp.ipps import _ippch
+
+class Ticker(object):
+    """measures how late a 1ms timer fires while scans are running"""
+    def __init__(self, loop):
+        self.loop= loop
+        self.lat= []
+        self.stopped= False
+        self.t= time.time()
+        loop.call_later(0.001, self.tick)
+    def tick(self):
+        now= time.time()
+        self.lat.append(now - self.t - 0.001)
+        self.t= now
+        if not self.stopped:
+            self.loop.call_later(0.001, self.tick)
+
+def run(ndocs, size):
+    loop= asyncio.get_event_loop()
+    state= _ippch._compile(r'(never|matches)[0-9]{4}', 0)
+    doc= 'x' * size
+    ticker= Ticker(loop)
+    t= time.time()
+    futures= [state.search_async(doc, loop) for i in range(ndocs)]
+    loop.run_until_complete(asyncio.wait(futures))
+    elapsed= time.time() - t
+    ticker.stopped= True
+    lat= sorted(ticker.lat)
+    print "documents %i x %i bytes in %.3fs (%.1f MB/s)" % \
+            (ndocs, size, elapsed, ndocs * size / elapsed / 1e6)
+    print "loop latency p50 %.3fms p99 %.3fms max %.3fms" % \
+            (lat[len(lat) // 2] * 1e3, lat[len(lat) * 99 // 100] * 1e3,
+                    lat[-1] * 1e3)
+
+if __name__ == '__main__':
+    n, size= 64, 4 << 20
+    if len(sys.argv) > 1:
+        n= int(sys.argv[1])
+    if len(sys.argv) > 2:
+        size= int(sys.argv[2])
+    run(n, size)
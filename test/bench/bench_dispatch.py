@@ -0,0 +1,43 @@
+#!/usr/bin/env python
+# pyipp benchmark: throughput of a rule set under each dispatch level
+#
+# run from the repository root after building:
+# $ python test/bench/bench_dispatch.py [rules file] [corpus file]
+# rules file: one pattern per line, corpus file: one input per line
+import sys, time
+from pyipp.ipp import dispatch
+from pyipp.ipps import _ippch
+
+RULES= [r'GET (/[a-z]+) HTTP', r'[0-9]{1,3}(\.[0-9]{1,3}){3}',
+        r'(?i)user-agent: [^\r\n]*bot', r'[A-Za-z0-9._%+-]+@[A-Za-z0-9.-]+']
+CORPUS= ['GET /index HTTP/1.1\r\nUser-Agent: crawlbot\r\n',
+        'from 10.0.0.1 to admin@example.com ' * 8,
+        'x' * 4096]
+
+def measure(state, corpus, seconds=1.0):
+    nbytes, n, t0= 0, 0, time.time()
+    while time.time() - t0 < seconds:
+        for doc in corpus:
+            state.searchMulti(doc)
+            nbytes+= len(doc)
+        n+= len(corpus)
+    t= time.time() - t0
+    return n / t, nbytes / t / 1e6
+
+def run(rules, corpus):
+    state= _ippch._compileMulti(rules, 0)
+    print "%-8s %14s %10s" % ('level', 'docs/s', 'MB/s')
+    for name in dispatch.available():
+        with dispatch.pinned(name):
+            docs, mbs= measure(state, corpus)
+        print "%-8s %14.0f %10.1f" % (name, docs, mbs)
+    docs, mbs= measure(state, corpus)
+    print "%-8s %14.0f %10.1f" % ('auto', docs, mbs)
+
+if __name__ == '__main__':
+    rules, corpus= RULES, CORPUS
+    if len(sys.argv) > 1:
+        rules= [l.rstrip('\n') for l in open(sys.argv[1]) if l.strip()]
+    if len(sys.argv) > 2:
+        corpus= [l for l in open(sys.argv[2])]
+    run(rules, corpus)
@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+# pyipp micro benchmark: _ipps cached transforms against numpy and pyfftw
+#
+# run from the repository root after building:
+# $ python test/bench/bench_fft.py [length] [frames] [iterations]
+import sys, timeit
+
+SETUP= """
+import numpy
+from pyipp.ipps import _ipps
+n, frames= %d, %d
+x= numpy.random.random_sample(n * frames).astype(numpy.float32)
+X= numpy.empty(frames * (n // 2 + 1), numpy.complex64)
+d= _ipps._dft(n)
+one= x[:n]
+ONE= X[:n // 2 + 1]
+rows= x.reshape(frames, n)
+try:
+    import pyfftw
+    fin= pyfftw.empty_aligned((frames, n), 'float32')
+    fin[:]= rows
+    fw= pyfftw.builders.rfft(fin, axis=1)
+except ImportError:
+    fw= None
+"""
+
+CASES= [
+    ('numpy rfft frame', 'numpy.fft.rfft(one)'),
+    ('ipps forward frame', 'd.forward(one, ONE)'),
+    ('numpy rfft batch', 'numpy.fft.rfft(rows, axis=1)'),
+    ('ipps forwardBatch', 'd.forwardBatch(x, X)'),
+    ('pyfftw rfft batch', 'fw()'),
+    ]
+
+def run(length, frames, iterations):
+    setup= SETUP % (length, frames)
+    print "%d points, %d frames" % (length, frames)
+    print "%-20s %12s %14s" % ('case', 'us/call', 'Mframes/s')
+    for name, stmt in CASES:
+        if stmt == 'fw()':
+            try:
+                import pyfftw
+            except ImportError:
+                continue
+        t= min(timeit.repeat(stmt, setup, repeat=3, number=iterations))
+        per= t / iterations
+        nf= frames if 'batch' in name.lower() else 1
+        print "%-20s %12.2f %14.3f" % (name, per * 1e6, nf / per / 1e6)
+
+if __name__ == '__main__':
+    length, frames, n= 1024, 256, 200
+    if len(sys.argv) > 1:
+        length= int(sys.argv[1])
+    if len(sys.argv) > 2:
+        frames= int(sys.argv[2])
+    if len(sys.argv) > 3:
+        n= int(sys.argv[3])
+    run(length, frames, n)
@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+# pyipp micro benchmark: _ipps vector kernels against numpy
+#
+# run from the repository root after building:
+# $ python test/bench/bench_ipps.py [length] [iterations]
+import sys, timeit
+
+SETUP= """
+import numpy
+from pyipp.ipps import _ipps
+n= %d
+a= numpy.random.random_sample(n).astype(numpy.%s)
+b= numpy.random.random_sample(n).astype(numpy.%s)
+d= numpy.empty_like(a)
+"""
+
+CASES= [
+    ('add', 'numpy.add(a, b, d)', '_ipps._add(a, b, d)'),
+    ('mul', 'numpy.multiply(a, b, d)', '_ipps._mul(a, b, d)'),
+    ('addI', 'd += a', '_ipps._addI(a, d)'),
+    ('sum', 'a.sum()', '_ipps._sum(a)'),
+    ('mean', 'a.mean()', '_ipps._mean(a)'),
+    ('stdDev', 'a.std(ddof=1)', '_ipps._stdDev(a)'),
+    ('dotProd', 'numpy.dot(a, b)', '_ipps._dotProd(a, b)'),
+    ('norm L2', 'numpy.linalg.norm(a)', '_ipps._norm(a)'),
+    ('minMax', '(a.min(), a.max())', '_ipps._minMax(a)'),
+    ('threshold', 'numpy.maximum(a, 0.5, d)',
+        '_ipps._threshold(a, 0.5, _ipps.ippCmpLess, d)'),
+    ]
+
+def run(length, iterations):
+    for dtype in ('float32', 'float64'):
+        setup= SETUP % (length, dtype, dtype)
+        print "%s, %d elements" % (dtype, length)
+        print "%-12s %12s %12s %8s" % ('case', 'numpy us', 'ipps us', 'ratio')
+        for name, np, ipps in CASES:
+            tn= min(timeit.repeat(np, setup, repeat=3, number=iterations))
+            ti= min(timeit.repeat(ipps, setup, repeat=3, number=iterations))
+            print "%-12s %12.2f %12.2f %8.2f" % (name,
+                tn / iterations * 1e6, ti / iterations * 1e6, tn / ti)
+        print
+
+if __name__ == '__main__':
+    length, n= 65536, 1000
+    if len(sys.argv) > 1:
+        length= int(sys.argv[1])
+    if len(sys.argv) > 2:
+        n= int(sys.argv[2])
+    run(length, n)
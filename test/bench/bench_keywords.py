@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+# pyipp benchmark: compileMulti of escaped literals vs keyword index
+#
+# run from the repository root:
+# $ python test/bench/bench_keywords.py [keywords] [MB of input]
+import sys, time, random, re, struct
+from pyipp.ipps import _ippch
+
+def word():
+    return ''.join(random.choice('abcdefghijklmnop')
+            for i in range(random.randint(4, 12)))
+
+def run(nkeywords, mbytes):
+    words= list(set(word() for i in range(nkeywords)))
+    text= ' '.join(random.choice(words) if random.random() < 0.01
+            else word() for i in range(mbytes << 17))
+    sources= [text[i:i + 4096] for i in range(0, len(text), 4096)]
+    ids, starts, ends= [bytearray(4 * 65536) for i in range(3)]
+    total= sum(map(len, sources))
+
+    t= time.time()
+    multi= _ippch._compileMulti([re.escape(w) for w in words], 0)
+    print "compileMulti %5i keywords  build %.3fs statesize %i" % \
+            (len(words), time.time() - t, multi.report['statesize'])
+    t= time.time()
+    nxt= 0
+    while nxt < len(sources):
+        n, nxt= multi.searchMultiBatchInto(sources, ids, starts, ends,
+                None, nxt)
+    elapsed= time.time() - t
+    print "compileMulti scan  %.3fs (%.1f MB/s)" % \
+            (elapsed, total / elapsed / 1e6)
+
+    t= time.time()
+    index= _ippch._keywords(words)
+    stats= index.stats
+    print "keywords     %5i keywords  build %.3fs statesize %i" % \
+            (stats['keywords'], time.time() - t, stats['statesize'])
+    t= time.time()
+    nxt= 0
+    while nxt < len(sources):
+        n, nxt= index.searchBatchInto(sources, ids, starts, ends, None, nxt)
+    elapsed= time.time() - t
+    print "keywords scan      %.3fs (%.1f MB/s)" % \
+            (elapsed, total / elapsed / 1e6)
+
+    t= time.time()
+    index.add(['x' + w for w in words[:100]])
+    index.rebuild()
+    print "keywords rebuild after add(100) %.3fs" % (time.time() - t)
+
+if __name__ == '__main__':
+    n, mb= 10000, 16
+    if len(sys.argv) > 1:
+        n= int(sys.argv[1])
+    if len(sys.argv) > 2:
+        mb= int(sys.argv[2])
+    run(n, mb)
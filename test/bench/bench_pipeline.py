@@ -0,0 +1,49 @@
+#!/usr/bin/env python
+# pyipp benchmark: python normalization passes + searchMulti vs pipeline
+#
+# run from the repository root:
+# $ python test/bench/bench_pipeline.py [documents] [document size]
+import sys, time, random, re, urllib
+from pyipp.ipps import _ippch
+
+PATTERNS= [r'select .* from', r'<script', r'union all', r'\.\./\.\./']
+CONTROL= re.compile(r'[\x00-\x08\x0e-\x1f\x7f]')
+SPACE= re.compile(r'\s+')
+
+def document(size):
+    chars= 'abcdefghij KLMNOP%20+/\x01\t'
+    return ''.join(random.choice(chars) for i in range(size))
+
+def normalize(s):
+    s= urllib.unquote_plus(s)
+    s= CONTROL.sub('', s)
+    s= SPACE.sub(' ', s)
+    return s.lower()
+
+def run(ndocs, size):
+    state= _ippch._compileMulti(PATTERNS, 0)
+    pipe= _ippch._pipeline(state, ['urldecode', 'strip', 'collapse', 'lower'])
+    docs= [document(size) for i in range(ndocs)]
+    total= ndocs * size
+
+    t= time.time()
+    for d in docs:
+        state.searchMulti(normalize(d))
+    elapsed= time.time() - t
+    print "python passes + searchMulti %.3fs (%.1f MB/s)" % \
+            (elapsed, total / elapsed / 1e6)
+
+    t= time.time()
+    for d in docs:
+        pipe.searchMulti(d)
+    elapsed= time.time() - t
+    print "pipeline.searchMulti        %.3fs (%.1f MB/s)" % \
+            (elapsed, total / elapsed / 1e6)
+
+if __name__ == '__main__':
+    n, size= 256, 64 << 10
+    if len(sys.argv) > 1:
+        n= int(sys.argv[1])
+    if len(sys.argv) > 2:
+        size= int(sys.argv[2])
+    run(n, size)
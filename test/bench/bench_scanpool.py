@@ -0,0 +1,60 @@
+#!/usr/bin/env python
+# pyipp benchmark: multiprocessing with pickled strings vs ScanPool
+#
+# run from the repository root:
+# $ python test/bench/bench_scanpool.py [batches] [sources per batch] [size]
+import sys, time, random, multiprocessing
+from pyipp.ipps import _ippch
+from pyipp.ipps.scanpool import ScanPool
+
+PATTERNS= [r'GET /[a-z]{3,8}\.php', r'user-agent: *curl', r'(admin|root)=1',
+        r'[0-9]{4}-[0-9]{4}-[0-9]{4}', r'select .* from']
+rules= None
+
+def _scan(sources):
+    out= []
+    for i, s in enumerate(sources):
+        for e in rules.searchMulti(s):
+            if e.get('result'):
+                out.append((e['patternid'], i))
+    return out
+
+def source(size):
+    return ''.join(random.choice('abcdefghij klmnop=0123456789/')
+            for i in range(size))
+
+def run(nbatches, nsources, size):
+    global rules
+    rules= _ippch._compileMulti(PATTERNS, 0, 1)
+    batch= [source(size) for i in range(nsources)]
+    batches= [batch] * nbatches
+    total= nbatches * nsources * size
+    numprocs= multiprocessing.cpu_count()
+
+    pool= multiprocessing.Pool(numprocs)
+    t= time.time()
+    n= sum(len(r) for r in pool.imap(_scan, batches))
+    elapsed= time.time() - t
+    pool.close()
+    pool.join()
+    print "multiprocessing.Pool %.3fs (%.1f MB/s) %i matches" % \
+            (elapsed, total / elapsed / 1e6, n)
+
+    slotsize= nsources * size
+    with ScanPool(rules, numprocs, slotsize=slotsize, maxinputs=nsources,
+            maxrecords=nsources * len(PATTERNS)) as sp:
+        t= time.time()
+        n= sum(len(r[0]) for r in sp.imap(batches))
+        elapsed= time.time() - t
+    print "ScanPool             %.3fs (%.1f MB/s) %i matches" % \
+            (elapsed, total / elapsed / 1e6, n)
+
+if __name__ == '__main__':
+    nbatches, nsources, size= 256, 256, 1024
+    if len(sys.argv) > 1:
+        nbatches= int(sys.argv[1])
+    if len(sys.argv) > 2:
+        nsources= int(sys.argv[2])
+    if len(sys.argv) > 3:
+        size= int(sys.argv[3])
+    run(nbatches, nsources, size)
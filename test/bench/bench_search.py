@@ -0,0 +1,33 @@
+#!/usr/bin/env python
+# pyipp micro benchmark: per call overhead of search/searchMulti
+#
+# run from the repository root after building:
+# $ python test/bench/bench_search.py [iterations]
+import sys, timeit
+
+SETUP= """
+from pyipp.ipps import _ippch
+s= _ippch._compile(r'GET (/[a-z]+) HTTP', 0)
+m= _ippch._compileMulti([r'GET', r'POST', r'(/[a-z]+)', r'HTTP/1\.[01]'], 0)
+hit= 'GET /index HTTP/1.1'
+miss= 'PUT'
+"""
+
+CASES= [
+    ('search hit', 's.search(hit)'),
+    ('search miss', 's.search(miss)'),
+    ('searchMulti hit', 'm.searchMulti(hit)'),
+    ('searchMulti miss', 'm.searchMulti(miss)'),
+    ]
+
+def run(iterations):
+    print "%-20s %12s" % ('case', 'ns/call')
+    for name, stmt in CASES:
+        t= min(timeit.repeat(stmt, SETUP, repeat=3, number=iterations))
+        print "%-20s %12.1f" % (name, t / iterations * 1e9)
+
+if __name__ == '__main__':
+    n= 200000
+    if len(sys.argv) > 1:
+        n= int(sys.argv[1])
+    run(n)
@@ -1,6 +1,9 @@
 # ipp unit test cases
 import sys, os, getopt, re
 from pyipp.ipp import _ipp
+from pyipp.ipp import dispatch
+from pyipp.ipp import threads
+from pyipp.ipp import machine
 import unittest
 
 
@@ -131,6 +134,12 @@ class IppTestCases(unittest.TestCase):
     testlist.append('test_setNumThreads')
     testlist.append('test_getNumThreads')
     testlist.append('test_setAffinity')
+    testlist.append('test_initCpu')
+    testlist.append('test_dispatchPin')
+    testlist.append('test_osAvxEnabled')
+    testlist.append('test_threadScope')
+    testlist.append('test_getMachineProfile')
+    testlist.append('test_machineProfile')
     def setup(self):
         pass
 #    def test_test(self):
@@ -180,6 +189,50 @@ class IppTestCases(unittest.TestCase):
     def test_setAffinity(self):
         v= _ipp._setAffinity(_ipp.ippAffinityAllEnabled, 0)
         self.assertIsInstance(v, type(0))
+    def test_initCpu(self):
+        v= _ipp._initCpu(_ipp.ippCpuSSE2)
+        self.assertIsInstance(v, type(0))
+        v= _ipp._init()
+        self.assertIsInstance(v, type(0))
+    def test_dispatchPin(self):
+        levels= dispatch.available()
+        self.assertTrue('SSE2' in levels)
+        with dispatch.pinned(levels[0]):
+            f,s= dispatch.enabled()
+            self.assertIsInstance(s, type(''))
+        self.assertRaises(ValueError, dispatch.pin, 'MMX')
+    def test_osAvxEnabled(self):
+        ymm= _ipp._getOsAvxEnabled()
+        self.assertIsInstance(ymm, bool)
+        levels= dispatch.available()
+        if not ymm:
+            self.assertFalse('AVX' in levels)
+            self.assertFalse('AVX2' in levels)
+            self.assertRaises(ValueError, _ipp._initCpu, _ipp.ippCpuAVX)
+            if hasattr(_ipp, 'ippCpuAVX2'):
+                self.assertRaises(ValueError, _ipp._setCpuFeatures,
+                        _ipp.ippCPUID_SSE2|_ipp.ippCPUID_AVX)
+    def test_threadScope(self):
+        n= _ipp._getNumThreads()
+        with threads.scope(numthreads=1):
+            self.assertEqual(_ipp._getNumThreads(), 1)
+            with threads.perWorker(1):
+                self.assertEqual(_ipp._getNumThreads(),
+                        threads.threadsPerWorker(1))
+            self.assertEqual(_ipp._getNumThreads(), 1)
+        self.assertEqual(_ipp._getNumThreads(), n)
+    def test_getMachineProfile(self):
+        d= _ipp._getMachineProfile()
+        f,s= _ipp._getCpuFeatures()
+        self.assertEqual(d['features'], f)
+        self.assertEqual(' '.join(d['flags']), s)
+        self.assertIsInstance(d['cores'], type(0))
+    def test_machineProfile(self):
+        p= machine.profile()
+        self.assertTrue(p is machine.profile())
+        self.assertTrue(p.has('SSE2'))
+        self.assertTrue(p.chunkSize() >= 4096)
+        self.assertTrue(machine.refresh() is not p)
 
 testsuite= unittest.TestSuite(map(
     IppTestCases,
@@ -0,0 +1,477 @@
+# ippch unit test cases
+import sys, os, re, struct
+from pyipp.ipps import _ippch
+import unittest
+
+
+class IppchTestCases(unittest.TestCase):
+    testlist= []
+    testlist.append('test_compile')
+    testlist.append('test_search')
+    testlist.append('test_searchNoMatch')
+    testlist.append('test_searchWrongType')
+    testlist.append('test_compileMulti')
+    testlist.append('test_searchMulti')
+    testlist.append('test_capiCapsule')
+    testlist.append('test_workerPool')
+    testlist.append('test_searchAsync')
+    testlist.append('test_compileShared')
+    testlist.append('test_searchMultiBatchInto')
+    testlist.append('test_searchMultiPackedInto')
+    testlist.append('test_profile')
+    testlist.append('test_hashBatch')
+    testlist.append('test_hashPacked')
+    testlist.append('test_strFind')
+    testlist.append('test_strCompare')
+    testlist.append('test_strTransform')
+    testlist.append('test_strBatch')
+    testlist.append('test_match')
+    testlist.append('test_matchTail')
+    testlist.append('test_fullmatch')
+    testlist.append('test_split')
+    testlist.append('test_isplit')
+    testlist.append('test_namedGroups')
+    testlist.append('test_extract')
+    testlist.append('test_compileFlags')
+    testlist.append('test_compileMultiEntries')
+    testlist.append('test_compileMultiDedup')
+    testlist.append('test_compileLazy')
+    testlist.append('test_warmup')
+    testlist.append('test_manifest')
+    testlist.append('test_scanPool')
+    testlist.append('test_pipeline')
+    testlist.append('test_keywords')
+    def setup(self):
+        pass
+    def test_compile(self):
+        s= _ippch._compile(r'^(a+)(b*)$', 0)
+        self.assertEqual(s.ippstatus, 0)
+        self.assertEqual(s.groups, 2)
+    def test_search(self):
+        s= _ippch._compile(r'(b+)', 0)
+        r= s.search('aabbcc')
+        self.assertIsInstance(r, type({}))
+        self.assertEqual(r['ippstatus'], 0)
+        self.assertTrue(r['numfind'] > 0)
+    def test_searchNoMatch(self):
+        s= _ippch._compile(r'xyz', 0)
+        self.assertEqual(s.search('aabbcc'), None)
+    def test_searchWrongType(self):
+        s= _ippch._compile(r'xyz', 0)
+        self.assertRaises(TypeError, s.search, 1)
+    def test_compileMulti(self):
+        s= _ippch._compileMulti([r'abc', r'(x)(y)'], 0)
+        self.assertEqual(s.numpatterns, 2)
+        self.assertEqual(s.patterns[1]['groups'], 2)
+        n= _ippch._compileMulti([r'(?P<k>[a-z]+)=(?:\d)(?<v>\d*)'], 0)
+        self.assertEqual(n.patterns[0]['groups'], 2)
+        self.assertEqual(n.patterns[0]['groupindex'], {'k': 1, 'v': 2})
+        self.assertEqual(n.patterns[0]['ipppattern'], r'([a-z]+)=(?:\d)(\d*)')
+        self.assertTrue(n.searchMulti('x a=12')[0]['result']['numfind'] > 0)
+        self.assertRaises(_ippch._IppchError, _ippch._compileMulti,
+                [r'(?P<k>a)(?P<k>b)'], 0)
+    def test_searchMulti(self):
+        s= _ippch._compileMulti([r'abc', r'xyz'], 0)
+        r= s.searchMulti('__abc__')
+        self.assertEqual(len(r), 2)
+        self.assertEqual(r[0]['patternid'], 1)
+        self.assertTrue(r[0]['result']['numfind'] > 0)
+        self.assertEqual(r[1]['result'], None)
+    def test_capiCapsule(self):
+        self.assertEqual(type(_ippch._C_API).__name__, 'PyCapsule')
+        self.assertEqual(_ippch._C_API_VERSION, 2)
+    def test_workerPool(self):
+        _ippch._setWorkerPool(2, 16)
+        p= _ippch._getWorkerPool()
+        self.assertEqual(p['numthreads'], 2)
+        self.assertEqual(p['maxqueue'], 16)
+        self.assertRaises(ValueError, _ippch._setWorkerPool, -1)
+        _ippch._setWorkerPool(0)
+    def test_searchAsync(self):
+        try:
+            import trollius as asyncio
+        except ImportError:
+            self.skipTest('trollius is not installed')
+        loop= asyncio.new_event_loop()
+        s= _ippch._compile(r'(b+)', 0)
+        m= _ippch._compileMulti([r'abc', r'xyz'], 0)
+        f= s.search_async('aabbcc', loop)
+        g= m.searchMulti_async('_xyz_', loop)
+        r= loop.run_until_complete(asyncio.gather(f, g, loop=loop))
+        self.assertTrue(r[0]['numfind'] > 0)
+        self.assertEqual(r[1][1]['patternid'], 2)
+        # one worker busy with a long scan, one queue slot
+        _ippch._setWorkerPool(1, 1)
+        big= 'a' * (16 << 20)
+        futures= []
+        full= False
+        for i in range(64):
+            try:
+                futures.append(s.search_async(big, loop))
+            except _ippch._IppchQueueFull:
+                full= True
+                break
+        self.assertTrue(full)
+        loop.run_until_complete(asyncio.gather(*futures, loop=loop))
+        self.assertTrue(all(f.result() is None for f in futures))
+        _ippch._setWorkerPool(0)
+        loop.close()
+    def test_compileShared(self):
+        s= _ippch._compileMulti([r'abc', r'(x)(y)'], 0, 1)
+        self.assertEqual(s.shared, 1)
+        r= s.searchMulti('__xy__')
+        self.assertTrue(r[1]['result']['numfind'] > 0)
+        s= _ippch._compile(r'(b+)', 0, 1)
+        self.assertTrue(s.search('abbc')['numfind'] > 0)
+    def test_searchMultiBatchInto(self):
+        s= _ippch._compileMulti([r'abc', r'xyz'], 0)
+        ids, starts, ends, inputs= [bytearray(4*2) for i in range(4)]
+        n, nxt= s.searchMultiBatchInto(['_abc', 'xyz', 'abcxyz'],
+                ids, starts, ends, inputs)
+        self.assertEqual((n, nxt), (2, 2))
+        self.assertEqual(struct.unpack('2i', str(ids)), (1, 2))
+        self.assertEqual(struct.unpack('2i', str(starts)), (1, 0))
+        self.assertEqual(struct.unpack('2i', str(ends)), (4, 3))
+        self.assertEqual(struct.unpack('2i', str(inputs)), (0, 1))
+        n, nxt= s.searchMultiBatchInto(['_abc', 'xyz', 'abcxyz'],
+                ids, starts, ends, inputs, nxt)
+        self.assertEqual((n, nxt), (2, 3))
+        # one record per match, the groups are not written
+        s= _ippch._compileMulti([r'(x)(y)'], 0)
+        ids, starts, ends= [bytearray(4*16) for i in range(3)]
+        n, nxt= s.searchMultiBatchInto(['_xy'], ids, starts, ends)
+        self.assertEqual((n, nxt), (1, 1))
+        self.assertEqual(struct.unpack('i', str(ids[:4]))[0], 1)
+        # only whole int32 entries are accepted
+        self.assertRaises(ValueError, s.searchMultiBatchInto, ['_xy'],
+                bytearray(6), starts, ends)
+        self.assertEqual(struct.unpack('i', str(starts[:4]))[0], 1)
+        self.assertEqual(struct.unpack('i', str(ends[:4]))[0], 3)
+    def test_searchMultiPackedInto(self):
+        s= _ippch._compileMulti([r'abc', r'xyz'], 0)
+        data= '_abc' + 'xyz'
+        offsets= bytearray(struct.pack('3i', 0, 4, 7))
+        ids, starts, ends= [bytearray(4*4) for i in range(3)]
+        n, nxt= s.searchMultiPackedInto(data, offsets, ids, starts, ends)
+        self.assertEqual((n, nxt), (2, 2))
+        self.assertEqual(struct.unpack('2i', str(ids[:8])), (1, 2))
+    def test_profile(self):
+        _ippch._profEnable(1, 16)
+        _ippch._profReset()
+        s= _ippch._compile(r'(b+)', 0)
+        for i in range(100):
+            s.search('aabbcc')
+        st= _ippch._profStats()
+        self.assertEqual(st['find']['count'], 100)
+        self.assertTrue(st['find']['p50'] <= st['find']['p99'])
+        self.assertTrue(st['find']['p99'] <= st['find']['max'])
+        import tempfile
+        fd, path= tempfile.mkstemp()
+        os.close(fd)
+        self.assertEqual(_ippch._profDump(path), 16)
+        os.unlink(path)
+        _ippch._profEnable(0)
+    def test_hashBatch(self):
+        import zlib
+        r= _ippch._hashBatch(['123456789', ''], 'crc32')
+        self.assertEqual(len(r), 8)
+        self.assertEqual(struct.unpack('2I', str(r)),
+                (zlib.crc32('123456789') & 0xffffffff, 0))
+        out= bytearray(8)
+        self.assertTrue(_ippch._hashBatch(['a', 'b'], out=out) is out)
+        self.assertNotEqual(out[:4], out[4:])
+        self.assertRaises(ValueError, _ippch._hashBatch, ['a'], 'md5')
+        self.assertRaises(ValueError, _ippch._hashBatch, ['a', 'b'],
+                out=bytearray(4))
+    def test_hashPacked(self):
+        for kind in ('crc32', 'crc32c', 'hash'):
+            r= _ippch._hashBatch(['abc', 'de', ''], kind)
+            p= _ippch._hashPacked('abcde', struct.pack('4i', 0, 3, 5, 5),
+                    kind)
+            self.assertEqual(r, p)
+    def test_strFind(self):
+        self.assertEqual(_ippch._strFind('GET /Index', '/index'), -1)
+        self.assertEqual(_ippch._strFind('GET /Index', '/index', icase=1), 4)
+        self.assertEqual(_ippch._strFind('abcabc', 'bc', 2), 4)
+        self.assertEqual(_ippch._strFind('abc', ''), 0)
+        self.assertEqual(_ippch._strFind('ab', 'abc'), -1)
+        self.assertEqual(_ippch._strRFind('abcabc', 'bc'), 4)
+        big= 'bc' + 'x' * 100000
+        self.assertEqual(_ippch._strRFind(big, 'bc'), 0)
+        self.assertEqual(_ippch._strFind(bytearray('xYz'), 'yZ', icase=1), 1)
+        self.assertEqual(_ippch._strFindAny('a=b;c', ';='), 1)
+        self.assertEqual(_ippch._strFindAny('a=b;c', ';=', 2), 3)
+        self.assertEqual(_ippch._strFindAny('abc', ';='), -1)
+        from pyipp.ipps import ippch
+        self.assertEqual(ippch.strFindAny('a=b;c', ';'), 3)
+        self.assertEqual(ippch.strCompare('ABC', 'abc', icase=True), 0)
+        r= ippch.strCompareBatch(['abc', 'ABD'], 'abc', icase=True)
+        self.assertEqual(struct.unpack('2i', str(r)), (0, 1))
+        self.assertEqual(ippch.strTrim('  ab \n'), 'ab')
+        self.assertEqual(ippch.strTrim('xabx', 'x'), 'ab')
+    def test_strCompare(self):
+        self.assertEqual(_ippch._strCompare('abc', 'abc'), 0)
+        self.assertEqual(_ippch._strCompare('abc', 'abd'), -1)
+        self.assertEqual(_ippch._strCompare('abcd', 'abc'), 1)
+        self.assertEqual(_ippch._strCompare('ABC', 'abc', icase=1), 0)
+    def test_strTransform(self):
+        self.assertEqual(_ippch._strUpper('aBc1'), 'ABC1')
+        self.assertEqual(_ippch._strLower('aBc1'), 'abc1')
+        self.assertEqual(_ippch._strReplaceC('a,b,c', ',', ';'), 'a;b;c')
+        self.assertEqual(_ippch._strTrim('  ab c\n'), 'ab c')
+        self.assertEqual(_ippch._strTrim('xxabx', 'x'), 'ab')
+        b= bytearray('abc')
+        self.assertEqual(_ippch._strUpper(b, b), None)
+        self.assertEqual(str(b), 'ABC')
+        self.assertEqual(_ippch._strLower(''), '')
+    def test_strBatch(self):
+        r= _ippch._strFindBatch(['xab', 'AB', 'c'], 'ab', icase=1)
+        self.assertEqual(struct.unpack('3i', str(r)), (1, 0, -1))
+        r= _ippch._strFindPacked('xabABc', struct.pack('4i', 0, 3, 5, 6),
+                'ab')
+        self.assertEqual(struct.unpack('3i', str(r)), (1, -1, -1))
+        r= _ippch._strCompareBatch(['a', 'b', 'c'], 'b')
+        self.assertEqual(struct.unpack('3i', str(r)), (-1, 0, 1))
+        r= _ippch._strComparePacked('AbB', struct.pack('3i', 0, 1, 3), 'a',
+                icase=1)
+        self.assertEqual(struct.unpack('2i', str(r)), (0, 1))
+    def test_match(self):
+        s= _ippch._compile(r'(GET|POST) (/\w+)', 0)
+        r= s.match('GET /index HTTP/1.1')
+        self.assertEqual(r['spans'][0], (0, 10))
+        self.assertEqual(r['spans'][2], (4, 10))
+        self.assertEqual(s.match('x GET /index'), None)
+        self.assertTrue(s.search('x GET /index') is not None)
+        self.assertRaises(TypeError, s.match, 1)
+    def test_matchTail(self):
+        s= _ippch._compile(r'ab[cd]', 0)
+        tail= 'x' * (8 << 20)
+        self.assertEqual(s.match('abd' + tail)['spans'], [(0, 3)])
+        self.assertEqual(s.fullmatch('abc' + tail), None)
+        self.assertEqual(s.match('zz' + tail), None)
+        self.assertEqual(s.match('zzabc' + tail), None)
+        # a match as long as the bound still fits the truncated input
+        m= _ippch._compile(r'a.{3}', 0)
+        self.assertEqual(m.match('abcd' + tail)['spans'], [(0, 4)])
+        # the bytes after a bounded match still decide $ and \b
+        e= _ippch._compile(r'a$', 0)
+        self.assertEqual(e.match('a\n' + tail), None)
+        self.assertEqual(e.match('a\n')['spans'], [(0, 1)])
+        b= _ippch._compile(r'ab\b', 0)
+        self.assertEqual(b.match('abc' + tail), None)
+        u= _ippch._compile(r'a(b+)', 0)
+        self.assertEqual(u.match('zz' + tail), None)
+        self.assertEqual(u.match('abb' + tail)['spans'], [(0, 3), (1, 3)])
+    def test_fullmatch(self):
+        s= _ippch._compile(r'[0-9]+', 0)
+        self.assertEqual(s.fullmatch('12345')['spans'], [(0, 5)])
+        self.assertEqual(s.fullmatch('12345x'), None)
+        self.assertEqual(s.match('12345x')['spans'], [(0, 5)])
+        m= _ippch._compileMulti([r'abc'], 0)
+        self.assertRaises(_ippch._IppchError, m.match, 'abc')
+    def test_split(self):
+        s= _ippch._compile(r',\s*', 0)
+        r= s.split('a, b,c')
+        self.assertEqual([m.tobytes() for m in r], ['a', 'b', 'c'])
+        self.assertEqual(s.split('a, b,c', offsets=1),
+                [(0, 1), (3, 4), (5, 6)])
+        self.assertEqual(s.split('a, b,c', 1, 1), [(0, 1), (3, 6)])
+        self.assertEqual(s.split('', offsets=1), [(0, 0)])
+        g= _ippch._compile(r'(-)|(\+)', 0)
+        self.assertEqual(g.split('1-2', offsets=1),
+                [(0, 1), (1, 2), None, (2, 3)])
+        b= _ippch._compile(r'\bfoo', 0)
+        self.assertEqual(b.split('foofoo', offsets=1), [(0, 0), (3, 6)])
+        self.assertEqual(b.split('foo foo', offsets=1),
+                [(0, 0), (3, 4), (7, 7)])
+        c= _ippch._compile(r'^a', 0)
+        self.assertEqual(c.split('aaa', offsets=1), [(0, 0), (1, 3)])
+        self.assertRaises(ValueError, _ippch._compile(r'(?<=a)b', 0).split,
+                'abab')
+    def test_isplit(self):
+        s= _ippch._compile(r';', 0)
+        data= bytearray(';'.join(['x'] * 1000))
+        it= s.isplit(data, offsets=1)
+        self.assertEqual(it.next(), (0, 1))
+        self.assertEqual(sum(1 for p in it), 999)
+        self.assertRaises(StopIteration, it.next)
+    def test_namedGroups(self):
+        s= _ippch._compile(r'(?P<method>[A-Z]+) (?:/)(?<path>[a-z]*)([0-9])?', 0)
+        self.assertEqual(s.groups, 3)
+        self.assertEqual(s.groupindex, {'method': 1, 'path': 2})
+        self.assertEqual(s.match('GET /x')['spans'][2], (5, 6))
+        s= _ippch._compile(r'[(]\((a)', 0)
+        self.assertEqual(s.groups, 1)
+        self.assertRaises(_ippch._IppchError, _ippch._compile,
+                r'(?P<a>x)(?P<a>y)', 0)
+    def test_extract(self):
+        s= _ippch._compile(r'(?P<k>\w+)=(?P<v>\w+)', 0)
+        r= s.extract(['a=1', 'nothing', 'bb=22'])
+        self.assertEqual(r['k'], ['a', None, 'bb'])
+        self.assertEqual(r['v'], ['1', None, '22'])
+        self.assertEqual(r[0], ['a=1', None, 'bb=22'])
+        r= s.extractPacked('a=1xbb=22', struct.pack('3i', 0, 4, 9), spans=1)
+        starts, ends= r['v']
+        self.assertEqual(struct.unpack('2i', str(starts)), (2, 3))
+        self.assertEqual(struct.unpack('2i', str(ends)), (3, 5))
+    def test_compileFlags(self):
+        self.assertEqual(_ippch._compile(r'abc', 0).search('ABC'), None)
+        self.assertTrue(_ippch._compile(r'abc', 4).search('ABC') is not None)
+    def test_compileMultiEntries(self):
+        s= _ippch._compileMulti([r'abc', (r'abc', 4, 100), (r'x', None, 7)],
+                0)
+        self.assertEqual([p['id'] for p in s.patterns], [1, 100, 7])
+        self.assertEqual(s.patterns[1]['flags'], 4)
+        r= s.searchMulti('ABC')
+        self.assertEqual([e['patternid'] for e in r], [1, 100, 7])
+        self.assertEqual(r[0]['result'], None)
+        self.assertTrue(r[1]['result']['numfind'] > 0)
+        self.assertRaises(ValueError, _ippch._compileMulti, [('a', 0, -1)], 0)
+        self.assertRaises(TypeError, _ippch._compileMulti, [('a', 'i')], 0)
+    def test_compileMultiDedup(self):
+        s= _ippch._compileMulti([r'abc', (r'abc', None, 9), r'x', r'abc'], 0)
+        self.assertEqual(s.numpatterns, 4)
+        self.assertEqual(s.report['states'], 2)
+        self.assertEqual(s.report['duplicates'], 2)
+        self.assertEqual([p['state'] for p in s.patterns], [0, 0, 1, 0])
+        r= s.searchMulti('_abc_')
+        self.assertEqual([e['patternid'] for e in r], [1, 9, 3, 4])
+        self.assertTrue(r[1]['result']['numfind'] > 0)
+        self.assertEqual(r[2]['result'], None)
+        m= _ippch._compileMulti([r'abc', (r'abc', None, 9), r'x', r'abc'], 0)
+        r= m.measureDedup('abc x ' * 1000, 2)
+        self.assertTrue(r['scantime'] >= 0 and r['fullscantime'] >= 0)
+        self.assertEqual(r['scansaved'], r['fullscantime'] - r['scantime'])
+        self.assertTrue('scansaved' in m.report)
+        s= _ippch._compileMulti([r'abc', r'abc'], 0, 0, 0)
+        self.assertEqual(s.report['states'], 2)
+    def test_compileLazy(self):
+        s= _ippch._compile(r'(b+)', 0, 0, 1)
+        self.assertFalse(s.isCompiled())
+        self.assertEqual(s.groups, 1)
+        self.assertTrue(s.search('aabbcc')['numfind'] > 0)
+        self.assertTrue(s.isCompiled())
+        m= _ippch._compileMulti([r'abc', r'xyz'], 0, 0, 1, 1)
+        self.assertFalse(m.isCompiled())
+        self.assertEqual(m.searchMulti('_xyz_')[1]['patternid'], 2)
+        self.assertTrue(m.isCompiled())
+        self.assertRaises(_ippch._IppchError, _ippch._compile, r'(a', 0, 0, 1)
+        self.assertRaises(_ippch._IppchError, _ippch._compile, r'*a', 0, 0, 1)
+        self.assertRaises(_ippch._IppchError, _ippch._compileMulti,
+                [r'a', r'[b'], 0, 0, 1, 1)
+    def test_warmup(self):
+        objs= [_ippch._compile(r'a%d' % i, 0, 0, 1, i) for i in range(4)]
+        self.assertEqual(_ippch._warmup(objs[::-1]), 4)
+        _ippch._stopWorkerPool()
+        self.assertTrue(all(o.isCompiled() for o in objs))
+        self.assertEqual(_ippch._warmup(objs), 0)
+        self.assertRaises(TypeError, _ippch._warmup, [1])
+        # more objects than queue slots neither blocks nor loses objects
+        _ippch._setWorkerPool(1, 2)
+        objs= [_ippch._compile(r'b%d' % i, 0, 0, 1) for i in range(2000)]
+        n= _ippch._warmup(objs)
+        self.assertTrue(0 < n <= 2000)
+        _ippch._stopWorkerPool()
+        self.assertTrue(objs[-1].search('_b1999_')['numfind'] > 0)
+        _ippch._setWorkerPool(0)
+    def test_manifest(self):
+        import tempfile
+        path= os.path.join(tempfile.mkdtemp(), 'rules.mf')
+        rules= [r'abc', (r'abc', None, 9), (r'(x)y', 4)]
+        self.assertEqual(_ippch._loadManifest(path, rules, 0), None)
+        s= _ippch._compileMulti(rules, 0)
+        s.saveManifest(path)
+        m= _ippch._loadManifest(path, rules, 0)
+        self.assertEqual(m.manifest, path)
+        self.assertEqual(m.report['states'], 2)
+        self.assertEqual(m.patterns[2]['groups'], 1)
+        self.assertEqual(m.patterns[2]['flags'], 4)
+        self.assertEqual([e['patternid'] for e in m.searchMulti('_XY_abc')],
+                [1, 9, 3])
+        self.assertTrue(m.searchMulti('_XY_')[2]['result']['numfind'] > 0)
+        self.assertEqual(_ippch._loadManifest(path, rules[:2], 0), None)
+        self.assertEqual(_ippch._loadManifest(path, rules, 1), None)
+        self.assertEqual(_ippch._loadManifest(path, rules, 0, 0), None)
+        # same key, other text: the entries are compared, not trusted
+        data= open(path, 'rb').read()
+        open(path, 'wb').write(data.replace('abc\0', 'abd\0'))
+        self.assertEqual(_ippch._loadManifest(path, rules, 0), None)
+        # state options without their NUL are rejected, not read past
+        opts= struct.unpack_from('I', data, 200)[0]
+        open(path, 'wb').write(data[:opts] + 'x' * 12 + data[opts+12:])
+        self.assertEqual(_ippch._loadManifest(path, rules, 0), None)
+        os.unlink(path)
+        from pyipp.ipps import ippch
+        import warnings
+        with warnings.catch_warnings(record=True) as w:
+            warnings.simplefilter('always')
+            o= ippch.compileMulti(rules, manifest=os.path.join(path, 'x'))
+        self.assertEqual(o.report['states'], 2)
+        self.assertEqual(len(w), 1)
+    def test_scanPool(self):
+        from pyipp.ipps import scanpool
+        s= _ippch._compileMulti([r'abc', r'xyz'], 0, 1)
+        pool= scanpool.ScanPool(s, numprocs=2, slots=2, slotsize=4096,
+                maxinputs=16, maxrecords=2)
+        try:
+            batches= [['_abc_', '', 'xyz'], ['abc xyz', 'abc'], []]
+            r= list(pool.imap(batches))
+            self.assertEqual(list(r[0][0]), [1, 2])
+            self.assertEqual(list(r[0][3]), [0, 2])
+            self.assertEqual(list(r[0][1]), [1, 0])
+            self.assertEqual(list(r[1][0]), [1, 2, 1])
+            self.assertEqual(list(r[1][3]), [0, 0, 1])
+            self.assertEqual(len(r[2][0]), 0)
+            self.assertRaises(ValueError, pool.submit, ['a'] * 17)
+        finally:
+            pool.close()
+    def test_pipeline(self):
+        src= 'GET%20/A+b  \x01\t %41Dmin'
+        p= _ippch._pipeline(_ippch._compile(r'b admin', 0),
+                ['lower', 'collapse', 'strip', 'urldecode'])
+        self.assertEqual(p.normalize(src), 'get /a b admin')
+        self.assertEqual(p.search(src)['spans'], [(9, 22)])
+        self.assertEqual(p.search('xyz'), None)
+        m= _ippch._pipeline(_ippch._compileMulti([r'get /', r'admin'], 0),
+                ['urldecode', 'lower'])
+        r= m.searchMulti(src)
+        self.assertEqual(r[0]['span'], (0, 7))
+        self.assertEqual(r[1]['span'], (15, 22))
+        self.assertRaises(ValueError, _ippch._pipeline, m.state, ['upper'])
+
+    def test_keywords(self):
+        k= _ippch._keywords(['he', 'she', ('his', 7), 'hers'])
+        self.assertEqual(k.search('ushers'),
+                [(2, 1, 4), (1, 2, 4), (4, 2, 6)])
+        self.assertEqual(k.search('HERS'), [])
+        self.assertEqual(k.stats['keywords'], 4)
+        k.add([('HIS', 9)])
+        self.assertEqual(k.search('this HIS'), [(7, 1, 4), (9, 5, 8)])
+        k.add(['is'])
+        self.assertEqual(k.search('this'), [(7, 1, 4), (6, 2, 4)])
+        r= k.search('he' * 100)
+        self.assertEqual(len(r), 100)
+        self.assertEqual(r[-1], (1, 198, 200))
+        i= _ippch._keywords(['admin', ('Select', 3)], 1)
+        self.assertEqual(i.search('SELECT Admin'), [(3, 0, 6), (1, 7, 12)])
+        ids, starts, ends, inputs= [bytearray(4*2) for j in range(4)]
+        n, nxt= i.searchBatchInto(['admin', 'x', 'select admin'],
+                ids, starts, ends, inputs)
+        self.assertEqual((n, nxt), (1, 2))
+        n, nxt= i.searchBatchInto(['admin', 'x', 'select admin'],
+                ids, starts, ends, inputs, nxt)
+        self.assertEqual((n, nxt), (2, 3))
+        self.assertEqual(struct.unpack('2i', str(ids)), (3, 1))
+        self.assertEqual(struct.unpack('2i', str(inputs)), (2, 2))
+        data= 'adminselect'
+        offsets= bytearray(struct.pack('3i', 0, 5, 11))
+        n, nxt= i.searchPackedInto(data, offsets, ids, starts, ends)
+        self.assertEqual((n, nxt), (2, 2))
+        self.assertEqual(struct.unpack('2i', str(starts)), (0, 0))
+        self.assertRaises(ValueError, _ippch._keywords, [''])
+        self.assertRaises(TypeError, _ippch._keywords, [1])
+
+testsuite= unittest.TestSuite(map(
+    IppchTestCases,
+    IppchTestCases.testlist)
+    )
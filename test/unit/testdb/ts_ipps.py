@@ -0,0 +1,186 @@
+# ipps unit test cases
+import sys, os, ctypes
+from pyipp.ipps import _ipps
+import unittest
+
+
+def vec(ctype, values):
+    return (ctype * len(values))(*values)
+
+class IppsTestCases(unittest.TestCase):
+    testlist= []
+    testlist.append('test_getLibVersion')
+    testlist.append('test_addSubMul')
+    testlist.append('test_inplace')
+    testlist.append('test_reductions')
+    testlist.append('test_dotProd')
+    testlist.append('test_minMax')
+    testlist.append('test_threshold')
+    testlist.append('test_wrongTypes')
+    testlist.append('test_alignedBuffer')
+    testlist.append('test_bufferPool')
+    testlist.append('test_dft')
+    testlist.append('test_dftBatch')
+    testlist.append('test_firStream')
+    testlist.append('test_firDecimate')
+    testlist.append('test_iirStream')
+    def setup(self):
+        pass
+    def test_getLibVersion(self):
+        self.assertTrue(_ipps._getLibVersion() is not None)
+    def test_addSubMul(self):
+        a= vec(ctypes.c_float, [1, 2, 3, 4])
+        b= vec(ctypes.c_float, [4, 3, 2, 1])
+        d= vec(ctypes.c_float, [0, 0, 0, 0])
+        _ipps._add(a, b, d)
+        self.assertEqual(list(d), [5, 5, 5, 5])
+        _ipps._sub(a, b, d)
+        self.assertEqual(list(d), [-3, -1, 1, 3])
+        _ipps._mul(a, b, d)
+        self.assertEqual(list(d), [4, 6, 6, 4])
+    def test_inplace(self):
+        a= vec(ctypes.c_double, [1, 2, 3])
+        d= vec(ctypes.c_double, [10, 10, 10])
+        _ipps._addI(a, d)
+        self.assertEqual(list(d), [11, 12, 13])
+        _ipps._subI(a, d)
+        self.assertEqual(list(d), [10, 10, 10])
+        _ipps._mulI(a, d)
+        self.assertEqual(list(d), [10, 20, 30])
+    def test_reductions(self):
+        a= vec(ctypes.c_double, [3, -4])
+        self.assertEqual(_ipps._sum(a), -1.0)
+        self.assertEqual(_ipps._mean(a), -0.5)
+        self.assertEqual(_ipps._norm(a), 5.0)
+        self.assertEqual(_ipps._norm(a, 'L1'), 7.0)
+        self.assertEqual(_ipps._norm(a, 'Inf'), 4.0)
+        self.assertRaises(ValueError, _ipps._norm, a, 'L3')
+        s= vec(ctypes.c_short, [1, 2, 3, 6])
+        self.assertEqual(_ipps._sum(s), 12)
+        self.assertEqual(_ipps._mean(s), 3)
+        # ipp divides by n - 1: mean 4, squared deviations 8, 8 / 2
+        self.assertEqual(_ipps._stdDev(vec(ctypes.c_short, [2, 4, 6])), 2)
+        self.assertAlmostEqual(_ipps._stdDev(vec(ctypes.c_float,
+            [1, 3, 5])), 2.0, 5)
+        self.assertAlmostEqual(_ipps._stdDev(vec(ctypes.c_double,
+            [2, 4, 4, 4, 5, 5, 7, 9])), (32 / 7.0) ** 0.5, 12)
+    def test_dotProd(self):
+        a= vec(ctypes.c_short, [1, 2, 3])
+        b= vec(ctypes.c_short, [4, 5, 6])
+        self.assertEqual(_ipps._dotProd(a, b), 32)
+    def test_minMax(self):
+        a= vec(ctypes.c_float, [2, -1, 7, 3])
+        self.assertEqual(_ipps._minMax(a), (-1.0, 7.0))
+    def test_threshold(self):
+        a= vec(ctypes.c_float, [1, 5, 9])
+        d= vec(ctypes.c_float, [0, 0, 0])
+        _ipps._threshold(a, 4, _ipps.ippCmpLess, d)
+        self.assertEqual(list(d), [4, 5, 9])
+        _ipps._threshold(a, 6, _ipps.ippCmpGreater, None)
+        self.assertEqual(list(a), [1, 5, 6])
+    def test_wrongTypes(self):
+        a= vec(ctypes.c_float, [1, 2])
+        b= vec(ctypes.c_double, [1, 2])
+        c= vec(ctypes.c_float, [1, 2, 3])
+        self.assertRaises(TypeError, _ipps._add, a, b, a)
+        self.assertRaises(ValueError, _ipps._add, a, c, a)
+        self.assertRaises(TypeError, _ipps._sum, vec(ctypes.c_int, [1]))
+    def test_alignedBuffer(self):
+        b= _ipps._alignedBuffer(100, 'f', 1)
+        self.assertEqual(b.address % 64, 0)
+        self.assertEqual((b.size, b.nitems, b.format), (400, 100, 'f'))
+        m= memoryview(b)
+        self.assertEqual((m.format, m.itemsize, len(m)), ('f', 4, 100))
+        self.assertEqual(m.tobytes(), '\0' * 400)
+        self.assertEqual(_ipps._sum(b), 0.0)
+        self.assertRaises(BufferError, b.release)
+        del m
+        # no raw pointers through the old style buffer protocol
+        self.assertRaises(TypeError, buffer, b)
+        type(b).release(b)
+        self.assertRaises(ValueError, memoryview, b)
+        b.release()
+        self.assertRaises(ValueError, _ipps._alignedBuffer, 1, 'x')
+    def test_bufferPool(self):
+        _ipps._poolReset()
+        b= _ipps._alignedBuffer(1000)
+        self.assertEqual(b.capacity, 1024)
+        del b
+        b= _ipps._alignedBuffer(600)
+        st= _ipps._poolStats()
+        self.assertEqual((st['hits'], st['misses']), (1, 1))
+        self.assertEqual(st['inuse'], 1024)
+        del b
+        _ipps._setPoolLimit(0)
+        self.assertEqual(_ipps._poolStats()['free'], 0)
+        _ipps._setPoolLimit(16)
+    def test_dft(self):
+        d= _ipps._dft(4)
+        self.assertTrue(d is _ipps._dft(4))
+        self.assertTrue((4, 0, _ipps.IPP_FFT_DIV_INV_BY_N, 0) in
+                _ipps._dftCacheInfo())
+        src= vec(ctypes.c_float, [1, 0, 0, 0])
+        spec= vec(ctypes.c_float, [0] * 6)
+        back= vec(ctypes.c_float, [0] * 4)
+        d.forward(src, spec)
+        self.assertEqual(list(spec), [1, 0, 1, 0, 1, 0])
+        d.inverse(spec, back)
+        self.assertEqual(list(back), [1, 0, 0, 0])
+        self.assertRaises(ValueError, d.forward, back, back)
+        c= _ipps._dft(2, complex=1)
+        cs= vec(ctypes.c_float, [1, 0, 0, 1])
+        cd= vec(ctypes.c_float, [0] * 4)
+        c.forward(cs, cd)
+        self.assertEqual(list(cd), [1, 1, 1, -1])
+        _ipps._dftCacheClear()
+        self.assertEqual(_ipps._dftCacheInfo(), [])
+        for n in range(1, 18):
+            _ipps._dft(n)
+        keys= [k[0] for k in _ipps._dftCacheInfo()]
+        self.assertEqual(keys, range(2, 18))
+        _ipps._dft(2)
+        _ipps._dft(18)
+        keys= [k[0] for k in _ipps._dftCacheInfo()]
+        self.assertEqual(keys, range(4, 18) + [2, 18])
+        _ipps._dftCacheClear()
+    def test_dftBatch(self):
+        d= _ipps._dft(4)
+        src= vec(ctypes.c_float, [1, 0, 0, 0, 1, 1, 1, 1])
+        spec= vec(ctypes.c_float, [0] * 12)
+        self.assertEqual(d.forwardBatch(src, spec), 2)
+        self.assertEqual(list(spec), [1, 0, 1, 0, 1, 0, 4, 0, 0, 0, 0, 0])
+    def test_firStream(self):
+        f= _ipps._firFilter([0.5, 0.5])
+        a= vec(ctypes.c_float, [1, 1])
+        self.assertEqual(f.process(a), 2)
+        self.assertEqual(list(a), [0.5, 1])
+        b= vec(ctypes.c_float, [1, 3])
+        d= vec(ctypes.c_float, [0, 0])
+        f.process(b, d)
+        self.assertEqual(list(d), [1, 2])
+        f.reset()
+        f.process(b, d)
+        self.assertEqual(list(d), [0.5, 2])
+        self.assertRaises(TypeError, f.process, vec(ctypes.c_double, [1]))
+    def test_firDecimate(self):
+        f= _ipps._firFilter([1], down=2)
+        d= vec(ctypes.c_float, [0, 0])
+        self.assertEqual(f.process(vec(ctypes.c_float, [1, 2, 3, 4]), d), 2)
+        self.assertEqual(list(d), [1, 3])
+        self.assertRaises(ValueError, f.process, vec(ctypes.c_float, [1]), d)
+        self.assertRaises(ValueError, f.process, d)
+    def test_iirStream(self):
+        f= _ipps._iirFilter([1, 0, 1, -0.5])
+        a= vec(ctypes.c_float, [1, 0])
+        f.process(a)
+        self.assertEqual(list(a), [1, 0.5])
+        a= vec(ctypes.c_float, [0])
+        f.process(a)
+        self.assertEqual(list(a), [0.25])
+        self.assertRaises(ValueError, _ipps._iirFilter, [1, 2, 3])
+        self.assertRaises(ValueError, _ipps._iirFilter, [1, 0, 1, 0], 1)
+
+testsuite= unittest.TestSuite(map(
+    IppsTestCases,
+    IppsTestCases.testlist)
+    )